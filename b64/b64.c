@@ -1,7 +1,11 @@
 #include "b64.h"
 
 int base64_decode(const char *input, uint8_t *output, size_t max_output_len) {
-  size_t input_len = strlen(input);
+  return base64_decode_n(input, strlen(input), output, max_output_len);
+}
+
+int base64_decode_n(const char *input, size_t input_len, uint8_t *output,
+                    size_t max_output_len) {
   size_t output_len = 0;
   uint32_t buffer = 0;
   int bits = 0;
@@ -31,3 +35,38 @@ int base64_decode(const char *input, uint8_t *output, size_t max_output_len) {
 
   return output_len;
 }
+
+int base64_encode(const uint8_t *input, size_t input_len, char *output,
+                  size_t max_output_len) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  size_t output_len = (input_len + 2) / 3 * 4;
+  if (output_len > max_output_len) {
+    return -1;
+  }
+
+  size_t o = 0;
+  size_t i = 0;
+  for (; i + 3 <= input_len; i += 3) {
+    uint32_t group = ((uint32_t)input[i] << 16) |
+                     ((uint32_t)input[i + 1] << 8) | input[i + 2];
+    output[o++] = alphabet[(group >> 18) & 0x3F];
+    output[o++] = alphabet[(group >> 12) & 0x3F];
+    output[o++] = alphabet[(group >> 6) & 0x3F];
+    output[o++] = alphabet[group & 0x3F];
+  }
+
+  if (i < input_len) {
+    uint32_t group = (uint32_t)input[i] << 16;
+    if (i + 1 < input_len) {
+      group |= (uint32_t)input[i + 1] << 8;
+    }
+    output[o++] = alphabet[(group >> 18) & 0x3F];
+    output[o++] = alphabet[(group >> 12) & 0x3F];
+    output[o++] = i + 1 < input_len ? alphabet[(group >> 6) & 0x3F] : '=';
+    output[o++] = '=';
+  }
+
+  return (int)o;
+}
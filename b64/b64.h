@@ -20,4 +20,12 @@ static const int base64_decode_table[256] = {
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1};
 
-int base64_decode(const char *input, uint8_t *output, size_t max_output_len);
\ No newline at end of file
+int base64_decode(const char *input, uint8_t *output, size_t max_output_len);
+int base64_decode_n(const char *input, size_t input_len, uint8_t *output,
+                    size_t max_output_len);
+/*
+ * Encodes input as unwrapped base64 with padding. Returns the number of
+ * characters written, or -1 if output cannot hold them.
+ */
+int base64_encode(const uint8_t *input, size_t input_len, char *output,
+                  size_t max_output_len);
\ No newline at end of file
@@ -0,0 +1,228 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+#include "../pem/pem.h"
+#include "../util/stats.h"
+#include "../util/util.h"
+#include "../x509/x509.h"
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH_PATH_MAX 4096
+
+static int batch_walk_dir(char *path, size_t path_len, batch_file_fn fn,
+                          void *user) {
+  DIR *dir = opendir(path);
+  if (!dir) {
+    return -1;
+  }
+
+  int result = 0;
+  struct dirent *entry;
+  while (result == 0 && (entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+
+    size_t name_len = strlen(entry->d_name);
+    if (path_len + 1 + name_len + 1 > BATCH_PATH_MAX) {
+      continue;
+    }
+    path[path_len] = '/';
+    memcpy(&path[path_len + 1], entry->d_name, name_len + 1);
+
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+      result = batch_walk_dir(path, path_len + 1 + name_len, fn, user);
+    } else if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+      result = fn(path, &st, user);
+    }
+
+    path[path_len] = '\0';
+  }
+
+  closedir(dir);
+  return result;
+}
+
+int batch_walk(const char *root, batch_file_fn fn, void *user) {
+  char path[BATCH_PATH_MAX];
+  size_t len = strlen(root);
+  if (len >= sizeof(path)) {
+    return -1;
+  }
+  memcpy(path, root, len + 1);
+  while (len > 1 && path[len - 1] == '/') {
+    path[--len] = '\0';
+  }
+
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return -1;
+  }
+  if (S_ISREG(st.st_mode)) {
+    return fn(path, &st, user);
+  }
+  return batch_walk_dir(path, len, fn, user);
+}
+
+der_error_t batch_summarize(const uint8_t *der_data, size_t der_len,
+                            batch_cert_t *cert) {
+  STATS_STAGE_BEGIN(parse_start);
+  x509_cert_t parsed;
+  der_error_t err = x509_extract_fields(
+      der_data, der_len,
+      X509_FIELD_ISSUER | X509_FIELD_VALIDITY | X509_FIELD_SUBJECT, &parsed);
+  if (err != DER_OK) {
+    STATS_STAGE_END(STATS_STAGE_PARSE, parse_start);
+    return err;
+  }
+
+  memset(cert, 0, sizeof(batch_cert_t));
+  cert->not_before = parsed.not_before;
+  cert->not_after = parsed.not_after;
+  x509_name_attribute(parsed.subject, X509_ATTR_CN, cert->subject_cn,
+                      sizeof(cert->subject_cn));
+  x509_name_attribute(parsed.issuer, X509_ATTR_CN, cert->issuer_cn,
+                      sizeof(cert->issuer_cn));
+  STATS_STAGE_END(STATS_STAGE_PARSE, parse_start);
+
+  STATS_STAGE_BEGIN(hash_start);
+  sha256(der_data, der_len, cert->sha256);
+  STATS_STAGE_END(STATS_STAGE_HASH, hash_start);
+  return DER_OK;
+}
+
+int batch_parse_file(const char *path, batch_cert_t **certs, size_t *count) {
+  return batch_parse_file_filtered(path, NULL, NULL, certs, count);
+}
+
+int batch_parse_file_filtered(const char *path, batch_filter_fn filter,
+                              void *user, batch_cert_t **certs,
+                              size_t *count) {
+  *certs = NULL;
+  *count = 0;
+
+  arena_t *arena = arena_thread();
+  if (!arena) {
+    return -1;
+  }
+
+  arena_mark_t mark = arena_mark(arena);
+  batch_cert_t *parsed;
+  size_t parsed_count;
+  int result =
+      batch_parse_file_arena(path, filter, user, arena, &parsed, &parsed_count);
+
+  if (result == 0 && parsed_count > 0) {
+    *certs = malloc(parsed_count * sizeof(batch_cert_t));
+    if (*certs) {
+      memcpy(*certs, parsed, parsed_count * sizeof(batch_cert_t));
+      *count = parsed_count;
+    } else {
+      result = -1;
+    }
+  }
+
+  arena_release(arena, mark);
+  return result;
+}
+
+int batch_parse_file_arena(const char *path, batch_filter_fn filter,
+                           void *user, arena_t *arena, batch_cert_t **certs,
+                           size_t *count) {
+  pem_block_t *blocks;
+  size_t block_count;
+
+  *certs = NULL;
+  *count = 0;
+
+  if (pem_read_certificates_arena(path, arena, &blocks, &block_count) != 0) {
+    return -1;
+  }
+
+  if (block_count > 0) {
+    *certs = arena_alloc(arena, block_count * sizeof(batch_cert_t));
+    if (!*certs) {
+      return -1;
+    }
+  }
+
+  for (size_t i = 0; i < block_count; i++) {
+    if (filter) {
+      STATS_STAGE_BEGIN(filter_start);
+      bool keep = filter(blocks[i].der, blocks[i].der_len, user);
+      STATS_STAGE_END(STATS_STAGE_FILTER, filter_start);
+      if (!keep) {
+        continue;
+      }
+    }
+    if (batch_summarize(blocks[i].der, blocks[i].der_len,
+                        &(*certs)[*count]) == DER_OK) {
+      (*count)++;
+    }
+  }
+
+  return 0;
+}
+
+bool batch_parse_format(const char *name, batch_format_t *format) {
+  if (strcmp(name, "text") == 0) {
+    *format = BATCH_FORMAT_TEXT;
+  } else if (strcmp(name, "json") == 0) {
+    *format = BATCH_FORMAT_JSON;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static void emit_json_string(FILE *out, const char *str) {
+  fputc('"', out);
+  for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+    if (*p == '"' || *p == '\\') {
+      fprintf(out, "\\%c", *p);
+    } else if (*p < 0x20) {
+      fprintf(out, "\\u%04x", *p);
+    } else {
+      fputc(*p, out);
+    }
+  }
+  fputc('"', out);
+}
+
+void batch_emit(FILE *out, batch_format_t format, const char *event,
+                const char *path, const batch_cert_t *cert) {
+  STATS_STAGE_BEGIN(start);
+  char digest[SHA256_DIGEST_SIZE * 2 + 1];
+  char not_before[32], not_after[32];
+
+  hex_to_string(cert->sha256, SHA256_DIGEST_SIZE, digest);
+  x509_format_time(cert->not_before, not_before, sizeof(not_before));
+  x509_format_time(cert->not_after, not_after, sizeof(not_after));
+
+  if (format == BATCH_FORMAT_JSON) {
+    fputc('{', out);
+    if (event) {
+      fprintf(out, "\"event\":\"%s\",", event);
+    }
+    fprintf(out, "\"path\":");
+    emit_json_string(out, path);
+    fprintf(out,
+            ",\"sha256\":\"%s\",\"not_before\":\"%s\",\"not_after\":\"%s\","
+            "\"subject_cn\":",
+            digest, not_before, not_after);
+    emit_json_string(out, cert->subject_cn);
+    fprintf(out, ",\"issuer_cn\":");
+    emit_json_string(out, cert->issuer_cn);
+    fprintf(out, "}\n");
+  } else {
+    if (event) {
+      fprintf(out, "%-8s ", event);
+    }
+    fprintf(out, "%s  %s  %s  %s  (issuer: %s)\n", path, digest, not_after,
+            cert->subject_cn, cert->issuer_cn);
+  }
+  STATS_STAGE_END(STATS_STAGE_EMIT, start);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../der/der.h"
+#include "../util/arena.h"
+#include "../util/sha256.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#define BATCH_CN_MAX 64
+
+typedef enum { BATCH_FORMAT_TEXT, BATCH_FORMAT_JSON } batch_format_t;
+
+typedef struct {
+  uint8_t sha256[SHA256_DIGEST_SIZE];
+  int64_t not_before;
+  int64_t not_after;
+  char subject_cn[BATCH_CN_MAX];
+  char issuer_cn[BATCH_CN_MAX];
+} batch_cert_t;
+
+typedef int (*batch_file_fn)(const char *path, const struct stat *st,
+                             void *user);
+typedef bool (*batch_filter_fn)(const uint8_t *der_data, size_t der_len,
+                                void *user);
+
+int batch_walk(const char *root, batch_file_fn fn, void *user);
+
+der_error_t batch_summarize(const uint8_t *der_data, size_t der_len,
+                            batch_cert_t *cert);
+int batch_parse_file(const char *path, batch_cert_t **certs, size_t *count);
+/* Certificates rejected by filter are dropped before they are summarised. */
+int batch_parse_file_filtered(const char *path, batch_filter_fn filter,
+                              void *user, batch_cert_t **certs,
+                              size_t *count);
+/*
+ * Parses without touching the heap once the arena is warm. Certificates and
+ * scratch buffers live in the arena until the caller releases it.
+ */
+int batch_parse_file_arena(const char *path, batch_filter_fn filter,
+                           void *user, arena_t *arena, batch_cert_t **certs,
+                           size_t *count);
+
+bool batch_parse_format(const char *name, batch_format_t *format);
+void batch_emit(FILE *out, batch_format_t format, const char *event,
+                const char *path, const batch_cert_t *cert);
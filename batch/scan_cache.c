@@ -0,0 +1,228 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "scan_cache.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static int64_t stat_mtime_ns(const struct stat *st) {
+  return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+der_error_t scan_cache_open(scan_cache_t *cache, const char *path) {
+  if (!cache || !path) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  memset(cache, 0, sizeof(scan_cache_t));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return DER_OK;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(scan_cache_header_t)) {
+    close(fd);
+    return DER_OK;
+  }
+
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return DER_OK;
+  }
+
+  /* Each count is bounded by the bytes left before it is multiplied. */
+  const scan_cache_header_t *header = map;
+  size_t left = (size_t)st.st_size - sizeof(scan_cache_header_t);
+  bool sized = header->entry_count <= left / sizeof(scan_cache_entry_t);
+  if (sized) {
+    left -= header->entry_count * sizeof(scan_cache_entry_t);
+    sized = header->cert_count <= left / sizeof(batch_cert_t) &&
+            header->cert_count * sizeof(batch_cert_t) == left;
+  }
+  if (memcmp(header->magic, SCAN_CACHE_MAGIC, 8) != 0 || !sized) {
+    munmap(map, (size_t)st.st_size);
+    return DER_OK;
+  }
+
+  cache->map = map;
+  cache->map_size = (size_t)st.st_size;
+  cache->entries = (const scan_cache_entry_t *)(header + 1);
+  cache->entry_count = header->entry_count;
+  cache->certs = (const batch_cert_t *)(cache->entries + cache->entry_count);
+  cache->cert_count = header->cert_count;
+  return DER_OK;
+}
+
+void scan_cache_close(scan_cache_t *cache) {
+  if (!cache) {
+    return;
+  }
+
+  if (cache->map) {
+    munmap(cache->map, cache->map_size);
+  }
+  free(cache->next_entries);
+  free(cache->next_certs);
+  memset(cache, 0, sizeof(scan_cache_t));
+}
+
+static int compare_keys(uint64_t dev_a, uint64_t ino_a, uint64_t dev_b,
+                        uint64_t ino_b) {
+  if (dev_a != dev_b) {
+    return dev_a < dev_b ? -1 : 1;
+  }
+  if (ino_a != ino_b) {
+    return ino_a < ino_b ? -1 : 1;
+  }
+  return 0;
+}
+
+const scan_cache_entry_t *scan_cache_lookup(const scan_cache_t *cache,
+                                            const struct stat *st) {
+  size_t lo = 0, hi = cache->entry_count;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    const scan_cache_entry_t *entry = &cache->entries[mid];
+    int cmp = compare_keys(entry->dev, entry->ino, (uint64_t)st->st_dev,
+                           (uint64_t)st->st_ino);
+    if (cmp == 0) {
+      if (entry->size == (uint64_t)st->st_size &&
+          entry->mtime_ns == stat_mtime_ns(st) &&
+          (uint64_t)entry->first_cert + entry->cert_count <=
+              cache->cert_count) {
+        return entry;
+      }
+      return NULL;
+    }
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return NULL;
+}
+
+const batch_cert_t *scan_cache_certs(const scan_cache_t *cache,
+                                     const scan_cache_entry_t *entry) {
+  return &cache->certs[entry->first_cert];
+}
+
+der_error_t scan_cache_record(scan_cache_t *cache, const struct stat *st,
+                              const batch_cert_t *certs, size_t count) {
+  if (!cache || !st || (count > 0 && !certs)) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  if (cache->next_entry_count == cache->next_entry_capacity) {
+    size_t capacity =
+        cache->next_entry_capacity ? cache->next_entry_capacity * 2 : 256;
+    scan_cache_entry_t *entries =
+        realloc(cache->next_entries, capacity * sizeof(scan_cache_entry_t));
+    if (!entries) {
+      return DER_ERROR_BUFFER_TOO_SMALL;
+    }
+    cache->next_entries = entries;
+    cache->next_entry_capacity = capacity;
+  }
+
+  if (cache->next_cert_count + count > cache->next_cert_capacity) {
+    size_t capacity =
+        cache->next_cert_capacity ? cache->next_cert_capacity * 2 : 256;
+    while (capacity < cache->next_cert_count + count) {
+      capacity *= 2;
+    }
+    batch_cert_t *grown =
+        realloc(cache->next_certs, capacity * sizeof(batch_cert_t));
+    if (!grown) {
+      return DER_ERROR_BUFFER_TOO_SMALL;
+    }
+    cache->next_certs = grown;
+    cache->next_cert_capacity = capacity;
+  }
+
+  scan_cache_entry_t *entry = &cache->next_entries[cache->next_entry_count++];
+  entry->dev = (uint64_t)st->st_dev;
+  entry->ino = (uint64_t)st->st_ino;
+  entry->size = (uint64_t)st->st_size;
+  entry->mtime_ns = stat_mtime_ns(st);
+  entry->first_cert = (uint32_t)cache->next_cert_count;
+  entry->cert_count = (uint32_t)count;
+
+  if (count > 0) {
+    memcpy(&cache->next_certs[cache->next_cert_count], certs,
+           count * sizeof(batch_cert_t));
+    cache->next_cert_count += count;
+  }
+
+  return DER_OK;
+}
+
+static int compare_entries(const void *a, const void *b) {
+  const scan_cache_entry_t *x = a;
+  const scan_cache_entry_t *y = b;
+  return compare_keys(x->dev, x->ino, y->dev, y->ino);
+}
+
+der_error_t scan_cache_commit(scan_cache_t *cache, const char *path) {
+  if (!cache || !path) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  qsort(cache->next_entries, cache->next_entry_count,
+        sizeof(scan_cache_entry_t), compare_entries);
+
+  size_t unique = 0;
+  for (size_t i = 0; i < cache->next_entry_count; i++) {
+    if (unique == 0 || compare_entries(&cache->next_entries[unique - 1],
+                                       &cache->next_entries[i]) != 0) {
+      cache->next_entries[unique++] = cache->next_entries[i];
+    }
+  }
+
+  scan_cache_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SCAN_CACHE_MAGIC, 8);
+  header.entry_count = unique;
+  header.cert_count = cache->next_cert_count;
+
+  size_t path_len = strlen(path);
+  char *tmp_path = malloc(path_len + 5);
+  if (!tmp_path) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+  memcpy(tmp_path, path, path_len);
+  memcpy(tmp_path + path_len, ".tmp", 5);
+
+  FILE *fp = fopen(tmp_path, "wb");
+  if (!fp) {
+    free(tmp_path);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(cache->next_entries, sizeof(scan_cache_entry_t), unique,
+                   fp) == unique &&
+            fwrite(cache->next_certs, sizeof(batch_cert_t),
+                   cache->next_cert_count, fp) == cache->next_cert_count;
+  ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0 && ok;
+  ok = fclose(fp) == 0 && ok;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    remove(tmp_path);
+    free(tmp_path);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  free(tmp_path);
+  return DER_OK;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "batch.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define SCAN_CACHE_MAGIC "QCCACHE1"
+
+typedef struct {
+  char magic[8];
+  uint64_t entry_count;
+  uint64_t cert_count;
+  uint64_t reserved;
+} scan_cache_header_t;
+
+typedef struct {
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t size;
+  int64_t mtime_ns;
+  uint32_t first_cert;
+  uint32_t cert_count;
+} scan_cache_entry_t;
+
+typedef struct {
+  void *map;
+  size_t map_size;
+  const scan_cache_entry_t *entries;
+  size_t entry_count;
+  const batch_cert_t *certs;
+  size_t cert_count;
+
+  scan_cache_entry_t *next_entries;
+  size_t next_entry_count;
+  size_t next_entry_capacity;
+  batch_cert_t *next_certs;
+  size_t next_cert_count;
+  size_t next_cert_capacity;
+} scan_cache_t;
+
+der_error_t scan_cache_open(scan_cache_t *cache, const char *path);
+void scan_cache_close(scan_cache_t *cache);
+
+const scan_cache_entry_t *scan_cache_lookup(const scan_cache_t *cache,
+                                            const struct stat *st);
+const batch_cert_t *scan_cache_certs(const scan_cache_t *cache,
+                                     const scan_cache_entry_t *entry);
+
+der_error_t scan_cache_record(scan_cache_t *cache, const struct stat *st,
+                              const batch_cert_t *certs, size_t count);
+der_error_t scan_cache_commit(scan_cache_t *cache, const char *path);
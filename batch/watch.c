@@ -0,0 +1,412 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "watch.h"
+#include "../util/util.h"
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define WATCH_MASK                                                             \
+  (IN_CREATE | IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO |      \
+   IN_DELETE | IN_DELETE_SELF)
+#define WATCH_PATH_MAX 4096
+
+static size_t watch_bucket(const char *path) {
+  return hash64((const uint8_t *)path, strlen(path)) % WATCH_BUCKETS;
+}
+
+static watch_file_t *watch_find(watch_t *watch, const char *path,
+                                bool create) {
+  size_t bucket = watch_bucket(path);
+  for (watch_file_t *file = watch->buckets[bucket]; file; file = file->next) {
+    if (strcmp(file->path, path) == 0) {
+      return file;
+    }
+  }
+
+  if (!create) {
+    return NULL;
+  }
+
+  watch_file_t *file = calloc(1, sizeof(watch_file_t));
+  if (!file) {
+    return NULL;
+  }
+  file->path = strdup(path);
+  if (!file->path) {
+    free(file);
+    return NULL;
+  }
+  file->next = watch->buckets[bucket];
+  watch->buckets[bucket] = file;
+  return file;
+}
+
+static void watch_remove(watch_t *watch, watch_file_t *target) {
+  watch_file_t **link = &watch->buckets[watch_bucket(target->path)];
+  while (*link && *link != target) {
+    link = &(*link)->next;
+  }
+  if (*link) {
+    *link = target->next;
+  }
+  free(target->path);
+  free(target->certs);
+  free(target);
+}
+
+static void watch_mark_dirty(watch_t *watch, const char *path) {
+  watch_file_t *file = watch_find(watch, path, true);
+  if (file && !file->dirty) {
+    file->dirty = true;
+    file->next_dirty = watch->dirty;
+    watch->dirty = file;
+  }
+}
+
+static void watch_mark_prefix_dirty(watch_t *watch, const char *prefix) {
+  size_t len = strlen(prefix);
+  for (size_t i = 0; i < WATCH_BUCKETS; i++) {
+    for (watch_file_t *file = watch->buckets[i]; file; file = file->next) {
+      if (strncmp(file->path, prefix, len) == 0 && file->path[len] == '/') {
+        watch_mark_dirty(watch, file->path);
+      }
+    }
+  }
+}
+
+static const char *watch_dir_path(const watch_t *watch, int wd) {
+  for (size_t i = 0; i < watch->dir_count; i++) {
+    if (watch->dirs[i].wd == wd) {
+      return watch->dirs[i].path;
+    }
+  }
+  return NULL;
+}
+
+static int watch_add_dir(watch_t *watch, const char *path) {
+  int wd = inotify_add_watch(watch->fd, path, WATCH_MASK);
+  if (wd < 0) {
+    return -1;
+  }
+
+  /* A known wd is a directory moved within the tree: keep the new path. */
+  for (size_t i = 0; i < watch->dir_count; i++) {
+    if (watch->dirs[i].wd == wd) {
+      if (strcmp(watch->dirs[i].path, path) != 0) {
+        char *copy = strdup(path);
+        if (!copy) {
+          return -1;
+        }
+        free(watch->dirs[i].path);
+        watch->dirs[i].path = copy;
+      }
+      return 0;
+    }
+  }
+
+  if (watch->dir_count == watch->dir_capacity) {
+    size_t capacity = watch->dir_capacity ? watch->dir_capacity * 2 : 16;
+    watch_dir_t *dirs = realloc(watch->dirs, capacity * sizeof(watch_dir_t));
+    if (!dirs) {
+      return -1;
+    }
+    watch->dirs = dirs;
+    watch->dir_capacity = capacity;
+  }
+
+  char *copy = strdup(path);
+  if (!copy) {
+    return -1;
+  }
+  watch->dirs[watch->dir_count].path = copy;
+  watch->dirs[watch->dir_count].wd = wd;
+  watch->dir_count++;
+  return 0;
+}
+
+static void watch_forget_dir(watch_t *watch, int wd) {
+  for (size_t i = 0; i < watch->dir_count; i++) {
+    if (watch->dirs[i].wd == wd) {
+      free(watch->dirs[i].path);
+      watch->dirs[i] = watch->dirs[--watch->dir_count];
+      return;
+    }
+  }
+}
+
+static int watch_scan_dir(watch_t *watch, const char *path) {
+  if (watch_add_dir(watch, path) != 0) {
+    return -1;
+  }
+
+  DIR *dir = opendir(path);
+  if (!dir) {
+    return -1;
+  }
+
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+
+    char child[WATCH_PATH_MAX];
+    if (snprintf(child, sizeof(child), "%s/%s", path, entry->d_name) >=
+        (int)sizeof(child)) {
+      continue;
+    }
+
+    struct stat st;
+    if (lstat(child, &st) == 0 && S_ISDIR(st.st_mode)) {
+      watch_scan_dir(watch, child);
+    } else {
+      watch_mark_dirty(watch, child);
+    }
+  }
+
+  closedir(dir);
+  return 0;
+}
+
+static bool same_cert(const batch_cert_t *a, const batch_cert_t *b) {
+  return memcmp(a->sha256, b->sha256, SHA256_DIGEST_SIZE) == 0;
+}
+
+static bool contains_cert(const batch_cert_t *certs, size_t count,
+                          const batch_cert_t *cert) {
+  for (size_t i = 0; i < count; i++) {
+    if (same_cert(&certs[i], cert)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void watch_diff(watch_t *watch, const char *path,
+                       const batch_cert_t *old_certs, size_t old_count,
+                       const batch_cert_t *new_certs, size_t new_count) {
+  size_t i = 0, j = 0;
+
+  for (;;) {
+    while (i < old_count && contains_cert(new_certs, new_count, &old_certs[i])) {
+      i++;
+    }
+    while (j < new_count && contains_cert(old_certs, old_count, &new_certs[j])) {
+      j++;
+    }
+
+    if (i < old_count && j < new_count) {
+      batch_emit(watch->out, watch->format, "changed", path, &new_certs[j]);
+      i++;
+      j++;
+    } else if (i < old_count) {
+      batch_emit(watch->out, watch->format, "removed", path, &old_certs[i++]);
+    } else if (j < new_count) {
+      batch_emit(watch->out, watch->format, "added", path, &new_certs[j++]);
+    } else {
+      break;
+    }
+  }
+}
+
+static void watch_flush(watch_t *watch) {
+  watch_file_t *file = watch->dirty;
+  watch->dirty = NULL;
+
+  while (file) {
+    watch_file_t *next = file->next_dirty;
+    file->dirty = false;
+    file->next_dirty = NULL;
+
+    struct stat st;
+    batch_cert_t *certs = NULL;
+    size_t count = 0;
+    if (stat(file->path, &st) == 0 && S_ISREG(st.st_mode)) {
+      batch_parse_file(file->path, &certs, &count);
+    }
+
+    watch_diff(watch, file->path, file->certs, file->count, certs, count);
+
+    if (count == 0) {
+      free(certs);
+      watch_remove(watch, file);
+    } else {
+      free(file->certs);
+      file->certs = certs;
+      file->count = count;
+    }
+
+    file = next;
+  }
+
+  fflush(watch->out);
+}
+
+/*
+ * The kernel dropped events, so nothing known can be trusted: recheck
+ * every known file, which reports the ones that are gone, and walk the
+ * tree again for new files and directories.
+ */
+static void watch_rescan(watch_t *watch) {
+  for (size_t i = 0; i < WATCH_BUCKETS; i++) {
+    for (watch_file_t *file = watch->buckets[i]; file; file = file->next) {
+      watch_mark_dirty(watch, file->path);
+    }
+  }
+  watch_scan_dir(watch, watch->root);
+}
+
+static void watch_handle_event(watch_t *watch,
+                               const struct inotify_event *event) {
+  if (event->mask & IN_Q_OVERFLOW) {
+    watch_rescan(watch);
+    return;
+  }
+
+  const char *dir = watch_dir_path(watch, event->wd);
+  if (!dir) {
+    return;
+  }
+
+  if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+    watch_mark_prefix_dirty(watch, dir);
+    watch_forget_dir(watch, event->wd);
+    return;
+  }
+
+  if (event->len == 0) {
+    return;
+  }
+
+  char path[WATCH_PATH_MAX];
+  if (snprintf(path, sizeof(path), "%s/%s", dir, event->name) >=
+      (int)sizeof(path)) {
+    return;
+  }
+
+  if (event->mask & IN_ISDIR) {
+    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+      watch_scan_dir(watch, path);
+    } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+      watch_mark_prefix_dirty(watch, path);
+    }
+    return;
+  }
+
+  watch_mark_dirty(watch, path);
+}
+
+der_error_t watch_init(watch_t *watch, const char *root, batch_format_t format,
+                       int debounce_ms, FILE *out) {
+  if (!watch || !root || !out) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  memset(watch, 0, sizeof(watch_t));
+  watch->format = format;
+  watch->debounce_ms = debounce_ms;
+  watch->out = out;
+
+  watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watch->fd < 0) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  char path[WATCH_PATH_MAX];
+  size_t len = strlen(root);
+  if (len >= sizeof(path)) {
+    watch_free(watch);
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+  memcpy(path, root, len + 1);
+  while (len > 1 && path[len - 1] == '/') {
+    path[--len] = '\0';
+  }
+
+  watch->root = strdup(path);
+  if (!watch->root) {
+    watch_free(watch);
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  if (watch_scan_dir(watch, watch->root) != 0) {
+    watch_free(watch);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  watch_flush(watch);
+  return DER_OK;
+}
+
+int watch_run(watch_t *watch, volatile sig_atomic_t *stop) {
+  char buffer[64 * 1024]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while (!*stop) {
+    struct pollfd pfd = {watch->fd, POLLIN, 0};
+    int timeout = watch->dirty ? watch->debounce_ms : -1;
+
+    int ready = poll(&pfd, 1, timeout);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+
+    if (ready == 0) {
+      watch_flush(watch);
+      continue;
+    }
+
+    ssize_t len;
+    while ((len = read(watch->fd, buffer, sizeof(buffer))) > 0) {
+      for (char *p = buffer; p < buffer + len;) {
+        const struct inotify_event *event = (const struct inotify_event *)p;
+        watch_handle_event(watch, event);
+        p += sizeof(struct inotify_event) + event->len;
+      }
+    }
+
+    if (len < 0 && errno != EAGAIN && errno != EINTR) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+void watch_free(watch_t *watch) {
+  if (!watch) {
+    return;
+  }
+
+  for (size_t i = 0; i < WATCH_BUCKETS; i++) {
+    watch_file_t *file = watch->buckets[i];
+    while (file) {
+      watch_file_t *next = file->next;
+      free(file->path);
+      free(file->certs);
+      free(file);
+      file = next;
+    }
+  }
+
+  for (size_t i = 0; i < watch->dir_count; i++) {
+    free(watch->dirs[i].path);
+  }
+  free(watch->dirs);
+  free(watch->root);
+
+  if (watch->fd >= 0) {
+    close(watch->fd);
+  }
+
+  memset(watch, 0, sizeof(watch_t));
+  watch->fd = -1;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "batch.h"
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define WATCH_BUCKETS 4096
+
+typedef struct watch_file {
+  char *path;
+  batch_cert_t *certs;
+  size_t count;
+  bool dirty;
+  struct watch_file *next;
+  struct watch_file *next_dirty;
+} watch_file_t;
+
+typedef struct {
+  char *path;
+  int wd;
+} watch_dir_t;
+
+typedef struct {
+  int fd;
+  char *root;
+  batch_format_t format;
+  int debounce_ms;
+  FILE *out;
+  watch_file_t *buckets[WATCH_BUCKETS];
+  watch_file_t *dirty;
+  watch_dir_t *dirs;
+  size_t dir_count;
+  size_t dir_capacity;
+} watch_t;
+
+der_error_t watch_init(watch_t *watch, const char *root, batch_format_t format,
+                       int debounce_ms, FILE *out);
+int watch_run(watch_t *watch, volatile sig_atomic_t *stop);
+void watch_free(watch_t *watch);
@@ -0,0 +1,565 @@
+#include "corpus.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BUILDER_MAX_DEPTH 12
+/* Room reserved for a header whose length is not known yet: tag, 0x83, 3. */
+#define BUILDER_HEADER 5
+
+/*
+ * Encodes nested DER in one forward pass. begin() reserves the largest
+ * header a certificate can need, and end() writes the real header once the
+ * contents are known and slides the contents down over the unused bytes.
+ * The first error sticks, so callers check once at the end.
+ */
+typedef struct {
+  der_ctx_t ctx;
+  size_t open[BUILDER_MAX_DEPTH];
+  size_t depth;
+  der_error_t err;
+} builder_t;
+
+static uint64_t next_random(uint64_t *rng) {
+  uint64_t x = *rng;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *rng = x;
+  return x;
+}
+
+static size_t random_below(uint64_t *rng, size_t limit) {
+  return (size_t)(next_random(rng) % limit);
+}
+
+static size_t random_between(uint64_t *rng, size_t low, size_t high) {
+  return low + random_below(rng, high - low + 1);
+}
+
+static void random_bytes(uint64_t *rng, uint8_t *out, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    out[i] = (uint8_t)next_random(rng);
+  }
+}
+
+static void check(builder_t *b, der_error_t err) {
+  if (b->err == DER_OK) {
+    b->err = err;
+  }
+}
+
+static void begin(builder_t *b, uint8_t tag) {
+  if (b->err != DER_OK) {
+    return;
+  }
+  if (b->depth == BUILDER_MAX_DEPTH) {
+    b->err = DER_ERROR_OVERFLOW;
+    return;
+  }
+  if (der_get_remaining(&b->ctx) < BUILDER_HEADER) {
+    b->err = DER_ERROR_BUFFER_TOO_SMALL;
+    return;
+  }
+  b->open[b->depth++] = b->ctx.pos;
+  b->ctx.data[b->ctx.pos] = tag;
+  b->ctx.pos += BUILDER_HEADER;
+}
+
+static void end(builder_t *b) {
+  if (b->err != DER_OK) {
+    return;
+  }
+  size_t start = b->open[--b->depth];
+  size_t contents = start + BUILDER_HEADER;
+  size_t len = b->ctx.pos - contents;
+
+  uint8_t header[BUILDER_HEADER];
+  der_ctx_t h = {header, sizeof(header), 0};
+  check(b, der_encode_tlv_header(&h, b->ctx.data[start], len));
+  if (b->err != DER_OK) {
+    return;
+  }
+  memmove(&b->ctx.data[start + h.pos], &b->ctx.data[contents], len);
+  memcpy(&b->ctx.data[start], header, h.pos);
+  b->ctx.pos = start + h.pos + len;
+}
+
+static void put(builder_t *b, const void *data, size_t len) {
+  if (b->err != DER_OK) {
+    return;
+  }
+  if (der_get_remaining(&b->ctx) < len) {
+    b->err = DER_ERROR_BUFFER_TOO_SMALL;
+    return;
+  }
+  memcpy(&b->ctx.data[b->ctx.pos], data, len);
+  b->ctx.pos += len;
+}
+
+static void put_tlv(builder_t *b, uint8_t tag, const void *data, size_t len) {
+  if (b->err == DER_OK) {
+    check(b, der_encode_tlv_header(&b->ctx, tag, len));
+  }
+  put(b, data, len);
+}
+
+static void put_oid(builder_t *b, const uint32_t *oid, size_t oid_len) {
+  if (b->err == DER_OK) {
+    check(b, der_encode_oid(&b->ctx, oid, oid_len));
+  }
+}
+
+static void put_random_integer(builder_t *b, uint64_t *rng, size_t len) {
+  uint8_t value[64];
+  random_bytes(rng, value, len);
+  value[0] |= 0x01;
+  if (b->err == DER_OK) {
+    check(b, der_encode_integer(&b->ctx, value, len));
+  }
+}
+
+static void put_bit_string(builder_t *b, uint64_t *rng, size_t len) {
+  begin(b, DER_TAG_BIT_STRING);
+  put(b, "", 1);
+  if (b->err == DER_OK && der_get_remaining(&b->ctx) >= len) {
+    random_bytes(rng, &b->ctx.data[b->ctx.pos], len);
+    b->ctx.pos += len;
+  } else {
+    check(b, DER_ERROR_BUFFER_TOO_SMALL);
+  }
+  end(b);
+}
+
+static const uint32_t oid_rsa_encryption[] = {1, 2, 840, 113549, 1, 1, 1};
+static const uint32_t oid_sha256_with_rsa[] = {1, 2, 840, 113549, 1, 1, 11};
+static const uint32_t oid_ec_public_key[] = {1, 2, 840, 10045, 2, 1};
+static const uint32_t oid_prime256v1[] = {1, 2, 840, 10045, 3, 1, 7};
+static const uint32_t oid_secp384r1[] = {1, 3, 132, 0, 34};
+static const uint32_t oid_ecdsa_sha256[] = {1, 2, 840, 10045, 4, 3, 2};
+static const uint32_t oid_ecdsa_sha384[] = {1, 2, 840, 10045, 4, 3, 3};
+static const uint32_t oid_attribute[] = {2, 5, 4, 0};
+static const uint32_t oid_extension[] = {2, 5, 29, 0};
+static const uint32_t oid_ocsp[] = {1, 3, 6, 1, 5, 5, 7, 48, 1};
+static const uint32_t oid_ca_issuers[] = {1, 3, 6, 1, 5, 5, 7, 48, 2};
+static const uint32_t oid_aia[] = {1, 3, 6, 1, 5, 5, 7, 1, 1};
+static const uint32_t oid_server_auth[] = {1, 3, 6, 1, 5, 5, 7, 3, 1};
+static const uint32_t oid_client_auth[] = {1, 3, 6, 1, 5, 5, 7, 3, 2};
+static const uint32_t oid_dv_policy[] = {2, 23, 140, 1, 2, 1};
+static const uint32_t oid_sct_list[] = {1, 3, 6, 1, 4, 1, 11129, 2, 4, 2};
+
+#define OID_LEN(oid) (sizeof(oid) / sizeof((oid)[0]))
+
+static void put_signature_algorithm(builder_t *b, corpus_key_t issuer_key) {
+  begin(b, DER_TAG_SEQUENCE);
+  switch (issuer_key) {
+  case CORPUS_KEY_RSA_2048:
+  case CORPUS_KEY_RSA_4096:
+    put_oid(b, oid_sha256_with_rsa, OID_LEN(oid_sha256_with_rsa));
+    if (b->err == DER_OK) {
+      check(b, der_encode_null(&b->ctx));
+    }
+    break;
+  case CORPUS_KEY_EC_P256:
+    put_oid(b, oid_ecdsa_sha256, OID_LEN(oid_ecdsa_sha256));
+    break;
+  case CORPUS_KEY_EC_P384:
+    put_oid(b, oid_ecdsa_sha384, OID_LEN(oid_ecdsa_sha384));
+    break;
+  }
+  end(b);
+}
+
+static void put_attribute(builder_t *b, uint32_t attr, const char *value) {
+  uint32_t oid[OID_LEN(oid_attribute)];
+  memcpy(oid, oid_attribute, sizeof(oid));
+  oid[3] = attr;
+
+  begin(b, DER_TAG_SET);
+  begin(b, DER_TAG_SEQUENCE);
+  put_oid(b, oid, OID_LEN(oid));
+  if (b->err == DER_OK) {
+    check(b, attr == 6 ? der_encode_printable_string(&b->ctx, value)
+                       : der_encode_utf8_string(&b->ctx, value));
+  }
+  end(b);
+  end(b);
+}
+
+static void put_name(builder_t *b, uint64_t *rng, size_t rdns,
+                     const char *common_name) {
+  static const uint32_t order[] = {6, 8, 7, 10};
+  char value[64];
+
+  begin(b, DER_TAG_SEQUENCE);
+  for (size_t i = 0; i + 1 < rdns; i++) {
+    uint32_t attr = i < 4 ? order[i] : 11;
+    switch (attr) {
+    case 6:
+      put_attribute(b, attr, "US");
+      continue;
+    case 8:
+      snprintf(value, sizeof(value), "State %zu", random_below(rng, 50));
+      break;
+    case 7:
+      snprintf(value, sizeof(value), "City %zu", random_below(rng, 1000));
+      break;
+    case 10:
+      snprintf(value, sizeof(value), "Example Holdings %zu",
+               random_below(rng, 100));
+      break;
+    default:
+      snprintf(value, sizeof(value), "Unit %zu Division %zu", i,
+               random_below(rng, 100));
+      break;
+    }
+    put_attribute(b, attr, value);
+  }
+  put_attribute(b, 3, common_name);
+  end(b);
+}
+
+static void put_validity(builder_t *b, uint64_t *rng) {
+  char time[16];
+  unsigned year = (unsigned)random_between(rng, 20, 26);
+  unsigned month = (unsigned)random_between(rng, 1, 12);
+  unsigned day = (unsigned)random_between(rng, 1, 28);
+
+  begin(b, DER_TAG_SEQUENCE);
+  snprintf(time, sizeof(time), "%02u%02u%02u000000Z", year, month, day);
+  put_tlv(b, DER_TAG_UTC_TIME, time, 13);
+  snprintf(time, sizeof(time), "%02u%02u%02u000000Z", year + 1, month, day);
+  put_tlv(b, DER_TAG_UTC_TIME, time, 13);
+  end(b);
+}
+
+static void put_public_key(builder_t *b, uint64_t *rng, corpus_key_t key) {
+  begin(b, DER_TAG_SEQUENCE);
+  begin(b, DER_TAG_SEQUENCE);
+  if (key == CORPUS_KEY_RSA_2048 || key == CORPUS_KEY_RSA_4096) {
+    put_oid(b, oid_rsa_encryption, OID_LEN(oid_rsa_encryption));
+    if (b->err == DER_OK) {
+      check(b, der_encode_null(&b->ctx));
+    }
+    end(b);
+
+    /* RSAPublicKey ::= SEQUENCE { modulus, publicExponent } */
+    size_t modulus_len = key == CORPUS_KEY_RSA_2048 ? 256 : 512;
+    begin(b, DER_TAG_BIT_STRING);
+    put(b, "", 1);
+    begin(b, DER_TAG_SEQUENCE);
+    begin(b, DER_TAG_INTEGER);
+    put(b, "", 1);
+    if (b->err == DER_OK && der_get_remaining(&b->ctx) >= modulus_len) {
+      random_bytes(rng, &b->ctx.data[b->ctx.pos], modulus_len);
+      b->ctx.data[b->ctx.pos] |= 0x80;
+      b->ctx.pos += modulus_len;
+    } else {
+      check(b, DER_ERROR_BUFFER_TOO_SMALL);
+    }
+    end(b);
+    if (b->err == DER_OK) {
+      check(b, der_encode_integer_uint32(&b->ctx, 65537));
+    }
+    end(b);
+    end(b);
+  } else {
+    put_oid(b, oid_ec_public_key, OID_LEN(oid_ec_public_key));
+    if (key == CORPUS_KEY_EC_P256) {
+      put_oid(b, oid_prime256v1, OID_LEN(oid_prime256v1));
+    } else {
+      put_oid(b, oid_secp384r1, OID_LEN(oid_secp384r1));
+    }
+    end(b);
+
+    /* An uncompressed point: 0x04, then x and y. */
+    size_t coordinates = key == CORPUS_KEY_EC_P256 ? 64 : 96;
+    begin(b, DER_TAG_BIT_STRING);
+    put(b, "\0\x04", 2);
+    if (b->err == DER_OK && der_get_remaining(&b->ctx) >= coordinates) {
+      random_bytes(rng, &b->ctx.data[b->ctx.pos], coordinates);
+      b->ctx.pos += coordinates;
+    } else {
+      check(b, DER_ERROR_BUFFER_TOO_SMALL);
+    }
+    end(b);
+  }
+  end(b);
+}
+
+static void begin_extension(builder_t *b, uint32_t arc, bool critical) {
+  uint32_t oid[OID_LEN(oid_extension)];
+  memcpy(oid, oid_extension, sizeof(oid));
+  oid[3] = arc;
+
+  begin(b, DER_TAG_SEQUENCE);
+  put_oid(b, oid, OID_LEN(oid));
+  if (critical && b->err == DER_OK) {
+    check(b, der_encode_boolean(&b->ctx, true));
+  }
+  begin(b, DER_TAG_OCTET_STRING);
+}
+
+static void end_extension(builder_t *b) {
+  end(b);
+  end(b);
+}
+
+static void put_key_id(builder_t *b, uint64_t *rng, uint8_t tag) {
+  uint8_t id[20];
+  random_bytes(rng, id, sizeof(id));
+  put_tlv(b, tag, id, sizeof(id));
+}
+
+/* A fixed CA's key identifier, so its AKI is the same on every leaf. */
+static void put_issuer_key_id(builder_t *b, size_t issuer) {
+  uint8_t id[20];
+  uint64_t state = 0x9E3779B97F4A7C15ULL * issuer;
+  random_bytes(&state, id, sizeof(id));
+  put_tlv(b, 0x80, id, sizeof(id));
+}
+
+static void put_san(builder_t *b, uint64_t *rng, size_t count,
+                    const char *first) {
+  char host[64];
+
+  begin_extension(b, 17, false);
+  begin(b, DER_TAG_SEQUENCE);
+  put_tlv(b, 0x82, first, strlen(first));
+  for (size_t i = 1; i < count; i++) {
+    int len = snprintf(host, sizeof(host), "host%zu.svc%zu.example.com", i,
+                       random_below(rng, 100));
+    put_tlv(b, 0x82, host, (size_t)len);
+  }
+  end(b);
+  end_extension(b);
+}
+
+static void put_aia(builder_t *b) {
+  static const char ocsp[] = "http://ocsp.example.net";
+  static const char issuer[] = "http://certs.example.net/intermediate.der";
+
+  begin(b, DER_TAG_SEQUENCE);
+  put_oid(b, oid_aia, OID_LEN(oid_aia));
+  begin(b, DER_TAG_OCTET_STRING);
+  begin(b, DER_TAG_SEQUENCE);
+  begin(b, DER_TAG_SEQUENCE);
+  put_oid(b, oid_ocsp, OID_LEN(oid_ocsp));
+  put_tlv(b, 0x86, ocsp, sizeof(ocsp) - 1);
+  end(b);
+  begin(b, DER_TAG_SEQUENCE);
+  put_oid(b, oid_ca_issuers, OID_LEN(oid_ca_issuers));
+  put_tlv(b, 0x86, issuer, sizeof(issuer) - 1);
+  end(b);
+  end(b);
+  end(b);
+  end(b);
+}
+
+/*
+ * SignedCertificateTimestampList: a TLS-encoded list of v1 SCTs (version,
+ * log ID, timestamp, no extensions, ECDSA signature) inside two OCTET
+ * STRINGs, as RFC 6962 puts it in the certificate.
+ */
+static void put_sct_list(builder_t *b, uint64_t *rng, size_t count) {
+  enum { SCT_LEN = 1 + 32 + 8 + 2 + 2 + 2 + 71 };
+
+  begin(b, DER_TAG_SEQUENCE);
+  put_oid(b, oid_sct_list, OID_LEN(oid_sct_list));
+  begin(b, DER_TAG_OCTET_STRING);
+  begin(b, DER_TAG_OCTET_STRING);
+  size_t list_len = count * (2 + SCT_LEN);
+  uint8_t length[2] = {(uint8_t)(list_len >> 8), (uint8_t)list_len};
+  put(b, length, sizeof(length));
+  for (size_t i = 0; i < count; i++) {
+    uint8_t sct[2 + SCT_LEN];
+    random_bytes(rng, sct, sizeof(sct));
+    sct[0] = 0;
+    sct[1] = SCT_LEN;
+    sct[2] = 0;
+    sct[2 + 1 + 32 + 8] = 0;
+    sct[2 + 1 + 32 + 8 + 1] = 0;
+    sct[2 + 1 + 32 + 8 + 2] = 4;
+    sct[2 + 1 + 32 + 8 + 3] = 3;
+    sct[2 + 1 + 32 + 8 + 4] = 0;
+    sct[2 + 1 + 32 + 8 + 5] = 71;
+    put(b, sct, sizeof(sct));
+  }
+  end(b);
+  end(b);
+  end(b);
+}
+
+static void put_extensions(builder_t *b, uint64_t *rng,
+                           const corpus_profile_t *profile,
+                           const char *common_name) {
+  static const uint8_t key_usage[] = {0x05, 0xA0};
+
+  begin(b, 0xA3);
+  begin(b, DER_TAG_SEQUENCE);
+
+  begin_extension(b, 15, true);
+  put_tlv(b, DER_TAG_BIT_STRING, key_usage, sizeof(key_usage));
+  end_extension(b);
+
+  begin_extension(b, 37, false);
+  begin(b, DER_TAG_SEQUENCE);
+  put_oid(b, oid_server_auth, OID_LEN(oid_server_auth));
+  put_oid(b, oid_client_auth, OID_LEN(oid_client_auth));
+  end(b);
+  end_extension(b);
+
+  begin_extension(b, 19, true);
+  begin(b, DER_TAG_SEQUENCE);
+  end(b);
+  end_extension(b);
+
+  begin_extension(b, 14, false);
+  put_key_id(b, rng, DER_TAG_OCTET_STRING);
+  end_extension(b);
+
+  begin_extension(b, 35, false);
+  begin(b, DER_TAG_SEQUENCE);
+  if (profile->issuer > 0) {
+    put_issuer_key_id(b, profile->issuer);
+  } else {
+    put_key_id(b, rng, 0x80);
+  }
+  end(b);
+  end_extension(b);
+
+  put_aia(b);
+
+  if (profile->san_count > 0) {
+    put_san(b, rng, profile->san_count, common_name);
+  }
+
+  begin_extension(b, 32, false);
+  begin(b, DER_TAG_SEQUENCE);
+  begin(b, DER_TAG_SEQUENCE);
+  put_oid(b, oid_dv_policy, OID_LEN(oid_dv_policy));
+  end(b);
+  end(b);
+  end_extension(b);
+
+  if (profile->sct_count > 0) {
+    put_sct_list(b, rng, profile->sct_count);
+  }
+
+  end(b);
+  end(b);
+}
+
+void corpus_pick_profile(uint64_t *rng, corpus_profile_t *profile) {
+  size_t roll = random_below(rng, 100);
+  profile->key = roll < 45   ? CORPUS_KEY_EC_P256
+                 : roll < 85 ? CORPUS_KEY_RSA_2048
+                 : roll < 95 ? CORPUS_KEY_RSA_4096
+                             : CORPUS_KEY_EC_P384;
+
+  roll = random_below(rng, 100);
+  profile->issuer_key = roll < 60   ? CORPUS_KEY_RSA_2048
+                        : roll < 90 ? CORPUS_KEY_EC_P384
+                                    : CORPUS_KEY_RSA_4096;
+
+  roll = random_below(rng, 100);
+  profile->san_count = roll < 35   ? 1
+                       : roll < 75 ? random_between(rng, 2, 4)
+                       : roll < 90 ? random_between(rng, 5, 20)
+                       : roll < 99 ? random_between(rng, 21, 100)
+                                   : random_between(rng, 101, 250);
+
+  roll = random_below(rng, 100);
+  profile->subject_rdns = roll < 50   ? 1
+                          : roll < 90 ? random_between(rng, 3, 5)
+                                      : random_between(rng, 8, 12);
+
+  profile->sct_count =
+      random_below(rng, 100) < 75 ? random_between(rng, 2, 3) : 0;
+  profile->issuer = 0;
+}
+
+void corpus_pick_issuer(uint64_t *rng, size_t issuers,
+                        corpus_profile_t *profile) {
+  static const corpus_key_t issuer_keys[] = {
+      CORPUS_KEY_RSA_2048, CORPUS_KEY_EC_P384, CORPUS_KEY_RSA_2048,
+      CORPUS_KEY_RSA_4096};
+
+  if (issuers == 0) {
+    profile->issuer = 0;
+    return;
+  }
+  profile->issuer = 1 + random_below(rng, issuers);
+  profile->issuer_key = issuer_keys[(profile->issuer - 1) % 4];
+}
+
+static void put_issuer_name(builder_t *b, size_t issuer) {
+  char value[64];
+
+  begin(b, DER_TAG_SEQUENCE);
+  put_attribute(b, 6, "US");
+  snprintf(value, sizeof(value), "Example Trust Services %zu", issuer);
+  put_attribute(b, 10, value);
+  snprintf(value, sizeof(value), "Example Issuing CA %zu", issuer);
+  put_attribute(b, 3, value);
+  end(b);
+}
+
+size_t corpus_generate(const corpus_profile_t *profile, uint64_t *rng,
+                       uint8_t *out, size_t size) {
+  builder_t b;
+  memset(&b, 0, sizeof(b));
+  if (der_init(&b.ctx, out, size) != DER_OK) {
+    return 0;
+  }
+
+  char common_name[64];
+  snprintf(common_name, sizeof(common_name), "www%zu.example.com",
+           random_below(rng, 1000000));
+
+  begin(&b, DER_TAG_SEQUENCE);
+  begin(&b, DER_TAG_SEQUENCE);
+
+  begin(&b, 0xA0);
+  if (b.err == DER_OK) {
+    check(&b, der_encode_integer_uint32(&b.ctx, 2));
+  }
+  end(&b);
+  put_random_integer(&b, rng, 16);
+  put_signature_algorithm(&b, profile->issuer_key);
+  if (profile->issuer > 0) {
+    put_issuer_name(&b, profile->issuer);
+  } else {
+    put_name(&b, rng, 3, "Example Issuing CA");
+  }
+  put_validity(&b, rng);
+  put_name(&b, rng, profile->subject_rdns, common_name);
+  put_public_key(&b, rng, profile->key);
+  put_extensions(&b, rng, profile, common_name);
+
+  end(&b);
+  put_signature_algorithm(&b, profile->issuer_key);
+  switch (profile->issuer_key) {
+  case CORPUS_KEY_RSA_2048:
+    put_bit_string(&b, rng, 256);
+    break;
+  case CORPUS_KEY_RSA_4096:
+    put_bit_string(&b, rng, 512);
+    break;
+  default:
+    /* ECDSA-Sig-Value ::= SEQUENCE { r INTEGER, s INTEGER } */
+    begin(&b, DER_TAG_BIT_STRING);
+    put(&b, "", 1);
+    begin(&b, DER_TAG_SEQUENCE);
+    put_random_integer(&b, rng, profile->issuer_key == CORPUS_KEY_EC_P256 ? 32
+                                                                         : 48);
+    put_random_integer(&b, rng, profile->issuer_key == CORPUS_KEY_EC_P256 ? 32
+                                                                         : 48);
+    end(&b);
+    end(&b);
+    break;
+  }
+  end(&b);
+
+  return b.err == DER_OK ? b.ctx.pos : 0;
+}
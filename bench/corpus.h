@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../der/der.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define CORPUS_MAX_CERT_SIZE 32768
+
+typedef enum {
+  CORPUS_KEY_RSA_2048,
+  CORPUS_KEY_RSA_4096,
+  CORPUS_KEY_EC_P256,
+  CORPUS_KEY_EC_P384
+} corpus_key_t;
+
+/* The shape of one generated certificate. */
+typedef struct {
+  corpus_key_t key;
+  corpus_key_t issuer_key; /* decides the signature algorithm and size */
+  size_t san_count;
+  size_t subject_rdns; /* 1 is CN only; larger values add O, OU, L, ... */
+  size_t sct_count;    /* 0 leaves out the SCT list extension */
+  size_t issuer;       /* 0 draws a random issuer DN; n is the n-th fixed CA */
+} corpus_profile_t;
+
+/*
+ * Draws a profile from a mix modelled on public web PKI: mostly P-256 and
+ * RSA-2048 keys, a few SANs with a long tail into the hundreds, CN-only
+ * subjects next to deep organisational DNs, and SCT lists on most leaves.
+ * rng is xorshift state and must be non-zero.
+ */
+void corpus_pick_profile(uint64_t *rng, corpus_profile_t *profile);
+
+/*
+ * Assigns one of `issuers` fixed issuing CAs, each with its own name, key
+ * type and key identifier, as repeat-issuer traffic such as a CT log tail
+ * would have. Call after corpus_pick_profile.
+ */
+void corpus_pick_issuer(uint64_t *rng, size_t issuers,
+                        corpus_profile_t *profile);
+
+/*
+ * Encodes a structurally valid certificate of the given shape with the
+ * der.c encoders. Keys, serials and signatures are random bytes of the
+ * right sizes, so nothing verifies, but every parser stage sees realistic
+ * lengths and nesting. Returns the DER length, or 0 if out is too small.
+ */
+size_t corpus_generate(const corpus_profile_t *profile, uint64_t *rng,
+                       uint8_t *out, size_t size);
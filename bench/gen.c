@@ -0,0 +1,108 @@
+/*
+ * Writes a synthetic certificate corpus for the benchmarks: a PEM bundle by
+ * default, or concatenated DER with --der. The same seed always produces
+ * the same corpus, so results from different trees stay comparable. With
+ * -i the certificates come from that many fixed issuing CAs instead of each
+ * naming a random one.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../b64/b64.h"
+#include "corpus.h"
+
+#define PEM_LINE_BYTES 48
+
+static int write_pem(FILE *out, const uint8_t *der, size_t len) {
+  char line[PEM_LINE_BYTES / 3 * 4 + 1];
+
+  fputs("-----BEGIN CERTIFICATE-----\n", out);
+  for (size_t i = 0; i < len; i += PEM_LINE_BYTES) {
+    size_t n = len - i < PEM_LINE_BYTES ? len - i : PEM_LINE_BYTES;
+    int chars = base64_encode(der + i, n, line, sizeof(line) - 1);
+    if (chars < 0) {
+      return -1;
+    }
+    line[chars] = '\n';
+    fwrite(line, 1, (size_t)chars + 1, out);
+  }
+  fputs("-----END CERTIFICATE-----\n", out);
+  return ferror(out) ? -1 : 0;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "Usage: %s [-n COUNT] [-s SEED] [-i ISSUERS] [--der] OUTPUT\n",
+          argv0);
+}
+
+int main(int argc, char *argv[]) {
+  size_t count = 5000;
+  uint64_t seed = 0x5EED;
+  size_t issuers = 0;
+  bool der = false;
+  const char *path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      count = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seed = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+      issuers = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--der") == 0) {
+      der = true;
+    } else if (argv[i][0] != '-' && !path) {
+      path = argv[i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (!path || count == 0 || seed == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *out = fopen(path, "wb");
+  if (!out) {
+    fprintf(stderr, "Error: cannot create %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+
+  static uint8_t buffer[CORPUS_MAX_CERT_SIZE];
+  uint64_t rng = seed;
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    corpus_profile_t profile;
+    corpus_pick_profile(&rng, &profile);
+    corpus_pick_issuer(&rng, issuers, &profile);
+    size_t len = corpus_generate(&profile, &rng, buffer, sizeof(buffer));
+    if (len == 0) {
+      fprintf(stderr, "Error: certificate %zu does not fit in %d bytes\n", i,
+              CORPUS_MAX_CERT_SIZE);
+      fclose(out);
+      return 1;
+    }
+
+    int err = der ? (fwrite(buffer, 1, len, out) == len ? 0 : -1)
+                  : write_pem(out, buffer, len);
+    if (err != 0) {
+      fprintf(stderr, "Error: writing %s: %s\n", path, strerror(errno));
+      fclose(out);
+      return 1;
+    }
+    total += len;
+  }
+
+  if (fclose(out) != 0) {
+    fprintf(stderr, "Error: writing %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  fprintf(stderr, "Wrote %zu certificates (%zu DER bytes) to %s\n", count,
+          total, path);
+  return 0;
+}
@@ -0,0 +1,535 @@
+/*
+ * Microbenchmarks for the DER, base64 and OID primitives. Each case decodes
+ * a buffer of a few thousand crafted items back to back; one pass over the
+ * buffer is one sample. After a warmup, samples outside the upper Tukey
+ * fence (Q3 + 1.5 IQR) are treated as interrupts or migrations and dropped,
+ * and the rest are averaged. On x86 samples are read from the TSC, which
+ * ticks at the nominal frequency; elsewhere they are nanoseconds.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../b64/b64.h"
+#include "../der/der.h"
+#include "../util/oids.h"
+#include "../util/util.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MICRO_CLOCK "tsc"
+static inline uint64_t read_ticks(void) {
+  _mm_lfence();
+  uint64_t ticks = __rdtsc();
+  _mm_lfence();
+  return ticks;
+}
+#else
+#define MICRO_CLOCK "ns"
+static inline uint64_t read_ticks(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define MICRO_ITEMS 4096
+#define MICRO_WARMUP 20
+#define MICRO_SAMPLES 201
+#define MICRO_MAX_ARCS 16
+
+typedef struct {
+  uint32_t arcs[MICRO_MAX_ARCS];
+  size_t len;
+} micro_oid_t;
+
+typedef struct {
+  uint8_t *data;
+  size_t len;
+  size_t items;
+  size_t item_len; /* base64 cases: characters per block */
+  micro_oid_t *oids;
+} micro_input_t;
+
+typedef struct {
+  const char *name;
+  bool (*build)(micro_input_t *input);
+  size_t (*run)(const micro_input_t *input);
+} micro_case_t;
+
+typedef struct {
+  size_t kept;
+  double mean;
+  uint64_t min;
+  uint64_t median;
+} micro_result_t;
+
+static uint64_t rng = 0x9E3779B97F4A7C15u;
+
+static uint64_t next_random(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static bool alloc_input(micro_input_t *input, size_t size) {
+  input->data = malloc(size);
+  input->len = 0;
+  input->items = 0;
+  return input->data != NULL;
+}
+
+/* Builders. Each fills input with MICRO_ITEMS encodings of one shape. */
+
+static bool build_lengths(micro_input_t *input, size_t min, size_t max) {
+  if (!alloc_input(input, MICRO_ITEMS * 5)) {
+    return false;
+  }
+  der_ctx_t ctx = {input->data, MICRO_ITEMS * 5, 0};
+  for (size_t i = 0; i < MICRO_ITEMS; i++) {
+    size_t length = min + (size_t)(next_random() % (max - min + 1));
+    if (der_encode_length(&ctx, length) != DER_OK) {
+      return false;
+    }
+  }
+  input->len = ctx.pos;
+  input->items = MICRO_ITEMS;
+  return true;
+}
+
+static bool build_length_short(micro_input_t *input) {
+  return build_lengths(input, 0, 0x7F);
+}
+
+static bool build_length_long1(micro_input_t *input) {
+  return build_lengths(input, 0x80, 0xFF);
+}
+
+static bool build_length_long2(micro_input_t *input) {
+  return build_lengths(input, 0x100, 0xFFFF);
+}
+
+static bool build_length_long3(micro_input_t *input) {
+  return build_lengths(input, 0x10000, 0xFFFFFF);
+}
+
+static bool build_tlvs(micro_input_t *input, size_t min, size_t max) {
+  size_t size = MICRO_ITEMS * (max + 4);
+  if (!alloc_input(input, size)) {
+    return false;
+  }
+  der_ctx_t ctx = {input->data, size, 0};
+  for (size_t i = 0; i < MICRO_ITEMS; i++) {
+    size_t length = min + (size_t)(next_random() % (max - min + 1));
+    uint8_t tag = i % 3 == 0 ? DER_TAG_SEQUENCE : DER_TAG_OCTET_STRING;
+    if (der_encode_tlv_header(&ctx, tag, length) != DER_OK) {
+      return false;
+    }
+    memset(&ctx.data[ctx.pos], 0x5A, length);
+    ctx.pos += length;
+  }
+  input->len = ctx.pos;
+  input->items = MICRO_ITEMS;
+  return true;
+}
+
+static bool build_tlv_short(micro_input_t *input) {
+  return build_tlvs(input, 1, 24);
+}
+
+static bool build_tlv_long(micro_input_t *input) {
+  return build_tlvs(input, 256, 1024);
+}
+
+static bool build_oids(micro_input_t *input, const micro_oid_t *shapes,
+                       size_t shape_count) {
+  size_t size = MICRO_ITEMS * (2 + MICRO_MAX_ARCS * 5);
+  if (!alloc_input(input, size)) {
+    return false;
+  }
+  der_ctx_t ctx = {input->data, size, 0};
+  for (size_t i = 0; i < MICRO_ITEMS; i++) {
+    const micro_oid_t *oid = &shapes[next_random() % shape_count];
+    if (der_encode_oid(&ctx, oid->arcs, oid->len) != DER_OK) {
+      return false;
+    }
+  }
+  input->len = ctx.pos;
+  input->items = MICRO_ITEMS;
+  return true;
+}
+
+/* Arcs as they appear in certificates: names, algorithms, extensions. */
+static const micro_oid_t common_oids[] = {
+    {{2, 5, 4, 3}, 4},
+    {{2, 5, 4, 10}, 4},
+    {{2, 5, 29, 17}, 4},
+    {{2, 5, 29, 35}, 4},
+    {{1, 2, 840, 113549, 1, 1, 11}, 7},
+    {{1, 2, 840, 10045, 2, 1}, 6},
+    {{1, 2, 840, 10045, 4, 3, 2}, 7},
+    {{1, 3, 6, 1, 5, 5, 7, 1, 1}, 9},
+    {{1, 3, 6, 1, 4, 1, 11129, 2, 4, 2}, 10},
+    {{2, 23, 140, 1, 2, 1}, 6},
+};
+
+/* Four- and five-byte arcs, as in Microsoft template and private OIDs. */
+static const micro_oid_t large_arc_oids[] = {
+    {{1, 3, 6, 1, 4, 1, 311, 21, 8, 16777215, 268435455, 4294967295u}, 12},
+    {{1, 3, 6, 1, 4, 1, 311, 21, 8, 2147483647, 134217727, 99999999}, 12},
+    {{1, 3, 6, 1, 4, 1, 4294967295u, 4294967295u, 4294967295u}, 9},
+};
+
+/* OIDs get_oid_name has names for. */
+static const micro_oid_t named_oids[] = {
+    {{1, 2, 840, 113549, 1, 1, 1}, 7},
+    {{1, 2, 840, 113549, 1, 1, 11}, 7},
+    {{2, 5, 29, 14}, 4},
+    {{2, 5, 29, 17}, 4},
+    {{2, 5, 29, 19}, 4},
+    {{2, 5, 29, 35}, 4},
+    {{1, 3, 6, 1, 4, 1, 11129, 2, 4, 2}, 10},
+};
+
+#define COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+static bool build_oid_common(micro_input_t *input) {
+  return build_oids(input, common_oids, COUNT(common_oids));
+}
+
+static bool build_oid_large(micro_input_t *input) {
+  return build_oids(input, large_arc_oids, COUNT(large_arc_oids));
+}
+
+static bool build_base64(micro_input_t *input, size_t block, bool wrap) {
+  size_t per_block = block + (wrap ? block / 64 + 1 : 0);
+  size_t blocks = MICRO_ITEMS / 16;
+  if (!alloc_input(input, blocks * per_block)) {
+    return false;
+  }
+
+  uint8_t raw[MICRO_ITEMS * 4];
+  char encoded[MICRO_ITEMS * 6];
+  size_t raw_len = block / 4 * 3;
+  for (size_t i = 0; i < blocks; i++) {
+    for (size_t j = 0; j < raw_len; j++) {
+      raw[j] = (uint8_t)next_random();
+    }
+    int len = base64_encode(raw, raw_len, encoded, sizeof(encoded));
+    if (len < 0) {
+      return false;
+    }
+
+    char *out = (char *)&input->data[i * per_block];
+    size_t o = 0;
+    for (size_t j = 0; j < (size_t)len; j++) {
+      out[o++] = encoded[j];
+      if (wrap && j % 64 == 63) {
+        out[o++] = '\n';
+      }
+    }
+    while (o < per_block) {
+      out[o++] = '\n';
+    }
+  }
+  input->len = blocks * per_block;
+  input->items = blocks;
+  input->item_len = per_block;
+  return true;
+}
+
+static bool build_base64_pem(micro_input_t *input) {
+  return build_base64(input, 2048, true);
+}
+
+static bool build_base64_raw(micro_input_t *input) {
+  return build_base64(input, 16384, false);
+}
+
+static bool build_names(micro_input_t *input, bool hit) {
+  input->oids = calloc(MICRO_ITEMS, sizeof(micro_oid_t));
+  if (!input->oids) {
+    return false;
+  }
+  for (size_t i = 0; i < MICRO_ITEMS; i++) {
+    micro_oid_t *oid = &input->oids[i];
+    if (hit) {
+      *oid = named_oids[next_random() % COUNT(named_oids)];
+    } else {
+      /* Private arcs, at lengths that reach each comparison chain. */
+      *oid = (micro_oid_t){{1, 3, 6, 1, 4, 1, (uint32_t)next_random(), 1,
+                            2, 3},
+                           4 + next_random() % 7};
+    }
+  }
+  input->items = MICRO_ITEMS;
+  input->len = MICRO_ITEMS * sizeof(micro_oid_t);
+  return true;
+}
+
+static bool build_name_hit(micro_input_t *input) {
+  return build_names(input, true);
+}
+
+static bool build_name_miss(micro_input_t *input) {
+  return build_names(input, false);
+}
+
+/*
+ * Private OIDs that only a registry names, looked up through get_oid_name:
+ * a miss in the built-in chains, then a probe of the installed snapshot.
+ */
+#define MICRO_REGISTERED 64
+
+static bool build_name_registry(micro_input_t *input) {
+  static oid_registry_t registry;
+  static bool loaded;
+  if (!loaded) {
+    oid_registry_init(&registry);
+    for (uint32_t i = 0; i < MICRO_REGISTERED; i++) {
+      uint32_t arcs[] = {1, 3, 6, 1, 4, 1, 99999, 1, i};
+      if (oid_registry_add(&registry, arcs, COUNT(arcs), "private", NULL,
+                           NULL) != DER_OK) {
+        return false;
+      }
+    }
+    oid_registry_install(&registry);
+    loaded = true;
+  }
+
+  input->oids = calloc(MICRO_ITEMS, sizeof(micro_oid_t));
+  if (!input->oids) {
+    return false;
+  }
+  for (size_t i = 0; i < MICRO_ITEMS; i++) {
+    input->oids[i] = (micro_oid_t){
+        {1, 3, 6, 1, 4, 1, 99999, 1, (uint32_t)(next_random() %
+                                                MICRO_REGISTERED)},
+        9};
+  }
+  input->items = MICRO_ITEMS;
+  input->len = MICRO_ITEMS * sizeof(micro_oid_t);
+  return true;
+}
+
+/* Runners. Each returns a value derived from every item it decoded. */
+
+static size_t run_length(const micro_input_t *input) {
+  der_ctx_t ctx = {input->data, input->len, 0};
+  size_t sum = 0;
+  while (ctx.pos < ctx.size) {
+    size_t length;
+    if (der_decode_length(&ctx, &length) != DER_OK) {
+      return 0;
+    }
+    sum += length;
+  }
+  return sum;
+}
+
+static size_t run_tlv(const micro_input_t *input) {
+  der_ctx_t ctx = {input->data, input->len, 0};
+  size_t sum = 0;
+  while (ctx.pos < ctx.size) {
+    der_tlv_t tlv;
+    if (der_decode_tlv(&ctx, &tlv) != DER_OK) {
+      return 0;
+    }
+    sum += tlv.length + tlv.tag;
+  }
+  return sum;
+}
+
+static size_t run_oid(const micro_input_t *input) {
+  der_ctx_t ctx = {input->data, input->len, 0};
+  size_t sum = 0;
+  while (ctx.pos < ctx.size) {
+    uint32_t oid[MICRO_MAX_ARCS];
+    size_t len;
+    if (der_decode_oid(&ctx, oid, &len, MICRO_MAX_ARCS) != DER_OK) {
+      return 0;
+    }
+    sum += oid[len - 1] + len;
+  }
+  return sum;
+}
+
+static size_t run_skip(const micro_input_t *input) {
+  der_ctx_t ctx = {input->data, input->len, 0};
+  size_t count = 0;
+  while (ctx.pos < ctx.size) {
+    if (der_skip_element(&ctx) != DER_OK) {
+      return 0;
+    }
+    count++;
+  }
+  return count;
+}
+
+static size_t run_base64(const micro_input_t *input) {
+  static uint8_t out[MICRO_ITEMS * 4];
+  size_t sum = 0;
+  for (size_t i = 0; i < input->items; i++) {
+    int len = base64_decode_n((const char *)&input->data[i * input->item_len],
+                              input->item_len, out, sizeof(out));
+    sum += (size_t)len + out[0];
+  }
+  return sum;
+}
+
+static size_t run_names(const micro_input_t *input) {
+  size_t hits = 0;
+  for (size_t i = 0; i < input->items; i++) {
+    hits += get_oid_name(input->oids[i].arcs, input->oids[i].len) != NULL;
+  }
+  return hits;
+}
+
+static const micro_case_t cases[] = {
+    {"der_decode_length/short", build_length_short, run_length},
+    {"der_decode_length/long1", build_length_long1, run_length},
+    {"der_decode_length/long2", build_length_long2, run_length},
+    {"der_decode_length/long3", build_length_long3, run_length},
+    {"der_decode_tlv/short", build_tlv_short, run_tlv},
+    {"der_decode_tlv/long", build_tlv_long, run_tlv},
+    {"der_decode_oid/common", build_oid_common, run_oid},
+    {"der_decode_oid/large_arcs", build_oid_large, run_oid},
+    {"der_skip_element/short", build_tlv_short, run_skip},
+    {"der_skip_element/long", build_tlv_long, run_skip},
+    {"base64_decode/pem_2k", build_base64_pem, run_base64},
+    {"base64_decode/raw_16k", build_base64_raw, run_base64},
+    {"get_oid_name/hit", build_name_hit, run_names},
+    {"get_oid_name/miss", build_name_miss, run_names},
+    {"get_oid_name/registry", build_name_registry, run_names},
+};
+
+static int compare_ticks(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static micro_result_t measure(const micro_case_t *c,
+                              const micro_input_t *input, size_t samples) {
+  uint64_t ticks[MICRO_SAMPLES];
+  volatile size_t sink = 0;
+
+  for (size_t i = 0; i < MICRO_WARMUP; i++) {
+    sink += c->run(input);
+  }
+  for (size_t i = 0; i < samples; i++) {
+    uint64_t start = read_ticks();
+    sink += c->run(input);
+    ticks[i] = read_ticks() - start;
+  }
+  (void)sink;
+
+  qsort(ticks, samples, sizeof(ticks[0]), compare_ticks);
+  uint64_t q1 = ticks[samples / 4];
+  uint64_t q3 = ticks[samples * 3 / 4];
+  double fence = (double)q3 + 1.5 * (double)(q3 - q1);
+
+  micro_result_t result = {0, 0, ticks[0], ticks[samples / 2]};
+  for (size_t i = 0; i < samples && (double)ticks[i] <= fence; i++) {
+    result.mean += (double)ticks[i];
+    result.kept++;
+  }
+  result.mean /= (double)result.kept;
+  return result;
+}
+
+/* Ticks per nanosecond, so TSC results can also be read as time. */
+static double calibrate(void) {
+  struct timespec a, b;
+  clock_gettime(CLOCK_MONOTONIC, &a);
+  uint64_t start = read_ticks();
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &b);
+  } while ((b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec) <
+           50000000L);
+  uint64_t ticks = read_ticks() - start;
+  double ns = (double)(b.tv_sec - a.tv_sec) * 1e9 +
+              (double)(b.tv_nsec - a.tv_nsec);
+  return (double)ticks / ns;
+}
+
+int main(int argc, char *argv[]) {
+  bool json = false;
+  size_t samples = MICRO_SAMPLES;
+  const char *filter = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      samples = strtoul(argv[++i], NULL, 10);
+    } else if (argv[i][0] != '-' && !filter) {
+      filter = argv[i];
+    } else {
+      samples = 0;
+      break;
+    }
+  }
+  if (samples < 8 || samples > MICRO_SAMPLES) {
+    fprintf(stderr, "Usage: %s [--json] [-s SAMPLES] [FILTER]\n", argv[0]);
+    fprintf(stderr, "SAMPLES is 8 to %d; FILTER matches case names.\n",
+            MICRO_SAMPLES);
+    return 1;
+  }
+
+  double ticks_per_ns = calibrate();
+  if (json) {
+    printf("{\n  \"clock\": \"%s\",\n  \"ticks_per_ns\": %.4f,\n"
+           "  \"cases\": [\n",
+           MICRO_CLOCK, ticks_per_ns);
+  } else {
+    printf("clock: %s (%.3f ticks/ns)\n", MICRO_CLOCK, ticks_per_ns);
+    printf("%-28s %8s %10s %10s %9s %5s\n", "case", "items", "ticks/item",
+           "ticks/byte", "ns/item", "kept");
+  }
+
+  bool first = true;
+  for (size_t i = 0; i < COUNT(cases); i++) {
+    const micro_case_t *c = &cases[i];
+    if (filter && !strstr(c->name, filter)) {
+      continue;
+    }
+
+    micro_input_t input;
+    memset(&input, 0, sizeof(input));
+    if (!c->build(&input)) {
+      fprintf(stderr, "Error: cannot build input for %s\n", c->name);
+      return 1;
+    }
+    micro_result_t r = measure(c, &input, samples);
+
+    double per_item = r.mean / (double)input.items;
+    double per_byte = r.mean / (double)input.len;
+    if (json) {
+      printf("%s    {\"name\": \"%s\", \"items\": %zu, \"bytes\": %zu, "
+             "\"samples\": %zu, \"kept\": %zu, \"min_ticks\": %llu, "
+             "\"median_ticks\": %llu, \"ticks_per_item\": %.2f, "
+             "\"ticks_per_byte\": %.3f, \"ns_per_item\": %.2f}",
+             first ? "" : ",\n", c->name, input.items, input.len, samples,
+             r.kept, (unsigned long long)r.min,
+             (unsigned long long)r.median, per_item, per_byte,
+             per_item / ticks_per_ns);
+    } else {
+      printf("%-28s %8zu %10.2f %10.3f %9.2f %5zu\n", c->name, input.items,
+             per_item, per_byte, per_item / ticks_per_ns, r.kept);
+    }
+    first = false;
+
+    free(input.data);
+    free(input.oids);
+  }
+
+  if (json) {
+    printf("\n  ]\n}\n");
+  }
+  return 0;
+}
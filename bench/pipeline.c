@@ -0,0 +1,274 @@
+/*
+ * Times each stage of the certificate pipeline over a PEM corpus and writes
+ * the results as JSON. Stages run one at a time over the whole corpus, so
+ * each number is that stage's cost alone with warm caches. The inputs of a
+ * stage are prepared by the stages before it outside the timed region.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../b64/b64.h"
+#include "../batch/batch.h"
+#include "../der/der_utils.h"
+#include "../util/util.h"
+#include "../x509/x509.h"
+
+#define PEM_BEGIN "-----BEGIN CERTIFICATE-----"
+#define PEM_END "-----END CERTIFICATE-----"
+
+typedef struct {
+  const char *text;
+  size_t text_len;
+  size_t count;
+  size_t *body;     /* offset of each base64 body in text */
+  size_t *body_len;
+  uint8_t **der;
+  size_t *der_len;
+  size_t body_bytes;
+  size_t der_bytes;
+  batch_cert_t *summary;
+  FILE *sink;
+} corpus_t;
+
+typedef struct {
+  const char *name;
+  size_t (*run)(corpus_t *corpus);
+  size_t bytes; /* filled in from the corpus once it is loaded */
+  double seconds;
+} stage_t;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Each stage returns a value derived from its work so none is elided. */
+static size_t stage_pem_scan(corpus_t *corpus) {
+  size_t count = 0;
+  const char *p = corpus->text;
+  while ((p = strstr(p, PEM_BEGIN)) != NULL) {
+    const char *start = p + strlen(PEM_BEGIN);
+    const char *stop = strstr(start, PEM_END);
+    if (!stop) {
+      break;
+    }
+    corpus->body[count] = (size_t)(start - corpus->text);
+    corpus->body_len[count] = (size_t)(stop - start);
+    count++;
+    p = stop + strlen(PEM_END);
+  }
+  return count;
+}
+
+static size_t stage_base64(corpus_t *corpus) {
+  size_t total = 0;
+  for (size_t i = 0; i < corpus->count; i++) {
+    int len = base64_decode_n(corpus->text + corpus->body[i],
+                              corpus->body_len[i], corpus->der[i],
+                              corpus->body_len[i] * 3 / 4 + 1);
+    corpus->der_len[i] = len > 0 ? (size_t)len : 0;
+    total += corpus->der_len[i];
+  }
+  return total;
+}
+
+static size_t stage_validate(corpus_t *corpus) {
+  size_t valid = 0;
+  for (size_t i = 0; i < corpus->count; i++) {
+    valid += der_validate_structure(corpus->der[i], corpus->der_len[i]) ==
+             DER_OK;
+  }
+  return valid;
+}
+
+static size_t stage_parse(corpus_t *corpus) {
+  static x509_cert_t cert;
+  size_t sans = 0;
+  for (size_t i = 0; i < corpus->count; i++) {
+    if (x509_extract(corpus->der[i], corpus->der_len[i], &cert) == DER_OK) {
+      sans += cert.san_count;
+    }
+  }
+  return sans;
+}
+
+static size_t stage_summarize(corpus_t *corpus) {
+  size_t ok = 0;
+  for (size_t i = 0; i < corpus->count; i++) {
+    ok += batch_summarize(corpus->der[i], corpus->der_len[i],
+                          &corpus->summary[i]) == DER_OK;
+  }
+  return ok;
+}
+
+static size_t stage_output(corpus_t *corpus) {
+  for (size_t i = 0; i < corpus->count; i++) {
+    batch_emit(corpus->sink, BATCH_FORMAT_JSON, NULL, "corpus",
+               &corpus->summary[i]);
+  }
+  fflush(corpus->sink);
+  return corpus->count;
+}
+
+static int load_corpus(const char *path, corpus_t *corpus) {
+  memset(corpus, 0, sizeof(*corpus));
+  uint8_t *data = read_file(path, &corpus->text_len);
+  if (!data) {
+    return -1;
+  }
+  corpus->text = (const char *)data;
+
+  size_t capacity = 0;
+  for (const char *p = corpus->text; (p = strstr(p, PEM_BEGIN)) != NULL;
+       p += strlen(PEM_BEGIN)) {
+    capacity++;
+  }
+  if (capacity == 0) {
+    return -1;
+  }
+
+  corpus->body = calloc(capacity, sizeof(size_t));
+  corpus->body_len = calloc(capacity, sizeof(size_t));
+  corpus->der = calloc(capacity, sizeof(uint8_t *));
+  corpus->der_len = calloc(capacity, sizeof(size_t));
+  corpus->summary = calloc(capacity, sizeof(batch_cert_t));
+  corpus->sink = fopen("/dev/null", "w");
+  if (!corpus->body || !corpus->body_len || !corpus->der ||
+      !corpus->der_len || !corpus->summary || !corpus->sink) {
+    return -1;
+  }
+
+  corpus->count = stage_pem_scan(corpus);
+  for (size_t i = 0; i < corpus->count; i++) {
+    corpus->body_bytes += corpus->body_len[i];
+    corpus->der[i] = malloc(corpus->body_len[i] * 3 / 4 + 1);
+    if (!corpus->der[i]) {
+      return -1;
+    }
+  }
+  corpus->der_bytes = stage_base64(corpus);
+  stage_summarize(corpus);
+  return 0;
+}
+
+static void free_corpus(corpus_t *corpus) {
+  for (size_t i = 0; corpus->der && i < corpus->count; i++) {
+    free(corpus->der[i]);
+  }
+  free(corpus->der);
+  free(corpus->der_len);
+  free(corpus->body);
+  free(corpus->body_len);
+  free(corpus->summary);
+  free((void *)corpus->text);
+  if (corpus->sink) {
+    fclose(corpus->sink);
+  }
+}
+
+static void write_results(FILE *out, const char *path, const corpus_t *corpus,
+                          const stage_t *stages, size_t stage_count,
+                          int rounds) {
+  double total = 0;
+  fprintf(out, "{\n  \"corpus\": {\"path\": \"%s\", \"certificates\": %zu, "
+               "\"pem_bytes\": %zu, \"der_bytes\": %zu},\n",
+          path, corpus->count, corpus->text_len, corpus->der_bytes);
+  fprintf(out, "  \"rounds\": %d,\n  \"stages\": [\n", rounds);
+  for (size_t i = 0; i < stage_count; i++) {
+    const stage_t *stage = &stages[i];
+    total += stage->seconds;
+    fprintf(out,
+            "    {\"name\": \"%s\", \"seconds\": %.6f, \"certs_per_sec\": "
+            "%.0f, \"bytes_per_sec\": %.0f, \"ns_per_cert\": %.1f}%s\n",
+            stage->name, stage->seconds,
+            (double)corpus->count / stage->seconds,
+            (double)stage->bytes / stage->seconds,
+            stage->seconds * 1e9 / (double)corpus->count,
+            i + 1 < stage_count ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"total\": {\"seconds\": %.6f, \"certs_per_sec\": "
+               "%.0f}\n}\n",
+          total, (double)corpus->count / total);
+}
+
+int main(int argc, char *argv[]) {
+  int rounds = 5;
+  const char *output = NULL;
+  const char *path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      rounds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (argv[i][0] != '-' && !path) {
+      path = argv[i];
+    } else {
+      path = NULL;
+      break;
+    }
+  }
+  if (!path || rounds < 1) {
+    fprintf(stderr, "Usage: %s [-r ROUNDS] [-o RESULTS.json] CORPUS.pem\n",
+            argv[0]);
+    return 1;
+  }
+
+  corpus_t corpus;
+  if (load_corpus(path, &corpus) != 0 || corpus.count == 0) {
+    fprintf(stderr, "Error: cannot load a PEM corpus from %s\n", path);
+    free_corpus(&corpus);
+    return 1;
+  }
+
+  stage_t stages[] = {
+      {"pem_scan", stage_pem_scan, corpus.text_len, 0},
+      {"base64", stage_base64, corpus.body_bytes, 0},
+      {"der_validate", stage_validate, corpus.der_bytes, 0},
+      {"x509_parse", stage_parse, corpus.der_bytes, 0},
+      {"summarize", stage_summarize, corpus.der_bytes, 0},
+      {"output", stage_output, corpus.der_bytes, 0},
+  };
+  size_t stage_count = sizeof(stages) / sizeof(stages[0]);
+
+  /* Best of rounds after one warmup pass; the minimum is the least noisy. */
+  volatile size_t sink = 0;
+  for (size_t s = 0; s < stage_count; s++) {
+    sink += stages[s].run(&corpus);
+    for (int r = 0; r < rounds; r++) {
+      double start = now_seconds();
+      sink += stages[s].run(&corpus);
+      double elapsed = now_seconds() - start;
+      if (r == 0 || elapsed < stages[s].seconds) {
+        stages[s].seconds = elapsed;
+      }
+    }
+  }
+  (void)sink;
+
+  for (size_t s = 0; s < stage_count; s++) {
+    fprintf(stderr, "%-13s %10.0f certs/s %9.1f MB/s %8.1f ns/cert\n",
+            stages[s].name, (double)corpus.count / stages[s].seconds,
+            (double)stages[s].bytes / stages[s].seconds / 1e6,
+            stages[s].seconds * 1e9 / (double)corpus.count);
+  }
+
+  FILE *out = stdout;
+  if (output && !(out = fopen(output, "w"))) {
+    perror(output);
+    free_corpus(&corpus);
+    return 1;
+  }
+  write_results(out, path, &corpus, stages, stage_count, rounds);
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  free_corpus(&corpus);
+  return 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+int cmd_batch(int argc, char *argv[]);
+int cmd_crl(int argc, char *argv[]);
+int cmd_diff(int argc, char *argv[]);
+int cmd_group(int argc, char *argv[]);
+int cmd_loadgen(int argc, char *argv[]);
+int cmd_p7b(int argc, char *argv[]);
+int cmd_server(int argc, char *argv[]);
+int cmd_snapshot(int argc, char *argv[]);
+int cmd_store(int argc, char *argv[]);
+int cmd_stream(int argc, char *argv[]);
+int cmd_watch(int argc, char *argv[]);
@@ -0,0 +1,172 @@
+#include "../batch/batch.h"
+#include "../batch/scan_cache.h"
+#include "../der/der_utils.h"
+#include "../query/query.h"
+#include "../util/trace.h"
+#include "cmd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  scan_cache_t *cache;
+  query_t *where;
+  arena_t *arena;
+  batch_format_t format;
+  size_t files;
+  size_t cache_hits;
+  size_t parsed;
+  size_t certs;
+  size_t failed;
+} batch_run_t;
+
+static void batch_usage(void) {
+  fprintf(stderr, "Usage: main --batch [--cache FILE] [--format text|json] "
+                  "[--where EXPR] PATH...\n");
+}
+
+static bool batch_where(const uint8_t *der_data, size_t der_len, void *user) {
+  return query_match(user, der_data, der_len);
+}
+
+static int visit_file(const char *path, const struct stat *st, void *user) {
+  batch_run_t *run = user;
+  run->files++;
+
+  if (run->cache) {
+    const scan_cache_entry_t *entry = scan_cache_lookup(run->cache, st);
+    if (entry) {
+      const batch_cert_t *certs = scan_cache_certs(run->cache, entry);
+      for (uint32_t i = 0; i < entry->cert_count; i++) {
+        batch_emit(stdout, run->format, NULL, path, &certs[i]);
+      }
+      run->cache_hits++;
+      run->certs += entry->cert_count;
+      return scan_cache_record(run->cache, st, certs, entry->cert_count) ==
+                     DER_OK
+                 ? 0
+                 : -1;
+    }
+  }
+
+  arena_mark_t mark = arena_mark(run->arena);
+  batch_cert_t *certs;
+  size_t count;
+  if (batch_parse_file_arena(path, run->where ? batch_where : NULL, run->where,
+                             run->arena, &certs, &count) != 0) {
+    arena_release(run->arena, mark);
+    run->failed++;
+    return 0;
+  }
+  run->parsed++;
+
+  for (size_t i = 0; i < count; i++) {
+    batch_emit(stdout, run->format, NULL, path, &certs[i]);
+  }
+  run->certs += count;
+
+  int result = 0;
+  if (run->cache && scan_cache_record(run->cache, st, certs, count) != DER_OK) {
+    result = -1;
+  }
+
+  arena_release(run->arena, mark);
+  return result;
+}
+
+static int batch_visit(const char *path, const struct stat *st, void *user) {
+  TRACE_BEGIN(start);
+  int result = visit_file(path, st, user);
+  TRACE_END(start, "file", path);
+  return result;
+}
+
+int cmd_batch(int argc, char *argv[]) {
+  const char *cache_path = NULL;
+  const char *where = NULL;
+  batch_run_t run;
+  memset(&run, 0, sizeof(run));
+
+  int i = 0;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+    if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+      cache_path = argv[++i];
+    } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      if (!batch_parse_format(argv[++i], &run.format)) {
+        batch_usage();
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--where") == 0 && i + 1 < argc) {
+      where = argv[++i];
+    } else {
+      batch_usage();
+      return 1;
+    }
+  }
+
+  if (i >= argc) {
+    batch_usage();
+    return 1;
+  }
+
+  run.arena = arena_thread();
+  if (!run.arena) {
+    return 1;
+  }
+
+  if (where && cache_path) {
+    fprintf(stderr, "--where cannot be combined with --cache\n");
+    return 1;
+  }
+
+  query_t query;
+  if (where) {
+    char error[160];
+    if (query_compile(where, (int64_t)time(NULL), &query, error,
+                      sizeof(error)) != 0) {
+      fprintf(stderr, "Invalid --where expression: %s\n", error);
+      return 1;
+    }
+    run.where = &query;
+  }
+
+  scan_cache_t cache;
+  if (cache_path) {
+    der_error_t err = scan_cache_open(&cache, cache_path);
+    if (err != DER_OK) {
+      fprintf(stderr, "Failed to open cache %s: %s\n", cache_path,
+              der_error_to_string(err));
+      query_free(run.where);
+      return 1;
+    }
+    run.cache = &cache;
+  }
+
+  int result = 0;
+  for (; i < argc; i++) {
+    if (batch_walk(argv[i], batch_visit, &run) != 0) {
+      fprintf(stderr, "Failed to scan %s\n", argv[i]);
+      result = 1;
+    }
+  }
+
+  if (run.cache) {
+    if (result == 0) {
+      der_error_t err = scan_cache_commit(run.cache, cache_path);
+      if (err != DER_OK) {
+        fprintf(stderr, "Failed to write cache %s: %s\n", cache_path,
+                der_error_to_string(err));
+        result = 1;
+      }
+    }
+    scan_cache_close(run.cache);
+  }
+
+  fprintf(stderr,
+          "%zu files (%zu cached, %zu parsed, %zu unreadable), %zu "
+          "certificates\n",
+          run.files, run.cache_hits, run.parsed, run.failed, run.certs);
+  query_free(run.where);
+  return result;
+}
@@ -0,0 +1,185 @@
+#include "../crl/crl.h"
+#include "../der/der_file.h"
+#include "../der/der_utils.h"
+#include "../pem/pem.h"
+#include "cmd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  der_file_t file;
+  pem_block_t *blocks;
+  size_t block_count;
+  const uint8_t *der;
+  size_t der_len;
+} crl_input_t;
+
+static void crl_usage(void) {
+  fprintf(stderr, "Usage: main --crl info CRL\n");
+  fprintf(stderr, "       main --crl compile CRL OUT\n");
+  fprintf(stderr, "       main --crl check CRL|SET SERIAL...\n");
+}
+
+static der_error_t crl_input_read(const char *filename, crl_input_t *input) {
+  memset(input, 0, sizeof(crl_input_t));
+
+  der_error_t err =
+      der_file_map(filename, &input->file, DER_ACCESS_SEQUENTIAL);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  if (input->file.size > 0 && input->file.data[0] == DER_TAG_SEQUENCE) {
+    input->der = input->file.data;
+    input->der_len = input->file.size;
+    return DER_OK;
+  }
+
+  char *text = malloc(input->file.size + 1);
+  if (!text) {
+    der_file_free(&input->file);
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+  memcpy(text, input->file.data, input->file.size);
+  text[input->file.size] = '\0';
+  der_file_free(&input->file);
+
+  int result =
+      pem_decode_blocks(text, "X509 CRL", &input->blocks, &input->block_count);
+  free(text);
+  if (result != 0 || input->block_count == 0) {
+    pem_free_blocks(input->blocks, input->block_count);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  input->der = input->blocks[0].der;
+  input->der_len = input->blocks[0].der_len;
+  return DER_OK;
+}
+
+static void crl_input_free(crl_input_t *input) {
+  der_file_free(&input->file);
+  pem_free_blocks(input->blocks, input->block_count);
+  memset(input, 0, sizeof(crl_input_t));
+}
+
+static der_error_t crl_load_set(const char *filename, crl_set_t *set) {
+  if (crl_set_open(set, filename) == DER_OK) {
+    return DER_OK;
+  }
+
+  crl_input_t input;
+  der_error_t err = crl_input_read(filename, &input);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  err = crl_set_build(input.der, input.der_len, set);
+  crl_input_free(&input);
+  return err;
+}
+
+static int crl_info(const char *filename) {
+  crl_input_t input;
+  der_error_t err = crl_input_read(filename, &input);
+  if (err != DER_OK) {
+    fprintf(stderr, "Failed to read CRL %s: %s\n", filename,
+            der_error_to_string(err));
+    return 1;
+  }
+
+  crl_info_t info;
+  err = crl_parse(input.der, input.der_len, &info, NULL, NULL);
+  if (err != DER_OK) {
+    fprintf(stderr, "Failed to parse CRL: %s\n", der_error_to_string(err));
+    crl_input_free(&input);
+    return 1;
+  }
+
+  char issuer[256] = "";
+  char this_update[32], next_update[32] = "(none)";
+  x509_name_attribute(info.issuer, X509_ATTR_CN, issuer, sizeof(issuer));
+  x509_format_time(info.this_update, this_update, sizeof(this_update));
+  if (info.next_update != 0) {
+    x509_format_time(info.next_update, next_update, sizeof(next_update));
+  }
+
+  printf("CRL: %s (%zu bytes)\n", filename, input.der_len);
+  printf("  Issuer CN: %s\n", issuer);
+  printf("  This Update: %s\n", this_update);
+  printf("  Next Update: %s\n", next_update);
+  printf("  Revoked Certificates: %zu\n", info.revoked_count);
+
+  crl_input_free(&input);
+  return 0;
+}
+
+static int crl_compile(const char *filename, const char *output) {
+  crl_set_t set;
+  der_error_t err = crl_load_set(filename, &set);
+  if (err == DER_OK) {
+    err = crl_set_save(&set, output);
+  }
+
+  if (err != DER_OK) {
+    fprintf(stderr, "Failed to compile %s: %s\n", filename,
+            der_error_to_string(err));
+    crl_set_free(&set);
+    return 1;
+  }
+
+  printf("Wrote %llu revoked serials to %s (%zu bytes)\n",
+         (unsigned long long)set.header->count, output, set.size);
+  crl_set_free(&set);
+  return 0;
+}
+
+static int crl_check(const char *filename, int argc, char *argv[]) {
+  crl_set_t set;
+  der_error_t err = crl_load_set(filename, &set);
+  if (err != DER_OK) {
+    fprintf(stderr, "Failed to load %s: %s\n", filename,
+            der_error_to_string(err));
+    return 1;
+  }
+
+  int result = 0;
+  for (int i = 0; i < argc; i++) {
+    uint8_t serial[64];
+    int serial_len = hex_from_string(argv[i], serial, sizeof(serial));
+    if (serial_len <= 0) {
+      fprintf(stderr, "Invalid serial: %s\n", argv[i]);
+      result = 1;
+      continue;
+    }
+
+    int64_t revoked_at;
+    if (crl_set_contains(&set, serial, (size_t)serial_len, &revoked_at)) {
+      char when[32];
+      x509_format_time(revoked_at, when, sizeof(when));
+      printf("%s: revoked at %s\n", argv[i], when);
+      result = result ? result : 2;
+    } else {
+      printf("%s: not revoked\n", argv[i]);
+    }
+  }
+
+  crl_set_free(&set);
+  return result;
+}
+
+int cmd_crl(int argc, char *argv[]) {
+  if (argc == 2 && strcmp(argv[0], "info") == 0) {
+    return crl_info(argv[1]);
+  }
+  if (argc == 3 && strcmp(argv[0], "compile") == 0) {
+    return crl_compile(argv[1], argv[2]);
+  }
+  if (argc >= 3 && strcmp(argv[0], "check") == 0) {
+    return crl_check(argv[1], argc - 2, argv + 2);
+  }
+
+  crl_usage();
+  return 1;
+}
@@ -0,0 +1,475 @@
+#include "../batch/batch.h"
+#include "../der/der_index.h"
+#include "../der/der_utils.h"
+#include "../pem/pem.h"
+#include "../util/sha256.h"
+#include "../util/util.h"
+#include "../x509/x509.h"
+#include "cmd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void diff_usage(void) {
+  fprintf(stderr, "Usage: main --diff A B\n");
+}
+
+static void group_usage(void) {
+  fprintf(stderr, "Usage: main --group issuer|subject|key|validity "
+                  "[--top N] PATH...\n");
+}
+
+/* A DER file whole, or the first certificate of a PEM file. */
+static der_error_t read_input(const char *path, arena_t *arena,
+                              const uint8_t **der, size_t *len) {
+  size_t size;
+  uint8_t *data = arena_read_file(arena, path, &size);
+  if (!data) {
+    return DER_ERROR_INVALID_DATA;
+  }
+  if (size > 0 && data[0] == DER_TAG_SEQUENCE) {
+    *der = data;
+    *len = size;
+    return DER_OK;
+  }
+
+  pem_block_t *blocks;
+  size_t count;
+  if (pem_decode_blocks_arena((const char *)data, "CERTIFICATE", arena,
+                              &blocks, &count) != 0 ||
+      count == 0) {
+    return DER_ERROR_INVALID_DATA;
+  }
+  *der = blocks[0].der;
+  *len = blocks[0].der_len;
+  return DER_OK;
+}
+
+typedef struct {
+  const der_index_t *index[2];
+  const uint8_t *data[2];
+  size_t len[2];
+  size_t changes;
+} diff_run_t;
+
+static const char *const certificate_fields[] = {
+    "tbsCertificate", "signatureAlgorithm", "signatureValue"};
+static const char *const tbs_fields[] = {
+    "serialNumber", "signature", "issuer",
+    "validity",     "subject",   "subjectPublicKeyInfo"};
+
+/* Position of entry among its siblings; parent is SIZE_MAX at the top. */
+static size_t sibling_position(const der_index_t *index, size_t parent,
+                               size_t entry) {
+  size_t position = 0;
+  for (size_t i = parent == SIZE_MAX ? 0 : parent + 1; i < entry;
+       i += index->entries[i].subtree) {
+    position++;
+  }
+  return position;
+}
+
+/* The X.509 field an element belongs to, if the tree is a certificate. */
+static const char *certificate_field(const der_index_t *index,
+                                     const size_t *path, size_t depth) {
+  if (depth < 1 || index->entries[path[0]].tag != DER_TAG_SEQUENCE) {
+    return NULL;
+  }
+  size_t field = sibling_position(index, path[0], path[1]);
+  if (depth == 1 || field != 0) {
+    return field < 3 ? certificate_fields[field] : NULL;
+  }
+
+  const der_index_entry_t *tbs = &index->entries[path[1]];
+  switch (index->entries[path[2]].tag) {
+  case DER_CLASS_CONTEXT | DER_CONSTRUCTED | 0:
+    return "version";
+  case DER_CLASS_CONTEXT | 1:
+    return "issuerUniqueID";
+  case DER_CLASS_CONTEXT | 2:
+    return "subjectUniqueID";
+  case DER_CLASS_CONTEXT | DER_CONSTRUCTED | 3:
+    return "extensions";
+  }
+  size_t position = sibling_position(index, path[1], path[2]);
+  if (tbs->subtree > 1 &&
+      index->entries[path[1] + 1].tag == (DER_CLASS_CONTEXT | DER_CONSTRUCTED)) {
+    position--;
+  }
+  return position < 6 ? tbs_fields[position] : NULL;
+}
+
+/*
+ * Prints where an entry sits: its path of sibling positions, the X.509
+ * field, and the OID of the nearest enclosing element that starts with
+ * one, such as an Extension or AlgorithmIdentifier.
+ */
+static void print_location(const der_index_t *index, const uint8_t *data,
+                           size_t entry) {
+  /*
+   * In encoding order, a parent is the nearest entry one level up. A
+   * primitive inside the deepest element sits at QCERT_MAX_DEPTH itself.
+   */
+  size_t path[QCERT_MAX_DEPTH + 1];
+  size_t depth = index->entries[entry].depth;
+  path[depth] = entry;
+  for (size_t i = entry, d = depth; d > 0 && i-- > 0;) {
+    if (index->entries[i].depth == d - 1) {
+      path[--d] = i;
+    }
+  }
+
+  for (size_t d = 0; d <= depth; d++) {
+    printf("%s%zu", d ? "." : "",
+           sibling_position(index, d ? path[d - 1] : SIZE_MAX, path[d]));
+  }
+  const char *field = certificate_field(index, path, depth);
+  if (field) {
+    printf(" %s", field);
+  }
+
+  for (size_t d = depth + 1; d-- > 0;) {
+    const der_index_entry_t *node = &index->entries[path[d]];
+    if (node->subtree < 2 || index->entries[path[d] + 1].tag != DER_TAG_OID) {
+      continue;
+    }
+    const der_index_entry_t *oid_entry = &index->entries[path[d] + 1];
+    der_ctx_t ctx;
+    der_init(&ctx, (uint8_t *)data + oid_entry->offset,
+             oid_entry->header_len + oid_entry->length);
+    uint32_t oid[QCERT_MAX_OID_ARCS];
+    size_t oid_len = QCERT_MAX_OID_ARCS;
+    if (der_decode_oid(&ctx, oid, &oid_len, QCERT_MAX_OID_ARCS) == DER_OK) {
+      printf(" ");
+      print_oid_with_name(oid, oid_len);
+    }
+    break;
+  }
+}
+
+static void report(der_diff_kind_t kind, size_t a, size_t b, void *user) {
+  diff_run_t *run = user;
+  run->changes++;
+
+  size_t side = kind == DER_DIFF_ADDED ? 1 : 0;
+  size_t entry = kind == DER_DIFF_ADDED ? b : a;
+  const der_index_t *index = run->index[side];
+  static const char *const kinds[] = {"changed", "removed", "added"};
+  printf("%-8s ", kinds[kind]);
+  print_location(index, run->data[side], entry);
+
+  const der_index_entry_t *node = &index->entries[entry];
+  printf(" [%s, ", der_tag_to_string(node->tag));
+  if (kind == DER_DIFF_CHANGED) {
+    printf("%zu -> %zu bytes]\n", node->length,
+           run->index[1]->entries[b].length);
+  } else {
+    printf("%zu bytes]\n", node->length);
+  }
+}
+
+/* Exits like diff(1): 0 if the inputs are identical, 1 if not, 2 on error. */
+int cmd_diff(int argc, char *argv[]) {
+  if (argc != 2) {
+    diff_usage();
+    return 2;
+  }
+
+  arena_t arena;
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+  der_index_t index[2];
+  memset(index, 0, sizeof(index));
+  diff_run_t run;
+  memset(&run, 0, sizeof(run));
+
+  der_error_t err = DER_OK;
+  for (int i = 0; i < 2 && err == DER_OK; i++) {
+    err = read_input(argv[i], &arena, &run.data[i], &run.len[i]);
+    if (err == DER_OK) {
+      err = der_index_tree(run.data[i], run.len[i], DER_INDEX_HASH,
+                           &index[i]);
+    }
+    if (err != DER_OK) {
+      fprintf(stderr, "Failed to read %s: %s\n", argv[i],
+              der_error_to_string(err));
+    }
+    run.index[i] = &index[i];
+  }
+
+  int result = 2;
+  if (err == DER_OK) {
+    err = der_index_diff(&index[0], &index[1], report, &run);
+    /*
+     * Equal hashes are not proof: if no difference was found, the bytes
+     * have the last word, and a collision is reported at the top.
+     */
+    if (err == DER_OK && run.changes == 0 && index[0].count > 0 &&
+        index[1].count > 0 &&
+        (run.len[0] != run.len[1] ||
+         memcmp(run.data[0], run.data[1], run.len[0]) != 0)) {
+      report(DER_DIFF_CHANGED, 0, 0, &run);
+    }
+    if (err != DER_OK) {
+      fprintf(stderr, "Diff failed: %s\n", der_error_to_string(err));
+    } else if (run.changes == 0) {
+      printf("identical\n");
+      result = 0;
+    } else {
+      printf("%zu differences\n", run.changes);
+      result = 1;
+    }
+  }
+
+  der_index_free(&index[0]);
+  der_index_free(&index[1]);
+  arena_free(&arena);
+  return result;
+}
+
+typedef struct {
+  uint64_t hash;
+  const uint8_t *data; /* first occurrence, copied */
+  size_t len;
+  size_t count;
+  const char *label;
+} group_t;
+
+typedef struct {
+  uint32_t field;
+  size_t top;
+  group_t *slots;
+  size_t mask;
+  size_t used;
+  arena_t keep;  /* representatives and labels */
+  arena_t files; /* one file at a time */
+  size_t certs;
+  size_t skipped;
+  size_t failed;
+} group_run_t;
+
+static x509_span_t group_span(const group_run_t *run, const x509_cert_t *cert) {
+  switch (run->field) {
+  case X509_FIELD_ISSUER:
+    return cert->issuer;
+  case X509_FIELD_SUBJECT:
+    return cert->subject;
+  case X509_FIELD_PUBLIC_KEY:
+    return cert->public_key_info;
+  default:
+    return cert->validity;
+  }
+}
+
+/* Something to recognize the group by: a CN, key algorithm or dates. */
+static const char *group_label(group_run_t *run, const x509_cert_t *cert,
+                               x509_span_t span) {
+  char label[QCERT_MAX_NAME_VALUE];
+  label[0] = '\0';
+
+  if (run->field == X509_FIELD_PUBLIC_KEY) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    char hex[17];
+    sha256(span.data, span.len, digest);
+    hex_to_string(digest, 8, hex);
+
+    const char *name = NULL;
+    der_ctx_t ctx;
+    der_init(&ctx, (uint8_t *)span.data, span.len);
+    size_t len;
+    uint32_t oid[QCERT_MAX_OID_ARCS];
+    size_t oid_len = QCERT_MAX_OID_ARCS;
+    if (der_decode_sequence_header(&ctx, &len) == DER_OK &&
+        der_decode_sequence_header(&ctx, &len) == DER_OK &&
+        der_decode_oid(&ctx, oid, &oid_len, QCERT_MAX_OID_ARCS) == DER_OK) {
+      name = get_oid_name(oid, oid_len);
+    }
+    snprintf(label, sizeof(label), "%s, sha256 %s...", name ? name : "?", hex);
+  } else if (run->field == X509_FIELD_VALIDITY) {
+    char from[32];
+    char to[32];
+    x509_format_time(cert->not_before, from, sizeof(from));
+    x509_format_time(cert->not_after, to, sizeof(to));
+    snprintf(label, sizeof(label), "%s to %s", from, to);
+  } else if (x509_name_attribute(span, X509_ATTR_CN, label, sizeof(label)) !=
+                 DER_OK &&
+             x509_name_attribute(span, X509_ATTR_O, label, sizeof(label)) !=
+                 DER_OK) {
+    snprintf(label, sizeof(label), "(no CN or O)");
+  }
+
+  size_t len = strlen(label) + 1;
+  char *copy = arena_alloc(&run->keep, len);
+  if (copy) {
+    memcpy(copy, label, len);
+  }
+  return copy;
+}
+
+static bool group_grow(group_run_t *run) {
+  size_t slot_count = run->slots ? (run->mask + 1) * 2 : 1024;
+  group_t *slots = calloc(slot_count, sizeof(group_t));
+  if (!slots) {
+    return false;
+  }
+  for (size_t i = 0; run->slots && i <= run->mask; i++) {
+    if (run->slots[i].count == 0) {
+      continue;
+    }
+    size_t slot = run->slots[i].hash & (slot_count - 1);
+    while (slots[slot].count) {
+      slot = (slot + 1) & (slot_count - 1);
+    }
+    slots[slot] = run->slots[i];
+  }
+  free(run->slots);
+  run->slots = slots;
+  run->mask = slot_count - 1;
+  return true;
+}
+
+/* Counts the certificate into the group of its element. */
+static int group_add(group_run_t *run, const x509_cert_t *cert) {
+  x509_span_t span = group_span(run, cert);
+  uint64_t hash;
+  if (der_subtree_hash(span.data, span.len, &hash) != DER_OK) {
+    run->skipped++;
+    return 0;
+  }
+
+  /* Equal hashes are confirmed, so a collision only costs a probe. */
+  size_t slot = hash & run->mask;
+  while (run->slots[slot].count) {
+    group_t *group = &run->slots[slot];
+    if (group->hash == hash && group->len == span.len &&
+        memcmp(group->data, span.data, span.len) == 0) {
+      group->count++;
+      return 0;
+    }
+    slot = (slot + 1) & run->mask;
+  }
+
+  uint8_t *copy = arena_alloc(&run->keep, span.len);
+  const char *label = group_label(run, cert, span);
+  if (!copy || !label) {
+    return -1;
+  }
+  memcpy(copy, span.data, span.len);
+  group_t group = {hash, copy, span.len, 1, label};
+  run->slots[slot] = group;
+  run->used++;
+  if (run->used * 2 > run->mask + 1 && !group_grow(run)) {
+    return -1;
+  }
+  return 0;
+}
+
+static int group_file(const char *path, const struct stat *st, void *user) {
+  (void)st;
+  group_run_t *run = user;
+
+  arena_reset(&run->files);
+  pem_block_t *blocks;
+  size_t count;
+  if (pem_read_certificates_arena(path, &run->files, &blocks, &count) != 0) {
+    run->failed++;
+    return 0;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    x509_cert_t cert;
+    if (x509_extract_fields(blocks[i].der, blocks[i].der_len, run->field,
+                            &cert) != DER_OK) {
+      run->skipped++;
+      continue;
+    }
+    run->certs++;
+    if (group_add(run, &cert) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int compare_groups(const void *a, const void *b) {
+  const group_t *x = a;
+  const group_t *y = b;
+  if (x->count != y->count) {
+    return x->count < y->count ? 1 : -1;
+  }
+  return (x->hash > y->hash) - (x->hash < y->hash);
+}
+
+int cmd_group(int argc, char *argv[]) {
+  static const struct {
+    const char *name;
+    uint32_t field;
+  } fields[] = {
+      {"issuer", X509_FIELD_ISSUER},
+      {"subject", X509_FIELD_SUBJECT},
+      {"key", X509_FIELD_PUBLIC_KEY},
+      {"validity", X509_FIELD_VALIDITY},
+  };
+
+  group_run_t run;
+  memset(&run, 0, sizeof(run));
+  run.top = 20;
+  if (argc > 0) {
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+      if (strcmp(argv[0], fields[i].name) == 0) {
+        run.field = fields[i].field;
+      }
+    }
+  }
+  int first = 1;
+  if (argc > 2 && strcmp(argv[1], "--top") == 0) {
+    run.top = strtoul(argv[2], NULL, 10);
+    first = 3;
+  }
+  if (run.field == 0 || first >= argc) {
+    group_usage();
+    return 1;
+  }
+
+  arena_init(&run.keep, ARENA_BLOCK_SIZE);
+  arena_init(&run.files, ARENA_BLOCK_SIZE);
+  int result = 0;
+  if (!group_grow(&run)) {
+    fprintf(stderr, "Out of memory\n");
+    result = 1;
+  }
+  for (int i = first; i < argc && result == 0; i++) {
+    if (batch_walk(argv[i], group_file, &run) != 0) {
+      fprintf(stderr, "Failed to read %s\n", argv[i]);
+      result = 1;
+    }
+  }
+
+  if (result == 0) {
+    /* Pack the groups to the front of the table and rank them. */
+    size_t count = 0;
+    for (size_t i = 0; i <= run.mask; i++) {
+      if (run.slots[i].count) {
+        run.slots[count++] = run.slots[i];
+      }
+    }
+    qsort(run.slots, count, sizeof(group_t), compare_groups);
+
+    printf("%zu certificates, %zu distinct by %s\n", run.certs, count,
+           argv[0]);
+    for (size_t i = 0; i < count && i < run.top; i++) {
+      printf("%10zu  %016llx  %s\n", run.slots[i].count,
+             (unsigned long long)run.slots[i].hash, run.slots[i].label);
+    }
+    if (run.skipped > 0) {
+      fprintf(stderr, "%zu certificates could not be parsed\n", run.skipped);
+    }
+    if (run.failed > 0) {
+      fprintf(stderr, "%zu files could not be read\n", run.failed);
+    }
+  }
+
+  free(run.slots);
+  arena_free(&run.files);
+  arena_free(&run.keep);
+  return result;
+}
@@ -0,0 +1,181 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../batch/batch.h"
+#include "../der/der_gather.h"
+#include "../der/der_utils.h"
+#include "../pem/pem.h"
+#include "../x509/x509.h"
+#include "cmd.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* 1.2.840.113549.1.7.2 signedData and 1.2.840.113549.1.7.1 data */
+static const uint8_t oid_signed_data[] = {0x06, 0x09, 0x2A, 0x86, 0x48, 0x86,
+                                          0xF7, 0x0D, 0x01, 0x07, 0x02};
+static const uint8_t oid_data[] = {0x06, 0x09, 0x2A, 0x86, 0x48, 0x86,
+                                   0xF7, 0x0D, 0x01, 0x07, 0x01};
+static const uint8_t version_1[] = {DER_TAG_INTEGER, 0x01, 0x01};
+static const uint8_t empty_set[] = {DER_TAG_SET, 0x00};
+
+#define TAG_CONTEXT_0 (DER_CLASS_CONTEXT | DER_CONSTRUCTED | 0)
+
+typedef struct {
+  arena_t arena;
+  x509_span_t *certs;
+  size_t count;
+  size_t capacity;
+  size_t failed;
+} p7b_input_t;
+
+static void p7b_usage(void) {
+  fprintf(stderr, "Usage: main --p7b OUT PATH...\n");
+}
+
+static int collect_file(const char *path, const struct stat *st, void *user) {
+  (void)st;
+  p7b_input_t *input = user;
+
+  pem_block_t *blocks;
+  size_t count;
+  if (pem_read_certificates_arena(path, &input->arena, &blocks, &count) != 0) {
+    input->failed++;
+    return 0;
+  }
+
+  if (input->count + count > input->capacity) {
+    size_t capacity = input->capacity ? input->capacity * 2 : 64;
+    while (capacity < input->count + count) {
+      capacity *= 2;
+    }
+    x509_span_t *certs = realloc(input->certs, capacity * sizeof(x509_span_t));
+    if (!certs) {
+      return -1;
+    }
+    input->certs = certs;
+    input->capacity = capacity;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    input->certs[input->count].data = blocks[i].der;
+    input->certs[input->count].len = blocks[i].der_len;
+    input->count++;
+  }
+  return 0;
+}
+
+/* DER orders SET OF by encoding, the shorter one padded with zeros. */
+static int compare_encodings(const void *a, const void *b) {
+  const x509_span_t *x = a;
+  const x509_span_t *y = b;
+  size_t len = x->len < y->len ? x->len : y->len;
+  int order = memcmp(x->data, y->data, len);
+  if (order != 0) {
+    return order;
+  }
+  return (x->len > y->len) - (x->len < y->len);
+}
+
+/*
+ * A certs-only SignedData: no digest algorithms, content or signers. The
+ * certificates are referenced where the arena holds them, so only the
+ * headers and the fixed fields are copied.
+ */
+static der_error_t encode_p7b(der_gather_t *gather, const x509_span_t *certs,
+                              size_t count) {
+  der_gather_open(gather, DER_TAG_SEQUENCE);
+  der_gather_copy(gather, oid_signed_data, sizeof(oid_signed_data));
+  der_gather_open(gather, TAG_CONTEXT_0);
+  der_gather_open(gather, DER_TAG_SEQUENCE);
+  der_gather_copy(gather, version_1, sizeof(version_1));
+  der_gather_copy(gather, empty_set, sizeof(empty_set));
+  der_gather_element(gather, DER_TAG_SEQUENCE, oid_data, sizeof(oid_data));
+  der_gather_open(gather, TAG_CONTEXT_0);
+  for (size_t i = 0; i < count; i++) {
+    der_gather_ref(gather, certs[i].data, certs[i].len);
+  }
+  der_gather_close(gather);
+  der_gather_copy(gather, empty_set, sizeof(empty_set));
+  der_gather_close(gather);
+  der_gather_close(gather);
+  der_gather_close(gather);
+  return der_gather_finish(gather);
+}
+
+int cmd_p7b(int argc, char *argv[]) {
+  if (argc < 2) {
+    p7b_usage();
+    return 1;
+  }
+  const char *output = argv[0];
+
+  p7b_input_t input;
+  memset(&input, 0, sizeof(input));
+  arena_init(&input.arena, ARENA_BLOCK_SIZE);
+
+  int result = 0;
+  for (int i = 1; i < argc && result == 0; i++) {
+    if (batch_walk(argv[i], collect_file, &input) != 0) {
+      fprintf(stderr, "Failed to read %s\n", argv[i]);
+      result = 1;
+    }
+  }
+  if (result == 0 && input.count == 0) {
+    fprintf(stderr, "No certificates found\n");
+    result = 1;
+  }
+
+  uint8_t buffer[512];
+  struct iovec *iov = NULL;
+  der_gather_t gather;
+  der_error_t err = DER_ERROR_BUFFER_TOO_SMALL;
+  if (result == 0) {
+    qsort(input.certs, input.count, sizeof(x509_span_t), compare_encodings);
+    /* One iovec per certificate; the arena may hold them back to back. */
+    size_t iov_max = input.count + 16;
+    iov = malloc(iov_max * sizeof(struct iovec));
+    if (iov) {
+      der_gather_init(&gather, buffer, sizeof(buffer), iov, iov_max);
+      err = encode_p7b(&gather, input.certs, input.count);
+    }
+  }
+
+  if (result == 0 && err == DER_OK) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", output);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      err = DER_ERROR_INVALID_DATA;
+    } else {
+      err = der_gather_write(&gather, fd);
+      if (close(fd) != 0 && err == DER_OK) {
+        err = DER_ERROR_INVALID_DATA;
+      }
+      if (err == DER_OK && rename(tmp, output) != 0) {
+        err = DER_ERROR_INVALID_DATA;
+      }
+      if (err != DER_OK) {
+        unlink(tmp);
+      }
+    }
+  }
+
+  if (result == 0 && err != DER_OK) {
+    fprintf(stderr, "Failed to write %s: %s\n", output,
+            der_error_to_string(err));
+    result = 1;
+  } else if (result == 0) {
+    printf("Wrote %zu certificates to %s (%zu bytes)\n", input.count, output,
+           gather.total);
+    if (input.failed > 0) {
+      fprintf(stderr, "%zu files could not be read\n", input.failed);
+    }
+  }
+
+  free(iov);
+  free(input.certs);
+  arena_free(&input.arena);
+  return result;
+}
@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../der/der_utils.h"
+#include "../server/loadgen.h"
+#include "../server/server.h"
+#include "../util/util.h"
+#include "cmd.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t server_stop = 0;
+
+static void server_signal(int sig) {
+  (void)sig;
+  server_stop = 1;
+}
+
+int cmd_server(int argc, char *argv[]) {
+  server_config_t config;
+  memset(&config, 0, sizeof(config));
+  config.workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  const char *store_dir = NULL;
+  const char *snapshot_file = NULL;
+
+  int i = 0;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+    if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+      config.workers = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+      store_dir = argv[++i];
+    } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+      snapshot_file = argv[++i];
+    } else {
+      break;
+    }
+  }
+
+  if (i + 1 != argc || config.workers <= 0) {
+    fprintf(stderr, "Usage: main --daemon [--workers N] [--store DIR] "
+                    "[--snapshot FILE] SOCKET\n");
+    return 1;
+  }
+  config.socket_path = argv[i];
+
+  store_t store;
+  if (store_dir) {
+    der_error_t err = store_open(&store, store_dir);
+    if (err != DER_OK) {
+      fprintf(stderr, "Failed to open store %s: %s\n", store_dir,
+              der_error_to_string(err));
+      return 1;
+    }
+    config.store = &store;
+  }
+
+  snapshot_t snapshot;
+  if (snapshot_file) {
+    der_error_t err = snapshot_open(&snapshot, snapshot_file);
+    if (err != DER_OK) {
+      fprintf(stderr, "Failed to open snapshot %s: %s\n", snapshot_file,
+              der_error_to_string(err));
+      if (store_dir) {
+        store_close(&store);
+      }
+      return 1;
+    }
+    config.snapshot = &snapshot;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = server_signal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  fprintf(stderr, "Listening on %s with %d workers\n", config.socket_path,
+          config.workers);
+  int result = server_run(&config, &server_stop);
+  if (result != 0) {
+    perror("daemon");
+  }
+
+  if (snapshot_file) {
+    snapshot_close(&snapshot);
+  }
+  if (store_dir) {
+    store_close(&store);
+  }
+  return result == 0 ? 0 : 1;
+}
+
+int cmd_loadgen(int argc, char *argv[]) {
+  loadgen_config_t config;
+  memset(&config, 0, sizeof(config));
+  config.requests = 10000;
+  config.concurrency = 4;
+  config.pipeline = 1;
+
+  int i = 0;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+    if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+      config.requests = (size_t)atol(argv[++i]);
+    } else if (strcmp(argv[i], "--concurrency") == 0 && i + 1 < argc) {
+      config.concurrency = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+      config.pipeline = (size_t)atol(argv[++i]);
+    } else {
+      break;
+    }
+  }
+
+  if (i + 2 != argc || config.concurrency <= 0 || config.pipeline == 0) {
+    fprintf(stderr, "Usage: main --loadgen [--requests N] [--concurrency C] "
+                    "[--pipeline D] SOCKET FILE\n");
+    return 1;
+  }
+  config.socket_path = argv[i];
+
+  size_t payload_len;
+  uint8_t *payload = read_file(argv[i + 1], &payload_len);
+  if (!payload) {
+    fprintf(stderr, "Failed to read %s\n", argv[i + 1]);
+    return 1;
+  }
+  config.payload = payload;
+  config.payload_len = payload_len;
+
+  signal(SIGPIPE, SIG_IGN);
+
+  loadgen_result_t result;
+  int status = loadgen_run(&config, &result);
+  free(payload);
+  if (status != 0) {
+    fprintf(stderr, "Load generator failed\n");
+    return 1;
+  }
+
+  printf("requests:    %zu completed, %zu failed\n", result.completed,
+         result.failed);
+  printf("throughput:  %.0f req/s\n",
+         result.seconds > 0 ? result.completed / result.seconds : 0.0);
+  printf("latency:     p50 %.1f us, p99 %.1f us, max %.1f us\n",
+         result.p50_us, result.p99_us, result.max_us);
+  return result.failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../der/der_utils.h"
+#include "../pem/pem.h"
+#include "../trust/snapshot.h"
+#include "../x509/x509.h"
+#include "cmd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void snapshot_usage(void) {
+  fprintf(stderr, "Usage: main --snapshot build [--threads N] OUT PATH...\n");
+  fprintf(stderr, "       main --snapshot info FILE\n");
+  fprintf(stderr, "       main --snapshot issuers FILE CERT\n");
+}
+
+static bool print_cert(const snapshot_t *snapshot, const snapshot_cert_t *cert,
+                       void *user) {
+  (void)user;
+  x509_cert_t parsed;
+  char digest[SHA256_DIGEST_SIZE * 2 + 1];
+  char cn[256] = "";
+
+  if (x509_extract(snapshot_cert_der(snapshot, cert), cert->der_len,
+                   &parsed) == DER_OK) {
+    x509_name_attribute(parsed.subject, X509_ATTR_CN, cn, sizeof(cn));
+  }
+  hex_to_string(cert->sha256, SHA256_DIGEST_SIZE, digest);
+  printf("%s  %s\n", digest, cn);
+  return true;
+}
+
+static int snapshot_build_cmd(int argc, char *argv[]) {
+  int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int i = 0;
+  if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) {
+    threads = atoi(argv[i + 1]);
+    i += 2;
+  }
+
+  if (argc - i < 2 || threads <= 0) {
+    snapshot_usage();
+    return 1;
+  }
+
+  snapshot_build_stats_t stats;
+  der_error_t err = snapshot_build(argv[i], (const char *const *)&argv[i + 1],
+                                   (size_t)(argc - i - 1), threads, &stats);
+  if (err != DER_OK) {
+    fprintf(stderr, "Failed to build snapshot %s: %s\n", argv[i],
+            der_error_to_string(err));
+    return 1;
+  }
+
+  printf("Wrote %zu certificates from %zu files to %s (%zu duplicates, %zu "
+         "failed)\n",
+         stats.parsed, stats.files, argv[i], stats.duplicates, stats.failed);
+  return 0;
+}
+
+int cmd_snapshot(int argc, char *argv[]) {
+  if (argc < 2) {
+    snapshot_usage();
+    return 1;
+  }
+
+  if (strcmp(argv[0], "build") == 0) {
+    return snapshot_build_cmd(argc - 1, argv + 1);
+  }
+
+  snapshot_t snapshot;
+  der_error_t err = snapshot_open(&snapshot, argv[1]);
+  if (err != DER_OK) {
+    fprintf(stderr, "Failed to open snapshot %s: %s\n", argv[1],
+            der_error_to_string(err));
+    return 1;
+  }
+
+  int result = 0;
+  if (strcmp(argv[0], "info") == 0 && argc == 2) {
+    printf("Snapshot: %s\n", argv[1]);
+    printf("Certificates: %llu (%llu with SKI)\n",
+           (unsigned long long)snapshot.header->cert_count,
+           (unsigned long long)snapshot.header->ski_count);
+    printf("Size: %llu bytes\n",
+           (unsigned long long)snapshot.header->total_size);
+  } else if (strcmp(argv[0], "issuers") == 0 && argc == 3) {
+    pem_block_t *certs;
+    size_t count;
+    x509_cert_t cert;
+    if (pem_read_certificates(argv[2], &certs, &count) != 0 || count == 0) {
+      fprintf(stderr, "Failed to read %s\n", argv[2]);
+      snapshot_close(&snapshot);
+      return 1;
+    }
+    if (x509_extract(certs[0].der, certs[0].der_len, &cert) == DER_OK) {
+      if (cert.authority_key_id.len > 0) {
+        snapshot_find_ski(&snapshot, cert.authority_key_id.data,
+                          cert.authority_key_id.len, print_cert, NULL);
+      } else {
+        snapshot_find_subject(&snapshot, cert.issuer.data, cert.issuer.len,
+                              print_cert, NULL);
+      }
+    } else {
+      fprintf(stderr, "Failed to parse %s\n", argv[2]);
+      result = 1;
+    }
+    pem_free_blocks(certs, count);
+  } else {
+    snapshot_usage();
+    result = 1;
+  }
+
+  snapshot_close(&snapshot);
+  return result;
+}
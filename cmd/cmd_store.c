@@ -0,0 +1,187 @@
+#include "../der/der_utils.h"
+#include "../pem/pem.h"
+#include "../store/store.h"
+#include "cmd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void store_usage(void) {
+  fprintf(stderr, "Usage: main --store DIR add FILE...\n");
+  fprintf(stderr, "       main --store DIR reindex\n");
+  fprintf(stderr, "       main --store DIR query [--expires-within DAYS] "
+                  "[--issuer-cert FILE]\n");
+  fprintf(stderr, "                              [--ski HEX] [--san HOST] "
+                  "[--sha256 HEX]\n");
+}
+
+static int store_add_files(store_t *store, int argc, char *argv[]) {
+  size_t added = 0, duplicates = 0, failed = 0;
+
+  for (int i = 0; i < argc; i++) {
+    pem_block_t *certs;
+    size_t count;
+    if (pem_read_certificates(argv[i], &certs, &count) != 0) {
+      fprintf(stderr, "Failed to read certificates from %s\n", argv[i]);
+      failed++;
+      continue;
+    }
+
+    for (size_t j = 0; j < count; j++) {
+      bool was_added;
+      der_error_t err =
+          store_add(store, certs[j].der, certs[j].der_len, &was_added);
+      if (err != DER_OK) {
+        fprintf(stderr, "%s: certificate %zu: %s\n", argv[i], j,
+                der_error_to_string(err));
+        failed++;
+      } else if (was_added) {
+        added++;
+      } else {
+        duplicates++;
+      }
+    }
+
+    pem_free_blocks(certs, count);
+  }
+
+  der_error_t err = store_build_indexes(store);
+  if (err != DER_OK) {
+    fprintf(stderr, "Failed to build indexes: %s\n", der_error_to_string(err));
+    return 1;
+  }
+
+  printf("Added %zu certificates (%zu duplicates, %zu failed)\n", added,
+         duplicates, failed);
+  return failed > 0 ? 1 : 0;
+}
+
+static bool print_record(const store_record_t *record, void *user) {
+  size_t *matches = user;
+  (*matches)++;
+
+  char digest[SHA256_DIGEST_SIZE * 2 + 1];
+  hex_to_string(record->sha256, SHA256_DIGEST_SIZE, digest);
+
+  char not_after[32];
+  x509_format_time(record->not_after, not_after, sizeof(not_after));
+
+  x509_span_t subject = store_record_subject_cn(record);
+  x509_span_t issuer = store_record_issuer_cn(record);
+  printf("%s  %s  %.*s  (issuer: %.*s)\n", digest, not_after,
+         (int)subject.len, (const char *)subject.data, (int)issuer.len,
+         (const char *)issuer.data);
+  return true;
+}
+
+static int store_run_query(store_t *store, int argc, char *argv[]) {
+  store_query_t query;
+  memset(&query, 0, sizeof(query));
+  uint8_t sha256_digest[SHA256_DIGEST_SIZE];
+
+  for (int i = 0; i < argc; i++) {
+    if (i + 1 >= argc) {
+      store_usage();
+      return 1;
+    }
+
+    if (strcmp(argv[i], "--expires-within") == 0) {
+      int64_t now = (int64_t)time(NULL);
+      query.by_not_after = true;
+      query.not_after_min = now;
+      query.not_after_max = now + (int64_t)atol(argv[++i]) * 86400;
+    } else if (strcmp(argv[i], "--issuer-cert") == 0) {
+      pem_block_t *certs;
+      size_t count;
+      x509_cert_t issuer;
+      if (pem_read_certificates(argv[++i], &certs, &count) != 0 ||
+          count == 0) {
+        fprintf(stderr, "Failed to read issuer certificate %s\n", argv[i]);
+        return 1;
+      }
+      der_error_t err = x509_extract(certs[0].der, certs[0].der_len, &issuer);
+      if (err == DER_OK) {
+        query.by_issuer = true;
+        query.issuer_hash = hash64(issuer.subject.data, issuer.subject.len);
+      }
+      pem_free_blocks(certs, count);
+      if (err != DER_OK) {
+        fprintf(stderr, "Failed to parse issuer certificate: %s\n",
+                der_error_to_string(err));
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--ski") == 0) {
+      uint8_t ski[64];
+      int ski_len = hex_from_string(argv[++i], ski, sizeof(ski));
+      if (ski_len <= 0) {
+        fprintf(stderr, "Invalid SKI: %s\n", argv[i]);
+        return 1;
+      }
+      query.by_ski = true;
+      query.ski_hash = hash64(ski, (size_t)ski_len);
+    } else if (strcmp(argv[i], "--san") == 0) {
+      query.san = argv[++i];
+    } else if (strcmp(argv[i], "--sha256") == 0) {
+      if (hex_from_string(argv[++i], sha256_digest, sizeof(sha256_digest)) !=
+          SHA256_DIGEST_SIZE) {
+        fprintf(stderr, "Invalid SHA-256 fingerprint: %s\n", argv[i]);
+        return 1;
+      }
+      query.sha256 = sha256_digest;
+    } else {
+      store_usage();
+      return 1;
+    }
+  }
+
+  if (!store_indexes_current(store)) {
+    fprintf(stderr, "Note: indexes are stale, falling back to a full scan "
+                    "(run 'reindex')\n");
+  }
+
+  size_t matches = 0;
+  der_error_t err = store_query(store, &query, print_record, &matches);
+  if (err != DER_OK) {
+    fprintf(stderr, "Query failed: %s\n", der_error_to_string(err));
+    return 1;
+  }
+
+  fprintf(stderr, "%zu matching certificates\n", matches);
+  return 0;
+}
+
+int cmd_store(int argc, char *argv[]) {
+  if (argc < 2 || (strcmp(argv[1], "add") != 0 &&
+                    strcmp(argv[1], "reindex") != 0 &&
+                    strcmp(argv[1], "query") != 0)) {
+    store_usage();
+    return 1;
+  }
+
+  /* store_open creates DIR, so only a valid subcommand gets this far. */
+  store_t store;
+  der_error_t err = store_open(&store, argv[0]);
+  if (err != DER_OK) {
+    fprintf(stderr, "Failed to open store %s: %s\n", argv[0],
+            der_error_to_string(err));
+    return 1;
+  }
+
+  int result;
+  if (strcmp(argv[1], "add") == 0) {
+    result = store_add_files(&store, argc - 2, argv + 2);
+  } else if (strcmp(argv[1], "reindex") == 0) {
+    err = store_build_indexes(&store);
+    if (err != DER_OK) {
+      fprintf(stderr, "Failed to build indexes: %s\n",
+              der_error_to_string(err));
+    }
+    result = err == DER_OK ? 0 : 1;
+  } else {
+    result = store_run_query(&store, argc - 2, argv + 2);
+  }
+
+  store_close(&store);
+  return result;
+}
@@ -0,0 +1,139 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../batch/batch.h"
+#include "../der/der_stream.h"
+#include "../der/der_utils.h"
+#include "../query/query.h"
+#include "cmd.h"
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static void stream_usage(void) {
+  fprintf(stderr, "Usage: main --stream [--chunk BYTES] [--format text|json] "
+                  "[--where EXPR] [FILE]\n");
+}
+
+int cmd_stream(int argc, char *argv[]) {
+  batch_format_t format = BATCH_FORMAT_TEXT;
+  size_t chunk_size = DER_STREAM_CHUNK_SIZE;
+  const char *where = NULL;
+
+  int i = 0;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+    if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+      chunk_size = strtoul(argv[++i], NULL, 10);
+      if (chunk_size == 0) {
+        stream_usage();
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      if (!batch_parse_format(argv[++i], &format)) {
+        stream_usage();
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--where") == 0 && i + 1 < argc) {
+      where = argv[++i];
+    } else {
+      stream_usage();
+      return 1;
+    }
+  }
+
+  if (i + 1 < argc) {
+    stream_usage();
+    return 1;
+  }
+
+  query_t query;
+  if (where) {
+    char error[160];
+    if (query_compile(where, (int64_t)time(NULL), &query, error,
+                      sizeof(error)) != 0) {
+      fprintf(stderr, "Invalid --where expression: %s\n", error);
+      return 1;
+    }
+  }
+
+  const char *source = "-";
+  int fd = STDIN_FILENO;
+  if (i < argc && strcmp(argv[i], "-") != 0) {
+    source = argv[i];
+    fd = open(source, O_RDONLY);
+    if (fd < 0) {
+      fprintf(stderr, "Failed to open %s\n", source);
+      if (where) {
+        query_free(&query);
+      }
+      return 1;
+    }
+  }
+
+  der_stream_t stream;
+  der_error_t err = der_stream_init(&stream, fd, chunk_size);
+  if (err != DER_OK) {
+    fprintf(stderr, "Failed to allocate stream buffer: %s\n",
+            der_error_to_string(err));
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+    if (where) {
+      query_free(&query);
+    }
+    return 1;
+  }
+
+  size_t certs = 0;
+  size_t skipped = 0;
+  size_t failed = 0;
+  uint64_t offset = 0;
+  for (;;) {
+    const uint8_t *record;
+    size_t record_len;
+    err = der_stream_next(&stream, &record, &record_len, &offset);
+    if (err != DER_OK || !record) {
+      break;
+    }
+
+    if (where && !query_match(&query, record, record_len)) {
+      skipped++;
+      continue;
+    }
+
+    batch_cert_t cert;
+    if (batch_summarize(record, record_len, &cert) != DER_OK) {
+      failed++;
+      continue;
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s@%" PRIu64, source, offset);
+    batch_emit(stdout, format, NULL, label, &cert);
+    certs++;
+  }
+
+  int result = 0;
+  if (err != DER_OK) {
+    fprintf(stderr, "Stream error after byte %" PRIu64 ": %s\n",
+            stream.offset, der_error_to_string(err));
+    result = 1;
+  }
+
+  fprintf(stderr,
+          "%zu certificates, %zu filtered, %zu unparseable records, %" PRIu64
+          " bytes\n",
+          certs, skipped, failed, stream.offset);
+
+  der_stream_free(&stream);
+  if (fd != STDIN_FILENO) {
+    close(fd);
+  }
+  if (where) {
+    query_free(&query);
+  }
+  return result;
+}
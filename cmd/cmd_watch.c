@@ -0,0 +1,68 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../batch/watch.h"
+#include "../der/der_utils.h"
+#include "cmd.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static volatile sig_atomic_t watch_stop = 0;
+
+static void watch_signal(int sig) {
+  (void)sig;
+  watch_stop = 1;
+}
+
+static void watch_usage(void) {
+  fprintf(stderr, "Usage: main --watch [--debounce MS] [--format text|json] "
+                  "DIR\n");
+}
+
+int cmd_watch(int argc, char *argv[]) {
+  batch_format_t format = BATCH_FORMAT_TEXT;
+  int debounce_ms = 200;
+
+  int i = 0;
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+    if (strcmp(argv[i], "--debounce") == 0 && i + 1 < argc) {
+      debounce_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      if (!batch_parse_format(argv[++i], &format)) {
+        watch_usage();
+        return 1;
+      }
+    } else {
+      watch_usage();
+      return 1;
+    }
+  }
+
+  if (i + 1 != argc || debounce_ms < 0) {
+    watch_usage();
+    return 1;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = watch_signal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  watch_t watch;
+  der_error_t err = watch_init(&watch, argv[i], format, debounce_ms, stdout);
+  if (err != DER_OK) {
+    fprintf(stderr, "Failed to watch %s: %s\n", argv[i],
+            der_error_to_string(err));
+    return 1;
+  }
+
+  int result = watch_run(&watch, &watch_stop);
+  if (result != 0) {
+    perror("watch");
+  }
+
+  watch_free(&watch);
+  return result == 0 ? 0 : 1;
+}
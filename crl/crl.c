@@ -0,0 +1,450 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "crl.h"
+#include "../der/der_index.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+  x509_span_t serial;
+  int64_t revoked_at;
+} crl_revoked_t;
+
+static const der_template_t this_update_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_UTC_TIME,
+     .store = DER_STORE_CONVERT, .offset = offsetof(crl_info_t, this_update),
+     .convert = x509_time_convert},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_GENERALIZED_TIME,
+     .store = DER_STORE_CONVERT, .offset = offsetof(crl_info_t, this_update),
+     .convert = x509_time_convert},
+    DER_TEMPLATE_END,
+};
+
+static const der_template_t next_update_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_UTC_TIME,
+     .store = DER_STORE_CONVERT, .offset = offsetof(crl_info_t, next_update),
+     .convert = x509_time_convert},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_GENERALIZED_TIME,
+     .store = DER_STORE_CONVERT, .offset = offsetof(crl_info_t, next_update),
+     .convert = x509_time_convert},
+    DER_TEMPLATE_END,
+};
+
+/*
+ * TBSCertList ::= SEQUENCE { version INTEGER OPTIONAL, signature, issuer,
+ *   thisUpdate Time, nextUpdate Time OPTIONAL,
+ *   revokedCertificates SEQUENCE OF ... OPTIONAL, crlExtensions [0] OPTIONAL }
+ * The revoked list is kept as a span and walked entry by entry.
+ */
+static const der_template_t tbs_cert_list_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_INTEGER,
+     .flags = DER_TMPL_OPTIONAL},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_SEQUENCE},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_SEQUENCE,
+     .store = DER_STORE_TLV, .offset = offsetof(crl_info_t, issuer)},
+    {.kind = DER_TMPL_CHOICE, .children = this_update_template},
+    {.kind = DER_TMPL_CHOICE, .flags = DER_TMPL_OPTIONAL,
+     .children = next_update_template},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_SEQUENCE,
+     .flags = DER_TMPL_OPTIONAL, .store = DER_STORE_VALUE,
+     .offset = offsetof(crl_info_t, revoked)},
+    DER_TEMPLATE_END,
+};
+
+/* CertificateList ::= SEQUENCE { tbsCertList, signatureAlgorithm, signature } */
+static const der_template_t cert_list_fields_template[] = {
+    {.kind = DER_TMPL_CONSTRUCTED, .tag = DER_TAG_SEQUENCE,
+     .children = tbs_cert_list_template},
+    DER_TEMPLATE_END,
+};
+
+static const der_template_t cert_list_template[] = {
+    {.kind = DER_TMPL_CONSTRUCTED, .tag = DER_TAG_SEQUENCE,
+     .children = cert_list_fields_template},
+    DER_TEMPLATE_END,
+};
+
+static const der_template_t revocation_date_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_UTC_TIME,
+     .store = DER_STORE_CONVERT, .offset = offsetof(crl_revoked_t, revoked_at),
+     .convert = x509_time_convert},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_GENERALIZED_TIME,
+     .store = DER_STORE_CONVERT, .offset = offsetof(crl_revoked_t, revoked_at),
+     .convert = x509_time_convert},
+    DER_TEMPLATE_END,
+};
+
+/*
+ * The contents of one revokedCertificates entry: SEQUENCE { userCertificate
+ * INTEGER, revocationDate Time, crlEntryExtensions OPTIONAL }
+ */
+static const der_template_t revoked_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_INTEGER,
+     .store = DER_STORE_VALUE, .offset = offsetof(crl_revoked_t, serial)},
+    {.kind = DER_TMPL_CHOICE, .children = revocation_date_template},
+    DER_TEMPLATE_END,
+};
+
+static void normalize_serial(const uint8_t **serial, size_t *len) {
+  while (*len > 1 && (*serial)[0] == 0x00) {
+    (*serial)++;
+    (*len)--;
+  }
+}
+
+static uint64_t serial_prefix(const uint8_t *serial, size_t len) {
+  uint64_t prefix = 0;
+  for (size_t i = 0; i < 8; i++) {
+    prefix = (prefix << 8) | (i < len ? serial[i] : 0);
+  }
+  return prefix;
+}
+
+static der_error_t crl_parse_header(const uint8_t *der_data, size_t der_len,
+                                    crl_info_t *info) {
+  memset(info, 0, sizeof(crl_info_t));
+  return der_template_decode(cert_list_template, der_data, der_len,
+                             DER_TEMPLATE_ALL, info);
+}
+
+static der_error_t decode_revoked(const uint8_t *value, size_t length,
+                                  crl_revoked_t *revoked) {
+  der_error_t err = der_template_decode(revoked_template, value, length,
+                                        DER_TEMPLATE_ALL, revoked);
+  if (err == DER_OK && revoked->serial.len == 0) {
+    return DER_ERROR_INVALID_TAG;
+  }
+  return err;
+}
+
+der_error_t crl_parse(const uint8_t *der_data, size_t der_len,
+                      crl_info_t *info, crl_entry_fn entry, void *user) {
+  if (!der_data || !info) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  der_error_t err = crl_parse_header(der_data, der_len, info);
+  if (err != DER_OK || !info->revoked.data) {
+    return err;
+  }
+
+  der_ctx_t list;
+  der_init(&list, (uint8_t *)info->revoked.data, info->revoked.len);
+
+  while (der_get_remaining(&list) > 0) {
+    der_tlv_t item;
+    err = der_decode_tlv(&list, &item);
+    if (err != DER_OK) {
+      return err;
+    }
+
+    crl_revoked_t revoked;
+    err = decode_revoked(item.value, item.length, &revoked);
+    if (err != DER_OK) {
+      return err;
+    }
+
+    info->revoked_count++;
+    if (entry) {
+      err = entry(revoked.serial.data, revoked.serial.len, revoked.revoked_at,
+                  user);
+      if (err != DER_OK) {
+        return err;
+      }
+    }
+  }
+
+  return DER_OK;
+}
+
+typedef struct {
+  const der_index_t *index;
+  crl_set_entry_t *entries;
+  uint8_t **blobs;
+  size_t *blob_sizes;
+  size_t *firsts;
+  size_t *counts;
+} crl_set_builder_t;
+
+static der_error_t collect_chunk(const uint8_t *data,
+                                 const der_index_entry_t *items, size_t count,
+                                 size_t chunk, void *user) {
+  crl_set_builder_t *builder = user;
+  size_t first = (size_t)(items - builder->index->entries);
+
+  size_t capacity = 0;
+  for (size_t i = 0; i < count; i++) {
+    capacity += items[i].length;
+  }
+
+  uint8_t *blob = malloc(capacity + 1);
+  if (!blob) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+  builder->blobs[chunk] = blob;
+  builder->firsts[chunk] = first;
+  builder->counts[chunk] = count;
+
+  size_t blob_size = 0;
+  for (size_t i = 0; i < count; i++) {
+    crl_revoked_t revoked;
+    der_error_t err = decode_revoked(
+        data + items[i].offset + items[i].header_len, items[i].length,
+        &revoked);
+    if (err != DER_OK) {
+      return err;
+    }
+
+    const uint8_t *value = revoked.serial.data;
+    size_t value_len = revoked.serial.len;
+    normalize_serial(&value, &value_len);
+
+    crl_set_entry_t *entry = &builder->entries[first + i];
+    entry->prefix = serial_prefix(value, value_len);
+    entry->revoked_at = revoked.revoked_at;
+    entry->serial_offset = (uint32_t)blob_size;
+    entry->serial_len = (uint32_t)value_len;
+
+    memcpy(&blob[blob_size], value, value_len);
+    blob_size += value_len;
+  }
+
+  builder->blob_sizes[chunk] = blob_size;
+  return DER_OK;
+}
+
+static int compare_entries(const void *a, const void *b) {
+  const crl_set_entry_t *x = a;
+  const crl_set_entry_t *y = b;
+  if (x->prefix != y->prefix) {
+    return x->prefix < y->prefix ? -1 : 1;
+  }
+  return (x->serial_len > y->serial_len) - (x->serial_len < y->serial_len);
+}
+
+static void crl_set_bind(crl_set_t *set, const uint8_t *base) {
+  set->header = (const crl_set_header_t *)base;
+  set->entries = (const crl_set_entry_t *)(base + sizeof(crl_set_header_t));
+  set->blob = (const uint8_t *)(set->entries + set->header->count);
+}
+
+der_error_t crl_set_build(const uint8_t *der_data, size_t der_len,
+                          crl_set_t *set) {
+  if (!der_data || !set) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  memset(set, 0, sizeof(crl_set_t));
+
+  crl_info_t info;
+  der_error_t err = crl_parse_header(der_data, der_len, &info);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  der_index_t index;
+  memset(&index, 0, sizeof(index));
+  if (info.revoked.data) {
+    err = der_index_children(info.revoked.data, info.revoked.len, &index);
+    if (err != DER_OK) {
+      return err;
+    }
+  }
+
+  int threads = der_default_threads();
+  size_t chunks = der_index_chunk_count(&index, threads);
+  size_t size = sizeof(crl_set_header_t) +
+                index.count * sizeof(crl_set_entry_t) + info.revoked.len;
+
+  uint8_t *buffer = calloc(1, size);
+  crl_set_builder_t builder;
+  builder.index = &index;
+  builder.entries = (crl_set_entry_t *)(buffer + sizeof(crl_set_header_t));
+  builder.blobs = calloc(chunks + 1, sizeof(uint8_t *));
+  builder.blob_sizes = calloc(chunks + 1, sizeof(size_t));
+  builder.firsts = calloc(chunks + 1, sizeof(size_t));
+  builder.counts = calloc(chunks + 1, sizeof(size_t));
+
+  if (!buffer || !builder.blobs || !builder.blob_sizes || !builder.firsts ||
+      !builder.counts) {
+    err = DER_ERROR_BUFFER_TOO_SMALL;
+  } else if (index.count > 0) {
+    err = der_index_parallel(info.revoked.data, &index, threads, collect_chunk,
+                             &builder);
+  }
+
+  size_t blob_size = 0;
+  if (err == DER_OK) {
+    uint8_t *blob = (uint8_t *)(builder.entries + index.count);
+    for (size_t c = 0; c < chunks; c++) {
+      for (size_t i = 0; i < builder.counts[c]; i++) {
+        builder.entries[builder.firsts[c] + i].serial_offset +=
+            (uint32_t)blob_size;
+      }
+      memcpy(&blob[blob_size], builder.blobs[c], builder.blob_sizes[c]);
+      blob_size += builder.blob_sizes[c];
+    }
+
+    qsort(builder.entries, index.count, sizeof(crl_set_entry_t),
+          compare_entries);
+
+    crl_set_header_t *header = (crl_set_header_t *)buffer;
+    memcpy(header->magic, CRL_SET_MAGIC, 8);
+    header->count = index.count;
+    header->blob_size = blob_size;
+    header->this_update = info.this_update;
+    header->next_update = info.next_update;
+    header->issuer_hash = hash64(info.issuer.data, info.issuer.len);
+
+    set->buffer = buffer;
+    set->size = sizeof(crl_set_header_t) +
+                index.count * sizeof(crl_set_entry_t) + blob_size;
+    crl_set_bind(set, buffer);
+  } else {
+    free(buffer);
+  }
+
+  for (size_t c = 0; builder.blobs && c < chunks; c++) {
+    free(builder.blobs[c]);
+  }
+  free(builder.blobs);
+  free(builder.blob_sizes);
+  free(builder.firsts);
+  free(builder.counts);
+  der_index_free(&index);
+  return err;
+}
+
+der_error_t crl_set_save(const crl_set_t *set, const char *filename) {
+  if (!set || !set->header || !filename) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  size_t len = strlen(filename);
+  char *tmp_path = malloc(len + 5);
+  if (!tmp_path) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+  memcpy(tmp_path, filename, len);
+  memcpy(tmp_path + len, ".tmp", 5);
+
+  FILE *fp = fopen(tmp_path, "wb");
+  if (!fp) {
+    free(tmp_path);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  bool ok = fwrite(set->header, 1, set->size, fp) == set->size;
+  ok = fclose(fp) == 0 && ok;
+  if (!ok || rename(tmp_path, filename) != 0) {
+    remove(tmp_path);
+    ok = false;
+  }
+
+  free(tmp_path);
+  return ok ? DER_OK : DER_ERROR_INVALID_DATA;
+}
+
+der_error_t crl_set_open(crl_set_t *set, const char *filename) {
+  if (!set || !filename) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  memset(set, 0, sizeof(crl_set_t));
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(crl_set_header_t)) {
+    close(fd);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return DER_ERROR_INVALID_DATA;
+  }
+  posix_madvise(map, (size_t)st.st_size, POSIX_MADV_RANDOM);
+
+  /*
+   * count is bounded by the bytes after the header before it is
+   * multiplied, so neither the product nor the sum can wrap.
+   */
+  const crl_set_header_t *header = map;
+  uint64_t left = (uint64_t)st.st_size - sizeof(crl_set_header_t);
+  if (memcmp(header->magic, CRL_SET_MAGIC, 8) != 0 ||
+      header->count > left / sizeof(crl_set_entry_t) ||
+      header->blob_size != left - header->count * sizeof(crl_set_entry_t)) {
+    munmap(map, (size_t)st.st_size);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  set->map = map;
+  set->size = (size_t)st.st_size;
+  crl_set_bind(set, map);
+
+  for (uint64_t i = 0; i < header->count; i++) {
+    if ((uint64_t)set->entries[i].serial_offset + set->entries[i].serial_len >
+        header->blob_size) {
+      crl_set_free(set);
+      return DER_ERROR_INVALID_DATA;
+    }
+  }
+
+  return DER_OK;
+}
+
+void crl_set_free(crl_set_t *set) {
+  if (!set) {
+    return;
+  }
+
+  if (set->map) {
+    munmap(set->map, set->size);
+  }
+  free(set->buffer);
+  memset(set, 0, sizeof(crl_set_t));
+}
+
+bool crl_set_contains(const crl_set_t *set, const uint8_t *serial,
+                      size_t serial_len, int64_t *revoked_at) {
+  if (!set || !set->header || !serial || serial_len == 0) {
+    return false;
+  }
+
+  normalize_serial(&serial, &serial_len);
+  uint64_t prefix = serial_prefix(serial, serial_len);
+
+  size_t lo = 0, hi = set->header->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (set->entries[mid].prefix < prefix) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (size_t i = lo; i < set->header->count && set->entries[i].prefix == prefix;
+       i++) {
+    const crl_set_entry_t *entry = &set->entries[i];
+    if (entry->serial_len == serial_len &&
+        memcmp(&set->blob[entry->serial_offset], serial, serial_len) == 0) {
+      if (revoked_at) {
+        *revoked_at = entry->revoked_at;
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../der/der.h"
+#include "../x509/x509.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRL_SET_MAGIC "QCCRLSET"
+
+typedef struct {
+  x509_span_t issuer;
+  int64_t this_update;
+  int64_t next_update;
+  x509_span_t revoked;
+  size_t revoked_count;
+} crl_info_t;
+
+typedef der_error_t (*crl_entry_fn)(const uint8_t *serial, size_t serial_len,
+                                    int64_t revoked_at, void *user);
+
+typedef struct {
+  char magic[8];
+  uint64_t count;
+  uint64_t blob_size;
+  int64_t this_update;
+  int64_t next_update;
+  uint64_t issuer_hash;
+} crl_set_header_t;
+
+typedef struct {
+  uint64_t prefix;
+  int64_t revoked_at;
+  uint32_t serial_offset;
+  uint32_t serial_len;
+} crl_set_entry_t;
+
+typedef struct {
+  const crl_set_header_t *header;
+  const crl_set_entry_t *entries;
+  const uint8_t *blob;
+  void *buffer;
+  void *map;
+  size_t size;
+} crl_set_t;
+
+der_error_t crl_parse(const uint8_t *der_data, size_t der_len,
+                      crl_info_t *info, crl_entry_fn entry, void *user);
+
+der_error_t crl_set_build(const uint8_t *der_data, size_t der_len,
+                          crl_set_t *set);
+der_error_t crl_set_save(const crl_set_t *set, const char *filename);
+der_error_t crl_set_open(crl_set_t *set, const char *filename);
+void crl_set_free(crl_set_t *set);
+
+bool crl_set_contains(const crl_set_t *set, const uint8_t *serial,
+                      size_t serial_len, int64_t *revoked_at);
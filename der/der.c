@@ -1,4 +1,5 @@
 #include "der.h"
+#include "../util/stats.h"
 #include <string.h>
 
 der_error_t der_init(der_ctx_t *ctx, uint8_t *buffer, size_t size) {
@@ -183,6 +184,7 @@ der_error_t der_decode_tlv(der_ctx_t *ctx, der_tlv_t *tlv) {
   tlv->value = &ctx->data[ctx->pos];
   ctx->pos += tlv->length;
 
+  STATS_ADD(STATS_TLVS_DECODED, 1);
   return DER_OK;
 }
 
@@ -433,8 +435,13 @@ der_error_t der_skip_element(der_ctx_t *ctx) {
     return DER_ERROR_NULL_POINTER;
   }
 
+  size_t start = ctx->pos;
   der_tlv_t tlv;
-  return der_decode_tlv(ctx, &tlv);
+  der_error_t err = der_decode_tlv(ctx, &tlv);
+  if (err == DER_OK) {
+    STATS_ADD(STATS_BYTES_SKIPPED, ctx->pos - start);
+  }
+  return err;
 }
 
 der_error_t der_peek_tag(der_ctx_t *ctx, uint8_t *tag) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../qcert_config.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -1,5 +1,14 @@
+#define _DEFAULT_SOURCE
+
 #include "der_file.h"
+#include "der_index.h"
 #include "der_utils.h"
+#include "../util/stats.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 der_error_t der_file_read(const char *filename, der_file_t *file) {
   if (!filename || !file) {
@@ -8,49 +17,104 @@ der_error_t der_file_read(const char *filename, der_file_t *file) {
 
   memset(file, 0, sizeof(der_file_t));
 
-  FILE *fp = fopen(filename, "rb");
-  if (!fp) {
+  STATS_STAGE_BEGIN(start);
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
     return DER_ERROR_INVALID_DATA;
   }
 
-  if (fseek(fp, 0, SEEK_END) != 0) {
-    fclose(fp);
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 0 ||
+      st.st_size > DER_MAX_FILE_SIZE) {
+    close(fd);
     return DER_ERROR_INVALID_DATA;
   }
 
-  long file_size = ftell(fp);
-  if (file_size < 0 || file_size > DER_MAX_FILE_SIZE) {
-    fclose(fp);
-    return DER_ERROR_INVALID_DATA;
+  size_t file_size = (size_t)st.st_size;
+  uint8_t *buffer = malloc(file_size);
+  if (!buffer) {
+    close(fd);
+    return DER_ERROR_BUFFER_TOO_SMALL;
   }
 
-  if (fseek(fp, 0, SEEK_SET) != 0) {
-    fclose(fp);
-    return DER_ERROR_INVALID_DATA;
+  size_t done = 0;
+  while (done < file_size) {
+    ssize_t n = read(fd, buffer + done, file_size - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      close(fd);
+      free(buffer);
+      return DER_ERROR_INVALID_DATA;
+    }
+    done += (size_t)n;
   }
+  close(fd);
 
-  file->data = malloc((size_t)file_size);
-  if (!file->data) {
-    fclose(fp);
-    return DER_ERROR_BUFFER_TOO_SMALL;
+  file->data = buffer;
+  file->size = file_size;
+  file->owns_data = true;
+  der_init(&file->ctx, buffer, file->size);
+
+  STATS_ADD(STATS_FILES_READ, 1);
+  STATS_ADD(STATS_BYTES_READ, file->size);
+  STATS_STAGE_END(STATS_STAGE_READ, start);
+  return DER_OK;
+}
+
+der_error_t der_file_map(const char *filename, der_file_t *file,
+                         der_access_t access) {
+  if (!filename || !file) {
+    return DER_ERROR_NULL_POINTER;
   }
 
-  size_t bytes_read = fread(file->data, 1, (size_t)file_size, fp);
-  fclose(fp);
+  memset(file, 0, sizeof(der_file_t));
 
-  if (bytes_read != (size_t)file_size) {
-    free(file->data);
-    file->data = NULL;
+  STATS_STAGE_BEGIN(start);
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
     return DER_ERROR_INVALID_DATA;
   }
 
-  file->size = (size_t)file_size;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+    close(fd);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  flags |= MAP_POPULATE;
+#endif
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, flags, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  file->data = map;
+  file->size = (size_t)st.st_size;
   file->owns_data = true;
-  der_init(&file->ctx, file->data, file->size);
+  file->is_mapped = true;
+  der_init(&file->ctx, map, file->size);
+  der_file_advise(file, access);
 
+  STATS_ADD(STATS_FILES_READ, 1);
+  STATS_ADD(STATS_BYTES_READ, file->size);
+  STATS_STAGE_END(STATS_STAGE_READ, start);
   return DER_OK;
 }
 
+void der_file_advise(der_file_t *file, der_access_t access) {
+  if (!file || !file->is_mapped) {
+    return;
+  }
+
+  madvise((void *)file->data, file->size,
+          access == DER_ACCESS_RANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+}
+
 der_error_t der_file_read_buffer(const uint8_t *buffer, size_t size,
                                  der_file_t *file) {
   if (!buffer || !file || size == 0) {
@@ -59,10 +123,10 @@ der_error_t der_file_read_buffer(const uint8_t *buffer, size_t size,
 
   memset(file, 0, sizeof(der_file_t));
 
-  file->data = (uint8_t *)buffer;
+  file->data = buffer;
   file->size = size;
   file->owns_data = false;
-  der_init(&file->ctx, file->data, file->size);
+  der_init(&file->ctx, (uint8_t *)buffer, file->size);
 
   return DER_OK;
 }
@@ -73,12 +137,17 @@ void der_file_free(der_file_t *file) {
   }
 
   if (file->owns_data && file->data) {
-    free(file->data);
+    if (file->is_mapped) {
+      munmap((void *)file->data, file->size);
+    } else {
+      free((void *)file->data);
+    }
   }
 
   memset(file, 0, sizeof(der_file_t));
 }
 
+#ifndef QCERT_NO_STDIO
 der_error_t der_file_parse_structure(der_file_t *file) {
   if (!file || !file->data) {
     return DER_ERROR_NULL_POINTER;
@@ -95,15 +164,19 @@ der_error_t der_file_parse_structure(der_file_t *file) {
 
   return DER_OK;
 }
+#endif
 
 der_error_t der_file_validate(der_file_t *file) {
   if (!file || !file->data) {
     return DER_ERROR_NULL_POINTER;
   }
 
-  return der_validate_structure(file->data, file->size);
+  der_file_advise(file, DER_ACCESS_SEQUENTIAL);
+  return der_validate_structure_parallel(file->data, file->size,
+                                         der_default_threads());
 }
 
+#ifndef QCERT_NO_STDIO
 der_error_t der_file_print_info(der_file_t *file) {
   if (!file || !file->data) {
     return DER_ERROR_NULL_POINTER;
@@ -139,6 +212,7 @@ der_error_t der_file_print_info(der_file_t *file) {
   printf("\n");
   return DER_OK;
 }
+#endif
 
 der_error_t der_file_write(const char *filename, const uint8_t *data,
                            size_t size) {
@@ -146,15 +220,24 @@ der_error_t der_file_write(const char *filename, const uint8_t *data,
     return DER_ERROR_NULL_POINTER;
   }
 
-  FILE *fp = fopen(filename, "wb");
-  if (!fp) {
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
     return DER_ERROR_INVALID_DATA;
   }
 
-  size_t bytes_written = fwrite(data, 1, size, fp);
-  fclose(fp);
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = write(fd, data + done, size - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += (size_t)n;
+  }
 
-  if (bytes_written != size) {
+  if (close(fd) != 0 || done != size) {
     return DER_ERROR_INVALID_DATA;
   }
 
@@ -305,10 +388,6 @@ der_error_t der_file_extract_cert_info(der_file_t *file,
     }
   }
 
-  printf("Certificate parsing: Basic structure detected\n");
-  printf(
-      "Note: Full certificate parsing requires more complex ASN.1 handling\n");
-
   return DER_OK;
 }
 
@@ -1,27 +1,45 @@
 #pragma once
 
 #include "der.h"
+#ifndef QCERT_NO_STDIO
 #include <stdio.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
 
 #define DER_MAX_FILE_SIZE (10 * 1024 * 1024)
 
+typedef enum {
+  DER_ACCESS_SEQUENTIAL,
+  DER_ACCESS_RANDOM
+} der_access_t;
+
+/*
+ * data is read-only. A mapped file's pages are PROT_READ, so its ctx is
+ * only for decoding; der_file_read gives a private copy ctx can write to.
+ */
 typedef struct {
-  uint8_t *data;
+  const uint8_t *data;
   size_t size;
   der_ctx_t ctx;
   bool owns_data;
+  bool is_mapped;
 } der_file_t;
 
 der_error_t der_file_read(const char *filename, der_file_t *file);
+/* Maps the file read-only instead of copying it; no size limit applies. */
+der_error_t der_file_map(const char *filename, der_file_t *file,
+                         der_access_t access);
+void der_file_advise(der_file_t *file, der_access_t access);
 der_error_t der_file_read_buffer(const uint8_t *buffer, size_t size,
                                  der_file_t *file);
 void der_file_free(der_file_t *file);
 
-der_error_t der_file_parse_structure(der_file_t *file);
 der_error_t der_file_validate(der_file_t *file);
+#ifndef QCERT_NO_STDIO
+der_error_t der_file_parse_structure(der_file_t *file);
 der_error_t der_file_print_info(der_file_t *file);
+#endif
 
 der_error_t der_file_write(const char *filename, const uint8_t *data,
                            size_t size);
@@ -0,0 +1,231 @@
+#define _XOPEN_SOURCE 700
+
+#include "der_gather.h"
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+/* iovecs per writev call, within what the system accepts. */
+#if defined(IOV_MAX) && IOV_MAX < 64
+#define DER_GATHER_WRITE_BATCH IOV_MAX
+#else
+#define DER_GATHER_WRITE_BATCH 64
+#endif
+
+static size_t put_header(uint8_t *out, uint8_t tag, size_t length) {
+  der_ctx_t ctx = {out, DER_GATHER_HEADER_MAX, 0};
+  der_encode_tlv_header(&ctx, tag, length);
+  return ctx.pos;
+}
+
+static der_error_t fail(der_gather_t *gather, der_error_t err) {
+  if (gather->error == DER_OK) {
+    gather->error = err;
+  }
+  return gather->error;
+}
+
+/* Appends an iovec, or extends the last one when data follows it. */
+static der_error_t add_iov(der_gather_t *gather, const uint8_t *data,
+                           size_t len) {
+  if (len == 0) {
+    return DER_OK;
+  }
+  if (gather->iov_count > 0) {
+    struct iovec *last = &gather->iov[gather->iov_count - 1];
+    if ((const uint8_t *)last->iov_base + last->iov_len == data) {
+      last->iov_len += len;
+      gather->total += len;
+      return DER_OK;
+    }
+  }
+  if (gather->iov_count >= gather->iov_max) {
+    return fail(gather, DER_ERROR_OVERFLOW);
+  }
+  gather->iov[gather->iov_count].iov_base = (void *)data;
+  gather->iov[gather->iov_count].iov_len = len;
+  gather->iov_count++;
+  gather->total += len;
+  return DER_OK;
+}
+
+static uint8_t *reserve(der_gather_t *gather, size_t len) {
+  if (len > gather->buffer_size - gather->buffer_len) {
+    fail(gather, DER_ERROR_BUFFER_TOO_SMALL);
+    return NULL;
+  }
+  uint8_t *p = gather->buffer + gather->buffer_len;
+  gather->buffer_len += len;
+  return p;
+}
+
+void der_gather_init(der_gather_t *gather, uint8_t *buffer, size_t buffer_size,
+                     struct iovec *iov, size_t iov_max) {
+  memset(gather, 0, sizeof(der_gather_t));
+  gather->buffer = buffer;
+  gather->buffer_size = buffer ? buffer_size : 0;
+  gather->iov = iov;
+  gather->iov_max = iov ? iov_max : 0;
+}
+
+der_error_t der_gather_copy(der_gather_t *gather, const void *data,
+                            size_t len) {
+  if (!gather) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (gather->error != DER_OK) {
+    return gather->error;
+  }
+  if (!data && len > 0) {
+    return fail(gather, DER_ERROR_NULL_POINTER);
+  }
+
+  uint8_t *p = reserve(gather, len);
+  if (!p) {
+    return gather->error;
+  }
+  if (len > 0) {
+    memcpy(p, data, len);
+  }
+  return add_iov(gather, p, len);
+}
+
+der_error_t der_gather_ref(der_gather_t *gather, const void *data, size_t len) {
+  if (!gather) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (gather->error != DER_OK) {
+    return gather->error;
+  }
+  if (!data && len > 0) {
+    return fail(gather, DER_ERROR_NULL_POINTER);
+  }
+
+  /* An iovec for a few bytes costs more than copying them. */
+  if (len < DER_GATHER_COPY_MAX) {
+    return der_gather_copy(gather, data, len);
+  }
+  return add_iov(gather, data, len);
+}
+
+der_error_t der_gather_element(der_gather_t *gather, uint8_t tag,
+                               const void *value, size_t len) {
+  if (!gather) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (gather->error != DER_OK) {
+    return gather->error;
+  }
+  if (!value && len > 0) {
+    return fail(gather, DER_ERROR_NULL_POINTER);
+  }
+
+  uint8_t *header = reserve(gather, 1 + der_length_size(len));
+  if (!header) {
+    return gather->error;
+  }
+  if (add_iov(gather, header, put_header(header, tag, len)) != DER_OK) {
+    return gather->error;
+  }
+  return der_gather_ref(gather, value, len);
+}
+
+der_error_t der_gather_open(der_gather_t *gather, uint8_t tag) {
+  if (!gather) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (gather->error != DER_OK) {
+    return gather->error;
+  }
+  if (gather->depth >= DER_GATHER_MAX_DEPTH) {
+    return fail(gather, DER_ERROR_OVERFLOW);
+  }
+  if (gather->iov_count >= gather->iov_max) {
+    return fail(gather, DER_ERROR_OVERFLOW);
+  }
+
+  uint8_t *header = reserve(gather, DER_GATHER_HEADER_MAX);
+  if (!header) {
+    return gather->error;
+  }
+  header[0] = tag;
+  gather->open[gather->depth].iov = gather->iov_count;
+  gather->open[gather->depth].start = gather->total;
+  gather->depth++;
+  gather->iov[gather->iov_count].iov_base = header;
+  gather->iov[gather->iov_count].iov_len = 0;
+  gather->iov_count++;
+  return DER_OK;
+}
+
+der_error_t der_gather_close(der_gather_t *gather) {
+  if (!gather) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (gather->error != DER_OK) {
+    return gather->error;
+  }
+  if (gather->depth == 0) {
+    return fail(gather, DER_ERROR_INVALID_DATA);
+  }
+
+  gather->depth--;
+  struct iovec *header = &gather->iov[gather->open[gather->depth].iov];
+  uint8_t *p = header->iov_base;
+  size_t len = gather->total - gather->open[gather->depth].start;
+  header->iov_len = put_header(p, p[0], len);
+  gather->total += header->iov_len;
+  return DER_OK;
+}
+
+der_error_t der_gather_finish(der_gather_t *gather) {
+  if (!gather) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (gather->depth != 0) {
+    return fail(gather, DER_ERROR_INVALID_DATA);
+  }
+  return gather->error;
+}
+
+der_error_t der_gather_write(const der_gather_t *gather, int fd) {
+  if (!gather) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (gather->error != DER_OK || gather->depth != 0) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  size_t next = 0;
+  size_t offset = 0; /* already written from iov[next] */
+  while (next < gather->iov_count) {
+    struct iovec batch[DER_GATHER_WRITE_BATCH];
+    size_t count = 0;
+    for (size_t i = next;
+         i < gather->iov_count && count < DER_GATHER_WRITE_BATCH; i++) {
+      batch[count] = gather->iov[i];
+      if (i == next) {
+        batch[count].iov_base = (uint8_t *)batch[count].iov_base + offset;
+        batch[count].iov_len -= offset;
+      }
+      count++;
+    }
+
+    ssize_t n = writev(fd, batch, (int)count);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return DER_ERROR_INVALID_DATA;
+    }
+
+    size_t written = (size_t)n + offset;
+    while (next < gather->iov_count && written >= gather->iov[next].iov_len) {
+      written -= gather->iov[next].iov_len;
+      next++;
+    }
+    offset = written;
+  }
+  return DER_OK;
+}
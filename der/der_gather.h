@@ -0,0 +1,61 @@
+#pragma once
+
+#include "der.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define DER_GATHER_MAX_DEPTH 8
+/* Largest header: tag, long-form marker and a size_t of length bytes. */
+#define DER_GATHER_HEADER_MAX (2 + sizeof(size_t))
+/* References shorter than this are copied into the buffer instead. */
+#define DER_GATHER_COPY_MAX 64
+
+/*
+ * Scatter-gather encoding: the output is a list of iovecs rather than one
+ * buffer. Headers and small elements are written into the caller's buffer;
+ * large contents are referenced where they lie, so wrapping a big payload
+ * or a chain of certificates costs a few header bytes instead of a copy of
+ * the body. Referenced memory must stay valid until the iovecs are written.
+ *
+ * A constructed element reserves DER_GATHER_HEADER_MAX bytes and an iovec
+ * when opened; the header is written into them on close, once its length
+ * is known. Builder calls after a failure do nothing and return the first
+ * error.
+ */
+typedef struct {
+  uint8_t *buffer;
+  size_t buffer_size;
+  size_t buffer_len;
+  struct iovec *iov;
+  size_t iov_max;
+  size_t iov_count;
+  size_t total; /* bytes encoded so far, headers of open elements excluded */
+  struct {
+    size_t iov;   /* the iovec reserved for the header */
+    size_t start; /* total when the element was opened */
+  } open[DER_GATHER_MAX_DEPTH];
+  size_t depth;
+  der_error_t error;
+} der_gather_t;
+
+void der_gather_init(der_gather_t *gather, uint8_t *buffer, size_t buffer_size,
+                     struct iovec *iov, size_t iov_max);
+/* Copies already encoded bytes, such as an AlgorithmIdentifier. */
+der_error_t der_gather_copy(der_gather_t *gather, const void *data,
+                            size_t len);
+/* References already encoded bytes, such as a certificate, without a copy. */
+der_error_t der_gather_ref(der_gather_t *gather, const void *data, size_t len);
+/*
+ * Writes a header and references the contents: the scatter-gather form of
+ * der_encode_octet_string and der_encode_sequence_complete.
+ */
+der_error_t der_gather_element(der_gather_t *gather, uint8_t tag,
+                               const void *value, size_t len);
+der_error_t der_gather_open(der_gather_t *gather, uint8_t tag);
+der_error_t der_gather_close(der_gather_t *gather);
+/* Checks that every element was closed; returns the first builder error. */
+der_error_t der_gather_finish(der_gather_t *gather);
+
+/* writev()s the iovecs to fd, resuming after short writes. */
+der_error_t der_gather_write(const der_gather_t *gather, int fd);
@@ -0,0 +1,504 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "der_index.h"
+#include "der_utils.h"
+#include "der_walk.h"
+#include "../util/trace.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int der_default_threads(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+}
+
+static der_error_t index_append(der_index_t *index,
+                                const der_index_entry_t *entry, bool hashes) {
+  if (index->count == index->capacity) {
+    size_t capacity = index->capacity ? index->capacity * 2 : 1024;
+    der_index_entry_t *grown =
+        realloc(index->entries, capacity * sizeof(der_index_entry_t));
+    if (!grown) {
+      return DER_ERROR_BUFFER_TOO_SMALL;
+    }
+    index->entries = grown;
+    if (hashes) {
+      uint64_t *grown_hashes =
+          realloc(index->hashes, capacity * sizeof(uint64_t));
+      if (!grown_hashes) {
+        return DER_ERROR_BUFFER_TOO_SMALL;
+      }
+      index->hashes = grown_hashes;
+    }
+    index->capacity = capacity;
+  }
+
+  index->entries[index->count++] = *entry;
+  return DER_OK;
+}
+
+der_error_t der_index_children(const uint8_t *data, size_t length,
+                               der_index_t *index) {
+  if (!data || !index) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  memset(index, 0, sizeof(der_index_t));
+
+  der_ctx_t ctx;
+  der_init(&ctx, (uint8_t *)data, length);
+
+  while (der_get_remaining(&ctx) > 0) {
+    der_index_entry_t entry;
+    entry.offset = der_get_position(&ctx);
+
+    der_error_t err = der_decode_tag(&ctx, &entry.tag);
+    if (err == DER_OK) {
+      err = der_decode_length(&ctx, &entry.length);
+    }
+    if (err == DER_OK && der_get_remaining(&ctx) < entry.length) {
+      err = DER_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (err != DER_OK) {
+      der_index_free(index);
+      return err;
+    }
+
+    entry.header_len = der_get_position(&ctx) - entry.offset;
+    if (entry.header_len != 1 + der_length_size(entry.length)) {
+      der_index_free(index);
+      return DER_ERROR_INVALID_DATA;
+    }
+
+    entry.depth = 0;
+    entry.subtree = 1;
+    if (index_append(index, &entry, false) != DER_OK) {
+      der_index_free(index);
+      return DER_ERROR_BUFFER_TOO_SMALL;
+    }
+    ctx.pos += entry.length;
+  }
+
+  return DER_OK;
+}
+
+/*
+ * Subtree hashes. Contents are taken a word at a time; each step multiplies
+ * and folds the high half down, so every input bit reaches the whole state.
+ */
+#define HASH_SEED 0x9e3779b97f4a7c15ULL
+#define HASH_MUL 0xff51afd7ed558ccdULL
+
+static uint64_t hash_step(uint64_t hash, uint64_t word) {
+  hash = (hash ^ word) * HASH_MUL;
+  return hash ^ (hash >> 32);
+}
+
+static uint64_t hash_start(uint8_t tag, size_t length) {
+  return hash_step(HASH_SEED ^ ((uint64_t)tag << 56), length);
+}
+
+static uint64_t hash_primitive(const der_walk_node_t *node) {
+  uint64_t hash = hash_start(node->tag, node->length);
+  const uint8_t *p = node->value;
+  size_t len = node->length;
+  while (len >= sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    hash = hash_step(hash, word);
+    p += sizeof(word);
+    len -= sizeof(word);
+  }
+  if (len > 0) {
+    uint64_t word = 0;
+    memcpy(&word, p, len);
+    hash = hash_step(hash, word);
+  }
+  return hash_step(hash, HASH_SEED);
+}
+
+typedef struct {
+  der_index_t *index; /* NULL when only hashing */
+  bool hashes;
+  /* running hash of the open element at each depth, and its entry */
+  uint64_t state[DER_WALK_MAX_DEPTH];
+  size_t open[DER_WALK_MAX_DEPTH];
+  uint64_t last; /* hash of the last top-level element */
+  der_error_t error;
+} tree_builder_t;
+
+static der_walk_action_t tree_add(tree_builder_t *builder,
+                                  const der_walk_node_t *node, uint64_t hash) {
+  if (builder->index) {
+    der_index_entry_t entry = {node->offset, node->header_len, node->length,
+                               node->tag,    (uint8_t)node->depth, 1};
+    builder->error = index_append(builder->index, &entry, builder->hashes);
+    if (builder->error != DER_OK) {
+      return DER_WALK_STOP;
+    }
+    if (builder->hashes) {
+      builder->index->hashes[builder->index->count - 1] = hash;
+    }
+  }
+  return DER_WALK_CONTINUE;
+}
+
+/* Folds a finished element's hash into its parent's. */
+static void tree_fold(tree_builder_t *builder, size_t depth, uint64_t hash) {
+  if (depth == 0) {
+    builder->last = hash;
+  } else {
+    builder->state[depth - 1] = hash_step(builder->state[depth - 1], hash);
+  }
+}
+
+static der_walk_action_t tree_enter(const der_walk_node_t *node, void *user) {
+  tree_builder_t *builder = user;
+  if (node->depth >= DER_WALK_MAX_DEPTH || node->depth > UINT8_MAX) {
+    builder->error = DER_ERROR_OVERFLOW;
+    return DER_WALK_STOP;
+  }
+  builder->state[node->depth] = hash_start(node->tag, node->length);
+  builder->open[node->depth] = builder->index ? builder->index->count : 0;
+  return tree_add(builder, node, 0);
+}
+
+static der_walk_action_t tree_primitive(const der_walk_node_t *node,
+                                        void *user) {
+  tree_builder_t *builder = user;
+  uint64_t hash = builder->hashes ? hash_primitive(node) : 0;
+  tree_fold(builder, node->depth, hash);
+  return tree_add(builder, node, hash);
+}
+
+static der_walk_action_t tree_leave(const der_walk_node_t *node, void *user) {
+  tree_builder_t *builder = user;
+  uint64_t hash = hash_step(builder->state[node->depth], HASH_SEED);
+  tree_fold(builder, node->depth, hash);
+  if (builder->index) {
+    size_t first = builder->open[node->depth];
+    builder->index->entries[first].subtree =
+        (uint32_t)(builder->index->count - first);
+    if (builder->hashes) {
+      builder->index->hashes[first] = hash;
+    }
+  }
+  return DER_WALK_CONTINUE;
+}
+
+static const der_walk_callbacks_t tree_callbacks = {tree_enter, tree_primitive,
+                                                    tree_leave};
+
+der_error_t der_index_tree(const uint8_t *data, size_t length, uint32_t flags,
+                           der_index_t *index) {
+  if (!data || !index) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  memset(index, 0, sizeof(der_index_t));
+  tree_builder_t builder;
+  memset(&builder, 0, sizeof(builder));
+  builder.index = index;
+  builder.hashes = (flags & DER_INDEX_HASH) != 0;
+
+  der_error_t err = der_walk(data, length, &tree_callbacks, &builder);
+  if (err == DER_OK) {
+    err = builder.error;
+  }
+  if (err != DER_OK) {
+    der_index_free(index);
+  }
+  return err;
+}
+
+der_error_t der_subtree_hash(const uint8_t *data, size_t length,
+                             uint64_t *hash) {
+  if (!data || !hash) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  der_ctx_t ctx;
+  der_init(&ctx, (uint8_t *)data, length);
+  der_tlv_t tlv;
+  der_error_t err = der_decode_tlv(&ctx, &tlv);
+  if (err != DER_OK) {
+    return err;
+  }
+  if (ctx.pos != length) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  tree_builder_t builder;
+  memset(&builder, 0, sizeof(builder));
+  builder.hashes = true;
+  err = der_walk(data, length, &tree_callbacks, &builder);
+  if (err == DER_OK) {
+    err = builder.error;
+  }
+  *hash = builder.last;
+  return err;
+}
+
+void der_index_free(der_index_t *index) {
+  if (!index) {
+    return;
+  }
+
+  free(index->entries);
+  free(index->hashes);
+  memset(index, 0, sizeof(der_index_t));
+}
+
+typedef struct {
+  const der_index_t *a;
+  const der_index_t *b;
+  der_diff_fn fn;
+  void *user;
+} diff_t;
+
+/* Entry numbers of the siblings in [first, end); NULL if out of memory. */
+static size_t *siblings(const der_index_t *index, size_t first, size_t end,
+                        size_t *count) {
+  *count = 0;
+  for (size_t i = first; i < end; i += index->entries[i].subtree) {
+    (*count)++;
+  }
+  size_t *list = malloc((*count ? *count : 1) * sizeof(size_t));
+  if (list) {
+    size_t n = 0;
+    for (size_t i = first; i < end; i += index->entries[i].subtree) {
+      list[n++] = i;
+    }
+  }
+  return list;
+}
+
+static der_error_t diff_range(const diff_t *diff, size_t a_first, size_t a_end,
+                              size_t b_first, size_t b_end);
+
+/*
+ * What identifies an element among its siblings: the hash of its first
+ * child, such as the OID of an Extension or AttributeTypeAndValue, or its
+ * own hash if it has no children.
+ */
+static uint64_t diff_key(const der_index_t *index, size_t entry) {
+  return index->entries[entry].subtree > 1 ? index->hashes[entry + 1]
+                                           : index->hashes[entry];
+}
+
+static der_error_t diff_pair(const diff_t *diff, size_t a, size_t b) {
+  const der_index_entry_t *x = &diff->a->entries[a];
+  const der_index_entry_t *y = &diff->b->entries[b];
+  if (x->tag == y->tag && der_is_constructed(x->tag) && x->subtree > 1 &&
+      y->subtree > 1) {
+    return diff_range(diff, a + 1, a + x->subtree, b + 1, b + y->subtree);
+  }
+  diff->fn(DER_DIFF_CHANGED, a, b, diff->user);
+  return DER_OK;
+}
+
+static der_error_t diff_range(const diff_t *diff, size_t a_first, size_t a_end,
+                              size_t b_first, size_t b_end) {
+  size_t na, nb;
+  size_t *a = siblings(diff->a, a_first, a_end, &na);
+  size_t *b = siblings(diff->b, b_first, b_end, &nb);
+  if (!a || !b) {
+    free(a);
+    free(b);
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+  const uint64_t *ha = diff->a->hashes;
+  const uint64_t *hb = diff->b->hashes;
+
+  /*
+   * Common ends first. In between, elements with equal keys are paired,
+   * and a one-step lookahead by key finds insertions and removals.
+   */
+  size_t i = 0;
+  size_t j = 0;
+  while (i < na && j < nb && ha[a[i]] == hb[b[j]]) {
+    i++;
+    j++;
+  }
+  while (na > i && nb > j && ha[a[na - 1]] == hb[b[nb - 1]]) {
+    na--;
+    nb--;
+  }
+
+  der_error_t err = DER_OK;
+  while (err == DER_OK && i < na && j < nb) {
+    uint64_t key = diff_key(diff->a, a[i]);
+    if (ha[a[i]] == hb[b[j]]) {
+      i++;
+      j++;
+    } else if (key == diff_key(diff->b, b[j])) {
+      err = diff_pair(diff, a[i++], b[j++]);
+    } else if (j + 1 < nb && key == diff_key(diff->b, b[j + 1])) {
+      diff->fn(DER_DIFF_ADDED, SIZE_MAX, b[j++], diff->user);
+    } else if (i + 1 < na &&
+               diff_key(diff->a, a[i + 1]) == diff_key(diff->b, b[j])) {
+      diff->fn(DER_DIFF_REMOVED, a[i++], SIZE_MAX, diff->user);
+    } else {
+      err = diff_pair(diff, a[i++], b[j++]);
+    }
+  }
+  for (; err == DER_OK && i < na; i++) {
+    diff->fn(DER_DIFF_REMOVED, a[i], SIZE_MAX, diff->user);
+  }
+  for (; err == DER_OK && j < nb; j++) {
+    diff->fn(DER_DIFF_ADDED, SIZE_MAX, b[j], diff->user);
+  }
+
+  free(a);
+  free(b);
+  return err;
+}
+
+der_error_t der_index_diff(const der_index_t *a, const der_index_t *b,
+                           der_diff_fn fn, void *user) {
+  if (!a || !b || !fn) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if ((a->count > 0 && !a->hashes) || (b->count > 0 && !b->hashes)) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  diff_t diff = {a, b, fn, user};
+  return diff_range(&diff, 0, a->count, 0, b->count);
+}
+
+size_t der_index_chunk_count(const der_index_t *index, int threads) {
+  if (threads <= 1 || index->count < DER_PARALLEL_MIN_CHILDREN) {
+    return index->count > 0 ? 1 : 0;
+  }
+
+  size_t chunks = (size_t)threads * DER_PARALLEL_CHUNKS_PER_THREAD;
+  return chunks < index->count ? chunks : index->count;
+}
+
+typedef struct {
+  const uint8_t *data;
+  const der_index_t *index;
+  size_t chunks;
+  size_t next;
+  der_chunk_fn fn;
+  void *user;
+  der_error_t error;
+} der_parallel_t;
+
+static void *der_parallel_worker(void *arg) {
+  der_parallel_t *job = arg;
+
+  for (;;) {
+    size_t chunk = __sync_fetch_and_add(&job->next, 1);
+    if (chunk >= job->chunks) {
+      break;
+    }
+
+    size_t first = job->index->count * chunk / job->chunks;
+    size_t last = job->index->count * (chunk + 1) / job->chunks;
+    TRACE_BEGIN(start);
+    der_error_t err = job->fn(job->data, &job->index->entries[first],
+                              last - first, chunk, job->user);
+    TRACE_END(start, "chunk", NULL);
+    if (err != DER_OK) {
+      __sync_bool_compare_and_swap(&job->error, DER_OK, err);
+    }
+  }
+
+  return NULL;
+}
+
+der_error_t der_index_parallel(const uint8_t *data, const der_index_t *index,
+                               int threads, der_chunk_fn fn, void *user) {
+  if (!data || !index || !fn) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  der_parallel_t job;
+  memset(&job, 0, sizeof(job));
+  job.data = data;
+  job.index = index;
+  job.chunks = der_index_chunk_count(index, threads);
+  job.fn = fn;
+  job.user = user;
+  job.error = DER_OK;
+
+  if (job.chunks <= 1) {
+    der_parallel_worker(&job);
+    return job.error;
+  }
+
+  size_t count = (size_t)threads < job.chunks ? (size_t)threads : job.chunks;
+  pthread_t *ids = calloc(count, sizeof(pthread_t));
+  size_t started = 0;
+  while (ids && started < count &&
+         pthread_create(&ids[started], NULL, der_parallel_worker, &job) == 0) {
+    started++;
+  }
+
+  der_parallel_worker(&job);
+  for (size_t i = 0; i < started; i++) {
+    pthread_join(ids[i], NULL);
+  }
+
+  free(ids);
+  return job.error;
+}
+
+static der_error_t validate_chunk(const uint8_t *data,
+                                  const der_index_entry_t *entries,
+                                  size_t count, size_t chunk, void *user) {
+  (void)chunk;
+  (void)user;
+
+  for (size_t i = 0; i < count; i++) {
+    if (!der_is_constructed(entries[i].tag) || entries[i].length == 0) {
+      continue;
+    }
+    der_error_t err = der_validate_structure(
+        data + entries[i].offset + entries[i].header_len, entries[i].length);
+    if (err != DER_OK) {
+      return err;
+    }
+  }
+
+  return DER_OK;
+}
+
+der_error_t der_validate_structure_parallel(const uint8_t *data, size_t length,
+                                            int threads) {
+  if (!data || length == 0) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  if (threads <= 1 || length < DER_PARALLEL_MIN_SIZE) {
+    return der_validate_structure(data, length);
+  }
+
+  der_index_t index;
+  der_error_t err = der_index_children(data, length, &index);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  if (index.count >= DER_PARALLEL_MIN_CHILDREN) {
+    err = der_index_parallel(data, &index, threads, validate_chunk, NULL);
+    der_index_free(&index);
+    return err;
+  }
+
+  for (size_t i = 0; err == DER_OK && i < index.count; i++) {
+    const der_index_entry_t *entry = &index.entries[i];
+    if (!der_is_constructed(entry->tag) || entry->length == 0) {
+      continue;
+    }
+    err = der_validate_structure_parallel(
+        data + entry->offset + entry->header_len, entry->length, threads);
+  }
+
+  der_index_free(&index);
+  return err;
+}
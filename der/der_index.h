@@ -0,0 +1,80 @@
+#pragma once
+
+#include "der.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define DER_PARALLEL_MIN_SIZE (1024 * 1024)
+#define DER_PARALLEL_MIN_CHILDREN 1024
+#define DER_PARALLEL_CHUNKS_PER_THREAD 4
+
+/* der_index_tree: also fill index->hashes. */
+#define DER_INDEX_HASH (1u << 0)
+
+typedef struct {
+  size_t offset;
+  size_t header_len;
+  size_t length;
+  uint8_t tag;
+  uint8_t depth;    /* 0 for top-level elements */
+  uint32_t subtree; /* entries from this one to its next sibling */
+} der_index_entry_t;
+
+typedef struct {
+  der_index_entry_t *entries;
+  uint64_t *hashes; /* per entry, or NULL if not requested */
+  size_t count;
+  size_t capacity;
+} der_index_t;
+
+typedef enum {
+  DER_DIFF_CHANGED, /* a and b are at the same place but differ */
+  DER_DIFF_REMOVED, /* only in a; b is SIZE_MAX */
+  DER_DIFF_ADDED    /* only in b; a is SIZE_MAX */
+} der_diff_kind_t;
+
+/* a and b are entry numbers in the two indexes. */
+typedef void (*der_diff_fn)(der_diff_kind_t kind, size_t a, size_t b,
+                            void *user);
+
+typedef der_error_t (*der_chunk_fn)(const uint8_t *data,
+                                    const der_index_entry_t *entries,
+                                    size_t count, size_t chunk, void *user);
+
+int der_default_threads(void);
+
+der_error_t der_index_children(const uint8_t *data, size_t length,
+                               der_index_t *index);
+/*
+ * Indexes every element at every depth, in encoding order, so an element's
+ * descendants are the subtree - 1 entries after it. With DER_INDEX_HASH
+ * each entry also gets a hash of its subtree: a primitive element hashes
+ * its tag and contents, a constructed one its tag and its children's
+ * hashes. Equal subtrees hash equal wherever they occur, which makes one
+ * compare enough to tell that two Names, keys or extensions are the same.
+ * The hashes are 64-bit and not cryptographic; confirm with memcmp where a
+ * collision would matter.
+ */
+der_error_t der_index_tree(const uint8_t *data, size_t length, uint32_t flags,
+                           der_index_t *index);
+/* The hash der_index_tree gives the one element that spans data. */
+der_error_t der_subtree_hash(const uint8_t *data, size_t length,
+                             uint64_t *hash);
+void der_index_free(der_index_t *index);
+
+/*
+ * Reports how two hashed trees differ. Siblings are matched by hash,
+ * allowing for insertions and removals; a mismatched pair of constructed
+ * elements with the same tag is descended into and any other is reported
+ * as changed. Equal subtrees are never entered, so the work grows with the
+ * differences rather than the size of the trees.
+ */
+der_error_t der_index_diff(const der_index_t *a, const der_index_t *b,
+                           der_diff_fn fn, void *user);
+
+size_t der_index_chunk_count(const der_index_t *index, int threads);
+der_error_t der_index_parallel(const uint8_t *data, const der_index_t *index,
+                               int threads, der_chunk_fn fn, void *user);
+
+der_error_t der_validate_structure_parallel(const uint8_t *data, size_t length,
+                                            int threads);
@@ -0,0 +1,319 @@
+#include "der_mint.h"
+#include <string.h>
+
+static size_t put_header(uint8_t *out, uint8_t tag, size_t length) {
+  out[0] = tag;
+  if (length < 0x80) {
+    out[1] = (uint8_t)length;
+    return 2;
+  }
+  size_t bytes = der_length_size(length) - 1;
+  out[1] = 0x80 | (uint8_t)bytes;
+  for (size_t i = bytes; i > 0; i--) {
+    out[1 + i] = (uint8_t)length;
+    length >>= 8;
+  }
+  return 2 + bytes;
+}
+
+static size_t element_size(size_t length) {
+  return 1 + der_length_size(length) + length;
+}
+
+static der_error_t fail(der_mint_t *mint, der_error_t err) {
+  if (mint->error == DER_OK) {
+    mint->error = err;
+  }
+  return mint->error;
+}
+
+static der_error_t add_step(der_mint_t *mint, const der_mint_step_t *step) {
+  if (mint->step_count >= DER_MINT_MAX_STEPS) {
+    return fail(mint, DER_ERROR_OVERFLOW);
+  }
+  mint->steps[mint->step_count++] = *step;
+  return DER_OK;
+}
+
+/* Records pool bytes from offset to pool_len, extending the last run. */
+static der_error_t add_const(der_mint_t *mint, size_t offset) {
+  size_t len = mint->pool_len - offset;
+  if (len == 0) {
+    return DER_OK;
+  }
+  if (mint->step_count > 0) {
+    der_mint_step_t *last = &mint->steps[mint->step_count - 1];
+    if (last->op == DER_MINT_CONST && last->offset + last->len == offset) {
+      last->len += (uint32_t)len;
+      return DER_OK;
+    }
+  }
+  der_mint_step_t step = {DER_MINT_CONST, 0, 0, 0, (uint32_t)offset,
+                          (uint32_t)len};
+  return add_step(mint, &step);
+}
+
+static der_error_t reserve(der_mint_t *mint, size_t len) {
+  if (len > mint->pool_size - mint->pool_len || len > UINT32_MAX) {
+    return fail(mint, DER_ERROR_BUFFER_TOO_SMALL);
+  }
+  return DER_OK;
+}
+
+void der_mint_init(der_mint_t *mint, uint8_t *pool, size_t pool_size) {
+  memset(mint, 0, sizeof(der_mint_t));
+  mint->pool = pool;
+  mint->pool_size = pool ? pool_size : 0;
+}
+
+der_error_t der_mint_raw(der_mint_t *mint, const uint8_t *der, size_t len) {
+  if (!mint) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (mint->error != DER_OK) {
+    return mint->error;
+  }
+  if (!der && len > 0) {
+    return fail(mint, DER_ERROR_NULL_POINTER);
+  }
+  if (reserve(mint, len) != DER_OK) {
+    return mint->error;
+  }
+
+  size_t offset = mint->pool_len;
+  if (len > 0) {
+    memcpy(mint->pool + offset, der, len);
+  }
+  mint->pool_len += len;
+  return add_const(mint, offset);
+}
+
+der_error_t der_mint_element(der_mint_t *mint, uint8_t tag,
+                             const uint8_t *value, size_t len) {
+  if (!mint) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (mint->error != DER_OK) {
+    return mint->error;
+  }
+  if (!value && len > 0) {
+    return fail(mint, DER_ERROR_NULL_POINTER);
+  }
+  if (reserve(mint, element_size(len)) != DER_OK) {
+    return mint->error;
+  }
+
+  size_t offset = mint->pool_len;
+  size_t header = put_header(mint->pool + offset, tag, len);
+  if (len > 0) {
+    memcpy(mint->pool + offset + header, value, len);
+  }
+  mint->pool_len += header + len;
+  return add_const(mint, offset);
+}
+
+der_error_t der_mint_open(der_mint_t *mint, uint8_t tag) {
+  if (!mint) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (mint->error != DER_OK) {
+    return mint->error;
+  }
+  if (mint->depth >= DER_MINT_MAX_DEPTH) {
+    return fail(mint, DER_ERROR_OVERFLOW);
+  }
+
+  mint->open[mint->depth].step = mint->step_count;
+  mint->open[mint->depth].pool = mint->pool_len;
+  mint->open[mint->depth].variable = false;
+  mint->depth++;
+  der_mint_step_t step = {DER_MINT_OPEN, tag, 0, 0, 0, 0};
+  return add_step(mint, &step);
+}
+
+der_error_t der_mint_close(der_mint_t *mint) {
+  if (!mint) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (mint->error != DER_OK) {
+    return mint->error;
+  }
+  if (mint->depth == 0) {
+    return fail(mint, DER_ERROR_INVALID_DATA);
+  }
+
+  mint->depth--;
+  size_t step = mint->open[mint->depth].step;
+  size_t start = mint->open[mint->depth].pool;
+  if (mint->open[mint->depth].variable) {
+    if (mint->depth > 0) {
+      mint->open[mint->depth - 1].variable = true;
+    }
+    der_mint_step_t close = {DER_MINT_CLOSE, 0, 0, 0, 0, 0};
+    return add_step(mint, &close);
+  }
+
+  /*
+   * Nothing inside varies, so the contents are one run at the end of the
+   * pool. Slide them over to make room for the header and keep the whole
+   * element as a single run.
+   */
+  size_t len = mint->pool_len - start;
+  size_t header = element_size(len) - len;
+  if (reserve(mint, header) != DER_OK) {
+    return mint->error;
+  }
+  uint8_t tag = mint->steps[step].tag;
+  memmove(mint->pool + start + header, mint->pool + start, len);
+  put_header(mint->pool + start, tag, len);
+  mint->pool_len += header;
+  mint->step_count = step;
+  return add_const(mint, start);
+}
+
+der_error_t der_mint_slot(der_mint_t *mint, der_mint_kind_t kind, uint8_t tag,
+                          size_t *slot) {
+  if (!mint || !slot) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (mint->error != DER_OK) {
+    return mint->error;
+  }
+  if (mint->slot_count >= DER_MINT_MAX_SLOTS) {
+    return fail(mint, DER_ERROR_OVERFLOW);
+  }
+
+  der_mint_step_t step = {DER_MINT_SLOT, tag, (uint8_t)kind,
+                          (uint8_t)mint->slot_count, 0, 0};
+  if (add_step(mint, &step) != DER_OK) {
+    return mint->error;
+  }
+  if (mint->depth > 0) {
+    mint->open[mint->depth - 1].variable = true;
+  }
+  *slot = mint->slot_count++;
+  return DER_OK;
+}
+
+der_error_t der_mint_finish(der_mint_t *mint) {
+  if (!mint) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (mint->depth != 0) {
+    return fail(mint, DER_ERROR_INVALID_DATA);
+  }
+  return mint->error;
+}
+
+static der_error_t slot_size(const der_mint_step_t *step,
+                             const der_mint_value_t *value, size_t *size) {
+  if (step->kind == DER_MINT_ITEMS) {
+    if (!value->items && value->count > 0) {
+      return DER_ERROR_NULL_POINTER;
+    }
+    *size = 0;
+    for (size_t i = 0; i < value->count; i++) {
+      if (!value->items[i].data && value->items[i].len > 0) {
+        return DER_ERROR_NULL_POINTER;
+      }
+      *size += element_size(value->items[i].len);
+    }
+    return DER_OK;
+  }
+
+  if (!value->data && value->len > 0) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  *size = step->kind == DER_MINT_TLV ? value->len : element_size(value->len);
+  return DER_OK;
+}
+
+der_error_t der_mint_encode(const der_mint_t *mint,
+                            const der_mint_value_t *values, uint8_t *out,
+                            size_t size, size_t *len) {
+  if (!mint || !len || (!values && mint->slot_count > 0)) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (mint->error != DER_OK || mint->depth != 0) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  /* Size every open element from the inside out. */
+  size_t contents[DER_MINT_MAX_STEPS];
+  size_t open[DER_MINT_MAX_DEPTH];
+  size_t total[DER_MINT_MAX_DEPTH + 1];
+  size_t depth = 0;
+  total[0] = 0;
+  for (size_t i = 0; i < mint->step_count; i++) {
+    const der_mint_step_t *step = &mint->steps[i];
+    switch (step->op) {
+    case DER_MINT_CONST:
+      total[depth] += step->len;
+      break;
+    case DER_MINT_SLOT: {
+      size_t slot;
+      der_error_t err = slot_size(step, &values[step->slot], &slot);
+      if (err != DER_OK) {
+        return err;
+      }
+      total[depth] += slot;
+      break;
+    }
+    case DER_MINT_OPEN:
+      open[depth++] = i;
+      total[depth] = 0;
+      break;
+    case DER_MINT_CLOSE:
+      depth--;
+      contents[open[depth]] = total[depth + 1];
+      total[depth] += element_size(total[depth + 1]);
+      break;
+    }
+  }
+
+  *len = total[0];
+  if (!out) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (total[0] > size) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  uint8_t *p = out;
+  for (size_t i = 0; i < mint->step_count; i++) {
+    const der_mint_step_t *step = &mint->steps[i];
+    switch (step->op) {
+    case DER_MINT_CONST:
+      memcpy(p, mint->pool + step->offset, step->len);
+      p += step->len;
+      break;
+    case DER_MINT_OPEN:
+      p += put_header(p, step->tag, contents[i]);
+      break;
+    case DER_MINT_CLOSE:
+      break;
+    case DER_MINT_SLOT: {
+      const der_mint_value_t *value = &values[step->slot];
+      if (step->kind == DER_MINT_ITEMS) {
+        for (size_t n = 0; n < value->count; n++) {
+          p += put_header(p, step->tag, value->items[n].len);
+          if (value->items[n].len > 0) {
+            memcpy(p, value->items[n].data, value->items[n].len);
+            p += value->items[n].len;
+          }
+        }
+        break;
+      }
+      if (step->kind == DER_MINT_VALUE) {
+        p += put_header(p, step->tag, value->len);
+      }
+      if (value->len > 0) {
+        memcpy(p, value->data, value->len);
+        p += value->len;
+      }
+      break;
+    }
+    }
+  }
+  return DER_OK;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "der.h"
+#include "der_template.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define DER_MINT_MAX_STEPS 48
+#define DER_MINT_MAX_DEPTH 8
+#define DER_MINT_MAX_SLOTS 16
+
+/*
+ * Pre-encoded DER with patch points, for structures that are encoded many
+ * times with only a few elements changing. The builder lays out the
+ * structure once: constant elements are encoded into the pool as they are
+ * added, and any constructed element without a slot inside is closed into
+ * one constant run, header included. What is left is a short list of steps:
+ * constant runs, slots, and the headers of the elements that enclose a slot.
+ * der_mint_encode sizes those headers from the slot values, then writes
+ * headers, copies runs and slot values, and touches nothing else.
+ */
+typedef enum {
+  DER_MINT_CONST, /* pool bytes, copied as is */
+  DER_MINT_OPEN,  /* header of a constructed element holding a slot */
+  DER_MINT_CLOSE, /* end of the innermost open element */
+  DER_MINT_SLOT   /* caller's value, see der_mint_kind_t */
+} der_mint_op_t;
+
+typedef enum {
+  DER_MINT_VALUE, /* contents; written as one element of the slot's tag */
+  DER_MINT_TLV,   /* a complete encoding, copied as is */
+  DER_MINT_ITEMS  /* a list of contents, each written as one element */
+} der_mint_kind_t;
+
+typedef struct {
+  uint8_t op;
+  uint8_t tag;
+  uint8_t kind;
+  uint8_t slot;
+  uint32_t offset; /* CONST: into the pool */
+  uint32_t len;
+} der_mint_step_t;
+
+typedef struct {
+  der_mint_step_t steps[DER_MINT_MAX_STEPS];
+  size_t step_count;
+  size_t slot_count;
+  uint8_t *pool;
+  size_t pool_size;
+  size_t pool_len;
+  struct {
+    size_t step; /* index of the OPEN step */
+    size_t pool; /* pool_len when the element was opened */
+    bool variable;
+  } open[DER_MINT_MAX_DEPTH];
+  size_t depth;
+  der_error_t error; /* first builder error, returned by der_mint_finish */
+} der_mint_t;
+
+/* Per-slot value; data and len for VALUE and TLV, items for ITEMS. */
+typedef struct {
+  const uint8_t *data;
+  size_t len;
+  const der_span_t *items;
+  size_t count;
+} der_mint_value_t;
+
+/*
+ * The pool holds the constant bytes and must outlive the mint. Builder
+ * calls after a failure do nothing and return the first error.
+ */
+void der_mint_init(der_mint_t *mint, uint8_t *pool, size_t pool_size);
+/* Adds an already encoded element, or several back to back. */
+der_error_t der_mint_raw(der_mint_t *mint, const uint8_t *der, size_t len);
+/* Adds a constant element from its tag and contents. */
+der_error_t der_mint_element(der_mint_t *mint, uint8_t tag,
+                             const uint8_t *value, size_t len);
+der_error_t der_mint_open(der_mint_t *mint, uint8_t tag);
+der_error_t der_mint_close(der_mint_t *mint);
+/*
+ * Adds a slot and returns its number in *slot; slots are numbered from 0 in
+ * the order they are added. tag is ignored for DER_MINT_TLV.
+ */
+der_error_t der_mint_slot(der_mint_t *mint, der_mint_kind_t kind, uint8_t tag,
+                          size_t *slot);
+/* Checks that every element was closed; returns the first builder error. */
+der_error_t der_mint_finish(der_mint_t *mint);
+
+/*
+ * Writes the structure with values[i] in slot i. The output is only
+ * written once it is known to fit; *len is set either way, so a too-small
+ * out reports the size needed.
+ */
+der_error_t der_mint_encode(const der_mint_t *mint,
+                            const der_mint_value_t *values, uint8_t *out,
+                            size_t size, size_t *len);
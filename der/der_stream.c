@@ -0,0 +1,135 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "der_stream.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+der_error_t der_stream_init(der_stream_t *stream, int fd, size_t chunk_size) {
+  if (!stream || fd < 0) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  memset(stream, 0, sizeof(der_stream_t));
+  stream->fd = fd;
+  stream->capacity = chunk_size > 0 ? chunk_size : DER_STREAM_CHUNK_SIZE;
+  stream->buffer = malloc(stream->capacity);
+  if (!stream->buffer) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  return DER_OK;
+}
+
+void der_stream_free(der_stream_t *stream) {
+  if (!stream) {
+    return;
+  }
+
+  free(stream->buffer);
+  memset(stream, 0, sizeof(der_stream_t));
+  stream->fd = -1;
+}
+
+static der_error_t stream_fill(der_stream_t *stream, size_t needed) {
+  size_t pending = stream->end - stream->start;
+
+  if (needed > stream->capacity) {
+    if (needed > DER_STREAM_MAX_RECORD) {
+      return DER_ERROR_OVERFLOW;
+    }
+    uint8_t *grown = malloc(needed);
+    if (!grown) {
+      return DER_ERROR_BUFFER_TOO_SMALL;
+    }
+    memcpy(grown, &stream->buffer[stream->start], pending);
+    free(stream->buffer);
+    stream->buffer = grown;
+    stream->capacity = needed;
+    stream->start = 0;
+    stream->end = pending;
+  } else if (stream->start + needed > stream->capacity) {
+    memmove(stream->buffer, &stream->buffer[stream->start], pending);
+    stream->start = 0;
+    stream->end = pending;
+  }
+
+  while (stream->end - stream->start < needed && !stream->eof) {
+    ssize_t n = read(stream->fd, &stream->buffer[stream->end],
+                     stream->capacity - stream->end);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return DER_ERROR_INVALID_DATA;
+    }
+    if (n == 0) {
+      stream->eof = true;
+    }
+    stream->end += (size_t)n;
+  }
+
+  return stream->end - stream->start >= needed ? DER_OK
+                                               : DER_ERROR_BUFFER_TOO_SMALL;
+}
+
+static der_error_t stream_header(der_stream_t *stream, size_t *record_len) {
+  der_ctx_t ctx;
+  der_init(&ctx, &stream->buffer[stream->start], stream->end - stream->start);
+
+  uint8_t tag;
+  der_error_t err = der_decode_tag(&ctx, &tag);
+  if (err == DER_OK) {
+    size_t length;
+    err = der_decode_length(&ctx, &length);
+    if (err == DER_OK) {
+      if (length > DER_STREAM_MAX_RECORD - ctx.pos) {
+        return DER_ERROR_OVERFLOW;
+      }
+      *record_len = ctx.pos + length;
+    }
+  }
+
+  return err;
+}
+
+der_error_t der_stream_next(der_stream_t *stream, const uint8_t **record,
+                            size_t *record_len, uint64_t *record_offset) {
+  if (!stream || !stream->buffer || !record || !record_len) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  *record = NULL;
+  *record_len = 0;
+
+  /* A tag plus the longest length form DER_STREAM_MAX_RECORD can need. */
+  der_error_t err = stream_fill(stream, 2 + sizeof(size_t));
+  if (stream->start == stream->end) {
+    return err == DER_ERROR_BUFFER_TOO_SMALL ? DER_OK : err;
+  }
+  if (err != DER_OK && err != DER_ERROR_BUFFER_TOO_SMALL) {
+    return err;
+  }
+
+  size_t length;
+  err = stream_header(stream, &length);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  err = stream_fill(stream, length);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  *record = &stream->buffer[stream->start];
+  *record_len = length;
+  if (record_offset) {
+    *record_offset = stream->offset;
+  }
+  stream->start += length;
+  stream->offset += length;
+
+  return DER_OK;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "der.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DER_STREAM_CHUNK_SIZE (1024 * 1024)
+#define DER_STREAM_MAX_RECORD (64 * 1024 * 1024)
+
+/*
+ * Reads concatenated DER records from a file descriptor in fixed-size
+ * chunks. Memory stays bounded by the chunk size, or by the largest
+ * record when a record is bigger than a chunk. Only the partial record
+ * at the end of a chunk is copied.
+ */
+typedef struct {
+  int fd;
+  uint8_t *buffer;
+  size_t capacity;
+  size_t start;
+  size_t end;
+  uint64_t offset;
+  bool eof;
+} der_stream_t;
+
+der_error_t der_stream_init(der_stream_t *stream, int fd, size_t chunk_size);
+void der_stream_free(der_stream_t *stream);
+
+/*
+ * Yields the next complete TLV record. The span stays valid until the next
+ * call. At a clean end of stream, *record is NULL. A truncated final record
+ * returns DER_ERROR_BUFFER_TOO_SMALL.
+ */
+der_error_t der_stream_next(der_stream_t *stream, const uint8_t **record,
+                            size_t *record_len, uint64_t *record_offset);
@@ -0,0 +1,207 @@
+#include "der_template.h"
+#include "../util/stats.h"
+
+typedef struct {
+  const der_template_t *tmpl;
+  size_t next;
+  size_t end;
+  uint32_t field;
+} template_frame_t;
+
+/*
+ * der_decode_tlv on data[*pos..end) with the common header forms decoded in
+ * line, so pos can stay in a register. Long lengths of three or more bytes
+ * and every error case go through der_decode_tlv.
+ */
+static inline der_error_t template_tlv(const uint8_t *data, size_t *pos,
+                                       size_t end, der_tlv_t *tlv) {
+  const uint8_t *p = &data[*pos];
+  size_t avail = end - *pos;
+  size_t header;
+
+  if (avail >= 2 && p[1] < 0x80) {
+    tlv->length = p[1];
+    header = 2;
+  } else if (avail >= 3 && p[1] == 0x81 && p[2] >= 0x80) {
+    tlv->length = p[2];
+    header = 3;
+  } else if (avail >= 4 && p[1] == 0x82 && p[2] != 0) {
+    tlv->length = ((size_t)p[2] << 8) | p[3];
+    header = 4;
+  } else {
+    der_ctx_t ctx = {(uint8_t *)data, end, *pos};
+    der_error_t err = der_decode_tlv(&ctx, tlv);
+    *pos = ctx.pos;
+    return err;
+  }
+
+  if (avail - header < tlv->length) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+  tlv->tag = p[0];
+  tlv->value = p + header;
+  *pos += header + tlv->length;
+  STATS_ADD(STATS_TLVS_DECODED, 1);
+  return DER_OK;
+}
+
+/* The alternative of a CHOICE that tag selects, or NULL. */
+static inline const der_template_t *
+template_choose(const der_template_t *choice, uint8_t tag) {
+  for (const der_template_t *alt = choice->children; alt->kind != DER_TMPL_END;
+       alt++) {
+    if (alt->tag == 0 || alt->tag == tag) {
+      return alt;
+    }
+  }
+  return NULL;
+}
+
+static inline der_error_t template_store(const der_template_t *entry,
+                                         const uint8_t *start,
+                                         const der_tlv_t *tlv, void *target) {
+  switch (entry->store) {
+  case DER_STORE_TLV: {
+    der_span_t *span = target;
+    span->data = start;
+    span->len = (size_t)(tlv->value - start) + tlv->length;
+    return DER_OK;
+  }
+
+  case DER_STORE_VALUE: {
+    der_span_t *span = target;
+    span->data = tlv->value;
+    span->len = tlv->length;
+    return DER_OK;
+  }
+
+  case DER_STORE_UINT32: {
+    der_ctx_t ctx = {(uint8_t *)start,
+                     (size_t)(tlv->value - start) + tlv->length, 0};
+    return der_decode_integer_uint32(&ctx, target);
+  }
+
+  case DER_STORE_CONVERT:
+    return entry->convert(tlv, target);
+
+  default:
+    return DER_OK;
+  }
+}
+
+static der_error_t template_store_items(const der_template_t *entry,
+                                        const der_tlv_t *list, uint8_t *out) {
+  der_span_t *items = (der_span_t *)(out + entry->offset);
+  size_t *count = (size_t *)(out + entry->count_offset);
+
+  size_t pos = 0;
+  while (pos < list->length) {
+    size_t start = pos;
+    der_tlv_t item;
+    der_error_t err = template_tlv(list->value, &pos, list->length, &item);
+    if (err != DER_OK) {
+      return err;
+    }
+    if ((entry->item_tag == 0 || item.tag == entry->item_tag) &&
+        *count < entry->max) {
+      template_store(entry, &list->value[start], &item, &items[*count]);
+      (*count)++;
+    }
+  }
+  return DER_OK;
+}
+
+der_error_t der_template_decode(const der_template_t *tmpl,
+                                const uint8_t *data, size_t length,
+                                uint32_t fields, void *out) {
+  if (!tmpl || !data || !out) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  template_frame_t stack[DER_TEMPLATE_MAX_DEPTH];
+  size_t depth = 0;
+  stack[0].field = 0;
+
+  size_t pos = 0;
+  size_t end = length;
+  uint32_t pending = fields;
+  size_t i = 0;
+
+  for (;;) {
+    const der_template_t *entry = &tmpl[i];
+    uint32_t done;
+
+    if (entry->kind == DER_TMPL_END) {
+      if (depth == 0) {
+        return DER_OK;
+      }
+      done = stack[depth].field;
+      tmpl = stack[depth].tmpl;
+      i = stack[depth].next;
+      pos = end;
+      end = stack[--depth].end;
+    } else {
+      size_t start = pos;
+      der_tlv_t tlv;
+      der_error_t err = pos < end ? template_tlv(data, &pos, end, &tlv)
+                                  : DER_ERROR_BUFFER_TOO_SMALL;
+      const der_template_t *match = NULL;
+      if (err == DER_OK) {
+        if (entry->kind == DER_TMPL_CHOICE) {
+          match = template_choose(entry, tlv.tag);
+        } else if (entry->tag == 0 || entry->tag == tlv.tag) {
+          match = entry;
+        }
+      }
+
+      i++;
+      if (!match && (entry->flags & DER_TMPL_OPTIONAL)) {
+        pos = start;
+        continue;
+      }
+      if (err != DER_OK) {
+        return err;
+      }
+      if (entry->field && !(entry->field & pending)) {
+        STATS_ADD(STATS_BYTES_SKIPPED, pos - start);
+        continue;
+      }
+      if (!match) {
+        return DER_ERROR_INVALID_TAG;
+      }
+
+      done = entry->field;
+      if (match->kind == DER_TMPL_SEQUENCE_OF) {
+        err = template_store_items(match, &tlv, out);
+      } else if (match->store != DER_STORE_NONE) {
+        err = template_store(match, &data[start], &tlv,
+                             (uint8_t *)out + match->offset);
+      }
+      if (err != DER_OK) {
+        return err;
+      }
+
+      if (match->kind == DER_TMPL_CONSTRUCTED) {
+        if (depth + 1 >= DER_TEMPLATE_MAX_DEPTH) {
+          return DER_ERROR_OVERFLOW;
+        }
+        stack[depth].end = end;
+        depth++;
+        stack[depth].tmpl = tmpl;
+        stack[depth].next = i;
+        stack[depth].field = entry->field;
+        tmpl = match->children;
+        i = 0;
+        end = pos;
+        pos = (size_t)(tlv.value - data);
+        continue;
+      }
+    }
+
+    /* Bits shared with the enclosing entry are cleared when it closes. */
+    pending &= ~(done & ~stack[depth].field);
+    if (!pending) {
+      return DER_OK;
+    }
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "der.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define DER_TEMPLATE_MAX_DEPTH 8
+
+typedef struct {
+  const uint8_t *data;
+  size_t len;
+} der_span_t;
+
+typedef enum {
+  DER_TMPL_ELEMENT,     /* one element, stored or hopped over */
+  DER_TMPL_CONSTRUCTED, /* SEQUENCE, SET or EXPLICIT [n]; see children */
+  DER_TMPL_CHOICE,      /* children lists the alternatives */
+  DER_TMPL_SEQUENCE_OF, /* SEQUENCE OF or SET OF, stored into a span array */
+  DER_TMPL_END          /* ends a table */
+} der_template_kind_t;
+
+typedef enum {
+  DER_STORE_NONE,
+  DER_STORE_TLV,     /* der_span_t over the whole encoding */
+  DER_STORE_VALUE,   /* der_span_t over the contents */
+  DER_STORE_UINT32,  /* uint32_t from a non-negative INTEGER */
+  DER_STORE_CONVERT  /* the entry's convert function writes the target */
+} der_store_t;
+
+#define DER_TMPL_OPTIONAL 0x01
+
+typedef der_error_t (*der_template_convert_fn)(const der_tlv_t *tlv,
+                                               void *out);
+
+/*
+ * One row of a static decoding table; each table ends with DER_TEMPLATE_END.
+ * Offsets are into the result struct passed to der_template_decode. A tag
+ * of 0 matches any element. CONSTRUCTED and CHOICE rows point at a table of
+ * their own, so a row is hopped over without looking at its children.
+ *
+ * field holds selection bits. Entries whose bits are not requested are
+ * hopped over by their header without any tag check, and decoding stops as
+ * soon as every requested bit has been filled. A bit counts as filled when
+ * the outermost entry carrying it completes, so children may share their
+ * parent's bits but siblings need their own. Entries with field 0 are
+ * structure and are always decoded.
+ *
+ * SEQUENCE_OF stores one span per item whose tag matches item_tag (0 keeps
+ * all), up to max, and adds the count to the size_t at count_offset.
+ */
+typedef struct der_template {
+  uint8_t kind;
+  uint8_t tag;
+  uint8_t flags;
+  uint8_t store;
+  uint32_t field;
+  uint16_t offset;
+  uint16_t count_offset;
+  uint16_t max;
+  uint8_t item_tag;
+  const struct der_template *children;
+  der_template_convert_fn convert;
+} der_template_t;
+
+#define DER_TEMPLATE_END {.kind = DER_TMPL_END}
+/* Selects every entry; for templates that are pure structure. */
+#define DER_TEMPLATE_ALL 0xFFFFFFFFu
+
+/*
+ * Decodes data against tmpl. Elements after the last row of a constructed
+ * level are ignored, as they are for extensible ASN.1 types. Fields that are
+ * not reached are left as they were.
+ */
+der_error_t der_template_decode(const der_template_t *tmpl,
+                                const uint8_t *data, size_t length,
+                                uint32_t fields, void *out);
@@ -1,7 +1,8 @@
 #include "der_utils.h"
-#include <stdio.h>
+#include "der_walk.h"
 #include <string.h>
 
+#ifndef QCERT_NO_STDIO
 void der_print_hex(const uint8_t *data, size_t length) {
   for (size_t i = 0; i < length; i++) {
     printf("%02X", data[i]);
@@ -11,6 +12,7 @@ void der_print_hex(const uint8_t *data, size_t length) {
   }
   printf("\n");
 }
+#endif
 
 const char *der_tag_to_string(uint8_t tag) {
   switch (tag) {
@@ -71,126 +73,148 @@ const char *der_error_to_string(der_error_t error) {
   }
 }
 
-der_error_t der_print_structure(const uint8_t *data, size_t length,
-                                int indent_level) {
-  if (!data || length == 0) {
-    return DER_ERROR_NULL_POINTER;
+#ifndef QCERT_NO_STDIO
+typedef struct {
+  int indent_level;
+  size_t depth;
+} der_print_state_t;
+
+static void print_indent(int count) {
+  for (int i = 0; i < count; i++) {
+    printf("  ");
   }
+}
 
-  der_ctx_t ctx;
-  der_init(&ctx, (uint8_t *)data, length);
+static void print_header(const der_walk_node_t *node,
+                         const der_print_state_t *state) {
+  print_indent(state->indent_level + (int)node->depth);
+  printf("%s (tag 0x%02X) [%zu bytes]: ", der_tag_to_string(node->tag),
+         node->tag, node->length);
+}
 
-  while (der_get_remaining(&ctx) > 0) {
+static der_walk_action_t print_enter(const der_walk_node_t *node,
+                                     void *user) {
+  der_print_state_t *state = user;
+  print_header(node, state);
+  printf("\n");
+  state->depth = node->depth + 1;
+  return DER_WALK_CONTINUE;
+}
 
-    for (int i = 0; i < indent_level; i++) {
-      printf("  ");
-    }
+static der_walk_action_t print_leave(const der_walk_node_t *node,
+                                     void *user) {
+  der_print_state_t *state = user;
+  state->depth = node->depth;
+  return DER_WALK_CONTINUE;
+}
+
+static der_walk_action_t print_primitive(const der_walk_node_t *node,
+                                         void *user) {
+  print_header(node, user);
 
-    der_tlv_t tlv;
-    der_error_t err = der_decode_tlv(&ctx, &tlv);
-    if (err != DER_OK) {
-      printf("Error parsing TLV: %s\n", der_error_to_string(err));
-      return err;
+  switch (node->tag) {
+  case DER_TAG_BOOLEAN:
+    if (node->length == 1) {
+      printf("%s\n", node->value[0] ? "TRUE" : "FALSE");
+    } else {
+      printf("Invalid BOOLEAN length\n");
     }
+    break;
 
-    printf("%s (tag 0x%02X) [%zu bytes]: ", der_tag_to_string(tlv.tag), tlv.tag,
-           tlv.length);
+  case DER_TAG_INTEGER:
+    if (node->length <= 4) {
+      uint32_t value = 0;
+      for (size_t i = 0; i < node->length; i++) {
+        value = (value << 8) | node->value[i];
+      }
+      printf("%u (0x", value);
+      for (size_t i = 0; i < node->length; i++) {
+        printf("%02X", node->value[i]);
+      }
+      printf(")\n");
+    } else {
+      printf("0x");
+      for (size_t i = 0; i < node->length; i++) {
+        printf("%02X", node->value[i]);
+      }
+      printf("\n");
+    }
+    break;
 
-    if (der_is_constructed(tlv.tag)) {
+  case DER_TAG_OCTET_STRING:
+    printf("0x");
+    for (size_t i = 0; i < node->length; i++) {
+      printf("%02X", node->value[i]);
+    }
+    printf("\n");
+    break;
 
-      printf("\n");
-      err = der_print_structure(tlv.value, tlv.length, indent_level + 1);
-      if (err != DER_OK) {
-        return err;
+  case DER_TAG_NULL:
+    printf("NULL\n");
+    break;
+
+  case DER_TAG_OID: {
+    der_ctx_t oid_ctx;
+    der_init(&oid_ctx, (uint8_t *)node->value, node->length);
+    uint32_t oid[QCERT_MAX_OID_ARCS];
+    size_t oid_len;
+    if (der_decode_oid(&oid_ctx, oid, &oid_len, QCERT_MAX_OID_ARCS) == DER_OK) {
+      for (size_t i = 0; i < oid_len; i++) {
+        printf("%u", oid[i]);
+        if (i < oid_len - 1)
+          printf(".");
       }
+      printf("\n");
     } else {
+      printf("Invalid OID\n");
+    }
+  } break;
 
-      switch (tlv.tag) {
-      case DER_TAG_BOOLEAN:
-        if (tlv.length == 1) {
-          printf("%s\n", tlv.value[0] ? "TRUE" : "FALSE");
-        } else {
-          printf("Invalid BOOLEAN length\n");
-        }
-        break;
-
-      case DER_TAG_INTEGER:
-        if (tlv.length <= 4) {
-          uint32_t value = 0;
-          for (size_t i = 0; i < tlv.length; i++) {
-            value = (value << 8) | tlv.value[i];
-          }
-          printf("%u (0x", value);
-          for (size_t i = 0; i < tlv.length; i++) {
-            printf("%02X", tlv.value[i]);
-          }
-          printf(")\n");
-        } else {
-          printf("0x");
-          for (size_t i = 0; i < tlv.length; i++) {
-            printf("%02X", tlv.value[i]);
-          }
-          printf("\n");
-        }
-        break;
-
-      case DER_TAG_OCTET_STRING:
-        printf("0x");
-        for (size_t i = 0; i < tlv.length; i++) {
-          printf("%02X", tlv.value[i]);
-        }
-        printf("\n");
-        break;
-
-      case DER_TAG_NULL:
-        printf("NULL\n");
-        break;
-
-      case DER_TAG_OID: {
-        der_ctx_t oid_ctx;
-        der_init(&oid_ctx, (uint8_t *)tlv.value, tlv.length);
-        uint32_t oid[20];
-        size_t oid_len;
-        if (der_decode_oid(&oid_ctx, oid, &oid_len, 20) == DER_OK) {
-          for (size_t i = 0; i < oid_len; i++) {
-            printf("%u", oid[i]);
-            if (i < oid_len - 1)
-              printf(".");
-          }
-          printf("\n");
-        } else {
-          printf("Invalid OID\n");
-        }
-      } break;
-
-      case DER_TAG_UTF8_STRING:
-      case DER_TAG_PRINTABLE_STRING:
-      case DER_TAG_IA5_STRING:
-        printf("\"");
-        for (size_t i = 0; i < tlv.length; i++) {
-          if (tlv.value[i] >= 32 && tlv.value[i] <= 126) {
-            printf("%c", tlv.value[i]);
-          } else {
-            printf("\\x%02X", tlv.value[i]);
-          }
-        }
-        printf("\"\n");
-        break;
-
-      default:
-        printf("0x");
-        for (size_t i = 0; i < tlv.length; i++) {
-          printf("%02X", tlv.value[i]);
-        }
-        printf("\n");
-        break;
+  case DER_TAG_UTF8_STRING:
+  case DER_TAG_PRINTABLE_STRING:
+  case DER_TAG_IA5_STRING:
+    printf("\"");
+    for (size_t i = 0; i < node->length; i++) {
+      if (node->value[i] >= 32 && node->value[i] <= 126) {
+        printf("%c", node->value[i]);
+      } else {
+        printf("\\x%02X", node->value[i]);
       }
     }
+    printf("\"\n");
+    break;
+
+  default:
+    printf("0x");
+    for (size_t i = 0; i < node->length; i++) {
+      printf("%02X", node->value[i]);
+    }
+    printf("\n");
+    break;
   }
 
-  return DER_OK;
+  return DER_WALK_CONTINUE;
 }
 
+der_error_t der_print_structure(const uint8_t *data, size_t length,
+                                int indent_level) {
+  if (!data || length == 0) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  der_print_state_t state = {indent_level, 0};
+  der_walk_callbacks_t callbacks = {print_enter, print_primitive, print_leave};
+
+  der_error_t err = der_walk(data, length, &callbacks, &state);
+  if (err != DER_OK) {
+    print_indent(state.indent_level + (int)state.depth);
+    printf("Error parsing TLV: %s\n", der_error_to_string(err));
+  }
+
+  return err;
+}
+#endif
+
 size_t der_calculate_sequence_size(size_t content_length) {
   return 1 + der_length_size(content_length) + content_length;
 }
@@ -235,36 +259,23 @@ der_error_t der_encode_sequence_complete(der_ctx_t *ctx, const uint8_t *content,
   return DER_OK;
 }
 
+static der_walk_action_t validate_node(const der_walk_node_t *node,
+                                       void *user) {
+  if (node->header_len != 1 + der_length_size(node->length)) {
+    *(der_error_t *)user = DER_ERROR_INVALID_DATA;
+    return DER_WALK_STOP;
+  }
+  return DER_WALK_CONTINUE;
+}
+
 der_error_t der_validate_structure(const uint8_t *data, size_t length) {
   if (!data || length == 0) {
     return DER_ERROR_NULL_POINTER;
   }
 
-  der_ctx_t ctx;
-  der_init(&ctx, (uint8_t *)data, length);
-
-  while (der_get_remaining(&ctx) > 0) {
-    size_t start_pos = ctx.pos;
-
-    der_tlv_t tlv;
-    der_error_t err = der_decode_tlv(&ctx, &tlv);
-    if (err != DER_OK) {
-      return err;
-    }
-
-    size_t expected_pos =
-        start_pos + 1 + der_length_size(tlv.length) + tlv.length;
-    if (ctx.pos != expected_pos) {
-      return DER_ERROR_INVALID_DATA;
-    }
+  der_error_t result = DER_OK;
+  der_walk_callbacks_t callbacks = {validate_node, validate_node, NULL};
 
-    if (der_is_constructed(tlv.tag)) {
-      err = der_validate_structure(tlv.value, tlv.length);
-      if (err != DER_OK) {
-        return err;
-      }
-    }
-  }
-
-  return DER_OK;
+  der_error_t err = der_walk(data, length, &callbacks, &result);
+  return err != DER_OK ? err : result;
 }
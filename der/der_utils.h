@@ -1,12 +1,14 @@
 #pragma once
 
 #include "der.h"
+#ifndef QCERT_NO_STDIO
 #include <stdio.h>
 
 void der_print_hex(const uint8_t *data, size_t length);
 
 der_error_t der_print_structure(const uint8_t *data, size_t length,
                                 int indent_level);
+#endif
 
 const char *der_tag_to_string(uint8_t tag);
 
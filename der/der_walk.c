@@ -0,0 +1,80 @@
+#include "der_walk.h"
+#include "../util/stats.h"
+
+der_error_t der_walk(const uint8_t *data, size_t length,
+                     const der_walk_callbacks_t *callbacks, void *user) {
+  if (!data || !callbacks) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  der_walk_node_t stack[DER_WALK_MAX_DEPTH];
+  size_t depth = 0;
+  size_t end = length;
+
+  der_ctx_t ctx;
+  der_init(&ctx, (uint8_t *)data, length);
+
+  for (;;) {
+    while (ctx.pos == end && depth > 0) {
+      der_walk_node_t *node = &stack[--depth];
+      end = depth > 0 ? stack[depth - 1].offset + stack[depth - 1].header_len +
+                            stack[depth - 1].length
+                      : length;
+      if (callbacks->on_leave &&
+          callbacks->on_leave(node, user) == DER_WALK_STOP) {
+        return DER_OK;
+      }
+    }
+    if (ctx.pos == end) {
+      return DER_OK;
+    }
+
+    /* Bound decoding by the enclosing element, not the whole buffer. */
+    ctx.size = end;
+
+    der_walk_node_t node;
+    node.depth = depth;
+    node.offset = ctx.pos;
+
+    der_error_t err = der_decode_tag(&ctx, &node.tag);
+    if (err == DER_OK) {
+      err = der_decode_length(&ctx, &node.length);
+    }
+    if (err == DER_OK && der_get_remaining(&ctx) < node.length) {
+      err = DER_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (err != DER_OK) {
+      return err;
+    }
+
+    node.header_len = ctx.pos - node.offset;
+    node.value = &data[ctx.pos];
+    STATS_ADD(STATS_TLVS_DECODED, 1);
+
+    der_walk_action_t action = DER_WALK_CONTINUE;
+    if (der_is_constructed(node.tag)) {
+      /* Checked first, so on_enter never sees a depth it cannot index by. */
+      if (depth == DER_WALK_MAX_DEPTH) {
+        return DER_ERROR_OVERFLOW;
+      }
+      if (callbacks->on_enter) {
+        action = callbacks->on_enter(&node, user);
+      }
+      if (action == DER_WALK_CONTINUE) {
+        stack[depth++] = node;
+        end = ctx.pos + node.length;
+        continue;
+      }
+      if (action == DER_WALK_SKIP) {
+        STATS_ADD(STATS_BYTES_SKIPPED, node.length);
+      }
+    } else if (callbacks->on_primitive) {
+      action = callbacks->on_primitive(&node, user);
+    }
+
+    if (action == DER_WALK_STOP) {
+      return DER_OK;
+    }
+    ctx.pos += node.length;
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "der.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define DER_WALK_MAX_DEPTH QCERT_MAX_DEPTH
+
+typedef enum {
+  DER_WALK_CONTINUE,
+  DER_WALK_SKIP,
+  DER_WALK_STOP
+} der_walk_action_t;
+
+typedef struct {
+  size_t depth;
+  uint8_t tag;
+  size_t offset;
+  size_t header_len;
+  const uint8_t *value;
+  size_t length;
+} der_walk_node_t;
+
+/*
+ * Any callback may be NULL. Returning DER_WALK_SKIP from on_enter jumps past
+ * the element's content without visiting it, and on_leave is not called for
+ * it. DER_WALK_STOP ends the walk with DER_OK.
+ *
+ * A constructed element nested DER_WALK_MAX_DEPTH deep fails the walk with
+ * DER_ERROR_OVERFLOW before on_enter is called, so on_enter and on_leave
+ * see depth < DER_WALK_MAX_DEPTH. Primitives inside the deepest element
+ * have depth == DER_WALK_MAX_DEPTH.
+ */
+typedef struct {
+  der_walk_action_t (*on_enter)(const der_walk_node_t *node, void *user);
+  der_walk_action_t (*on_primitive)(const der_walk_node_t *node, void *user);
+  der_walk_action_t (*on_leave)(const der_walk_node_t *node, void *user);
+} der_walk_callbacks_t;
+
+der_error_t der_walk(const uint8_t *data, size_t length,
+                     const der_walk_callbacks_t *callbacks, void *user);
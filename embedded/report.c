@@ -0,0 +1,143 @@
+/*
+ * Host-side memory report for the embedded profile. Links against
+ * libqcert_embedded.a, which has no stdio or malloc; only this harness
+ * reads the input file. Everything the parser touches lives in the static
+ * buffers below, and peak stack is measured by painting a region of the
+ * stack before running the parse and counting what was overwritten.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../b64/b64.h"
+#include "../der/der.h"
+#include "../der/der_utils.h"
+#include "../util/arena.h"
+#include "../util/sha256.h"
+#include "../util/util.h"
+#include "../x509/x509.h"
+
+#define REPORT_STACK_REGION 32768
+#define REPORT_PAINT 0xA5
+#define REPORT_POOL_SIZE (QCERT_MAX_DER_SIZE + 512)
+
+static uint8_t pool[REPORT_POOL_SIZE];
+static char input[QCERT_MAX_DER_SIZE * 2];
+static x509_cert_t cert;
+static char common_name[QCERT_MAX_NAME_VALUE];
+static uint8_t digest[SHA256_DIGEST_SIZE];
+
+static const uint8_t *der_data;
+static size_t der_len;
+static der_error_t parse_result;
+
+static __attribute__((noinline)) void paint_stack(void) {
+  volatile uint8_t region[REPORT_STACK_REGION];
+  for (size_t i = 0; i < sizeof(region); i++) {
+    region[i] = REPORT_PAINT;
+  }
+}
+
+/* Reads back what paint_stack left; the region is deliberately not set. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+static __attribute__((noinline)) size_t scan_stack(void) {
+  volatile uint8_t region[REPORT_STACK_REGION];
+  size_t untouched = 0;
+  while (untouched < sizeof(region) && region[untouched] == REPORT_PAINT) {
+    untouched++;
+  }
+  return sizeof(region) - untouched;
+}
+#pragma GCC diagnostic pop
+
+/* The work a device does per certificate: check, extract, name, hash. */
+static __attribute__((noinline)) void parse_once(void) {
+  parse_result = der_validate_structure(der_data, der_len);
+  if (parse_result != DER_OK) {
+    return;
+  }
+  parse_result = x509_extract(der_data, der_len, &cert);
+  if (parse_result != DER_OK) {
+    return;
+  }
+  x509_name_attribute(cert.subject, X509_ATTR_CN, common_name,
+                      sizeof(common_name));
+  sha256(cert.tbs.data, cert.tbs.len, digest);
+}
+
+static size_t load_certificate(arena_t *arena, size_t input_len) {
+  const char *begin = strstr(input, "-----BEGIN");
+  if (!begin) {
+    uint8_t *out = arena_alloc(arena, input_len);
+    if (!out) {
+      return 0;
+    }
+    memcpy(out, input, input_len);
+    der_data = out;
+    return input_len;
+  }
+
+  begin = strchr(begin, '\n');
+  const char *end = begin ? strstr(begin, "-----END") : NULL;
+  if (!end) {
+    return 0;
+  }
+  uint8_t *out = arena_alloc(arena, QCERT_MAX_DER_SIZE);
+  if (!out) {
+    return 0;
+  }
+  int len = base64_decode_n(begin + 1, (size_t)(end - begin - 1), out,
+                            QCERT_MAX_DER_SIZE);
+  der_data = out;
+  return len > 0 ? (size_t)len : 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <certificate.pem|der>\n", argv[0]);
+    return 1;
+  }
+
+  FILE *file = fopen(argv[1], "rb");
+  if (!file) {
+    perror(argv[1]);
+    return 1;
+  }
+  size_t input_len = fread(input, 1, sizeof(input) - 1, file);
+  fclose(file);
+
+  arena_t arena;
+  if (!arena_init_buffer(&arena, pool, sizeof(pool))) {
+    fprintf(stderr, "Error: pool too small\n");
+    return 1;
+  }
+  der_len = load_certificate(&arena, input_len);
+  if (der_len == 0) {
+    fprintf(stderr, "Error: %s is not a certificate within %d bytes\n",
+            argv[1], QCERT_MAX_DER_SIZE);
+    return 1;
+  }
+
+  paint_stack();
+  parse_once();
+  size_t stack_used = scan_stack();
+
+  if (parse_result != DER_OK) {
+    fprintf(stderr, "Error: %s\n", der_error_to_string(parse_result));
+    return 1;
+  }
+
+  printf("certificate:      %zu bytes, CN=%s\n", der_len, common_name);
+  printf("static RAM:\n");
+  printf("  arena pool:     %zu bytes (%llu used)\n", sizeof(pool),
+         (unsigned long long)arena.stats.bytes);
+  printf("  x509_cert_t:    %zu bytes\n", sizeof(cert));
+  printf("  name buffer:    %zu bytes\n", sizeof(common_name));
+  printf("  digest:         %zu bytes\n", sizeof(digest));
+  printf("  total:          %zu bytes\n",
+         sizeof(pool) + sizeof(cert) + sizeof(common_name) + sizeof(digest));
+  printf("peak stack:       %zu bytes (validate, extract, name, sha256)\n",
+         stack_used);
+  return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Parses files of concatenated DER certificates, one thread per file, with
+ * the C++ layer: nothing is copied out of the mappings but the CN text.
+ * Usage: lib/example FILE...
+ */
+#include "qcert.hpp"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct summary {
+  std::string path;
+  der_error_t error = DER_OK;
+  std::size_t certs = 0;
+  std::size_t sans = 0;
+  std::string first_subject;
+};
+
+void scan(summary &out) {
+  qcert::file file;
+  out.error = qcert::file::map(out.path.c_str(), file);
+  if (out.error != DER_OK) {
+    return;
+  }
+
+  qcert::children certs = file.elements();
+  for (const qcert::element &element : certs) {
+    qcert::certificate cert;
+    if (qcert::certificate::parse(element.encoding(), cert) != DER_OK) {
+      continue;
+    }
+    if (out.certs++ == 0) {
+      char cn[QCERT_MAX_NAME_VALUE];
+      out.first_subject = qcert::name_attribute(cert.subject(), X509_ATTR_CN, cn);
+    }
+    out.sans += cert.san_count();
+  }
+  out.error = certs.error();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::fprintf(stderr, "Usage: %s FILE...\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<summary> results(static_cast<std::size_t>(argc - 1));
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < results.size(); i++) {
+    results[i].path = argv[i + 1];
+    threads.emplace_back(scan, std::ref(results[i]));
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  int status = 0;
+  for (const summary &result : results) {
+    std::printf("%s: %zu certificates, %zu SANs, first CN \"%s\"%s%s\n",
+                result.path.c_str(), result.certs, result.sans,
+                result.first_subject.c_str(),
+                result.error != DER_OK ? ", stopped: " : "",
+                result.error != DER_OK ? der_error_to_string(result.error)
+                                       : "");
+    status |= result.error != DER_OK;
+  }
+  return status;
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+/*
+ * Header-only C++20 layer over libqcert. Everything here views the caller's
+ * bytes: spans and string_views point into the buffer or mapping that was
+ * parsed, so they are valid as long as it is. Errors are the library's
+ * der_error_t codes; nothing throws. Build against the library profile
+ * (make lib), which keeps no global state, so any thread may parse.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <utility>
+
+extern "C" {
+#include "../der/der.h"
+#include "../der/der_file.h"
+#include "../der/der_utils.h"
+#include "../x509/x509.h"
+}
+
+namespace qcert {
+
+using bytes = std::span<const std::uint8_t>;
+
+inline bytes view(der_span_t span) { return {span.data, span.len}; }
+
+inline std::string_view text(der_span_t span) {
+  return {reinterpret_cast<const char *>(span.data), span.len};
+}
+
+class children;
+
+/* One decoded element: its tag, whole encoding and contents. */
+class element {
+public:
+  element() = default;
+
+  /* Decodes the element at the start of data. */
+  static der_error_t decode(bytes data, element &out) {
+    der_ctx_t ctx;
+    der_init(&ctx, const_cast<std::uint8_t *>(data.data()), data.size());
+    der_tlv_t tlv;
+    der_error_t err = der_decode_tlv(&ctx, &tlv);
+    if (err != DER_OK) {
+      return err;
+    }
+    out.tag_ = tlv.tag;
+    out.encoding_ = data.first(ctx.pos);
+    out.value_ = bytes(tlv.value, tlv.length);
+    return DER_OK;
+  }
+
+  std::uint8_t tag() const { return tag_; }
+  bool constructed() const { return der_is_constructed(tag_); }
+  bytes encoding() const { return encoding_; }
+  bytes value() const { return value_; }
+  std::size_t header_size() const { return encoding_.size() - value_.size(); }
+
+  inline children elements() const;
+
+private:
+  std::uint8_t tag_ = 0;
+  bytes encoding_;
+  bytes value_;
+};
+
+/*
+ * Range over the elements encoded back to back in a buffer, such as the
+ * contents of a SEQUENCE or a file of concatenated certificates. Iteration
+ * ends at the first element that does not decode; error() then says why.
+ */
+class children {
+public:
+  explicit children(bytes data) : data_(data) {}
+
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = element;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const element *;
+    using reference = const element &;
+
+    iterator() = default;
+    iterator(bytes rest, der_error_t *error) : rest_(rest), error_(error) {
+      next();
+    }
+
+    reference operator*() const { return current_; }
+    pointer operator->() const { return &current_; }
+    iterator &operator++() {
+      next();
+      return *this;
+    }
+    void operator++(int) { next(); }
+    bool operator==(std::default_sentinel_t) const { return done_; }
+
+  private:
+    void next() {
+      if (rest_.empty()) {
+        done_ = true;
+        return;
+      }
+      der_error_t err = element::decode(rest_, current_);
+      if (err != DER_OK) {
+        *error_ = err;
+        done_ = true;
+        return;
+      }
+      rest_ = rest_.subspan(current_.encoding().size());
+    }
+
+    bytes rest_;
+    element current_;
+    der_error_t *error_ = nullptr;
+    bool done_ = false;
+  };
+
+  iterator begin() {
+    error_ = DER_OK;
+    return iterator(data_, &error_);
+  }
+  std::default_sentinel_t end() const { return {}; }
+  der_error_t error() const { return error_; }
+
+private:
+  bytes data_;
+  der_error_t error_ = DER_OK;
+};
+
+inline children element::elements() const { return children(value_); }
+
+/* Move-only owner of a der_file_t: a mapping, a read buffer or a view. */
+class file {
+public:
+  file() = default;
+  file(const file &) = delete;
+  file &operator=(const file &) = delete;
+  file(file &&other) noexcept : file_(other.file_), open_(other.open_) {
+    other.open_ = false;
+  }
+  file &operator=(file &&other) noexcept {
+    if (this != &other) {
+      close();
+      file_ = other.file_;
+      open_ = std::exchange(other.open_, false);
+    }
+    return *this;
+  }
+  ~file() { close(); }
+
+  static der_error_t map(const char *path, file &out,
+                         der_access_t access = DER_ACCESS_SEQUENTIAL) {
+    out.close();
+    der_error_t err = der_file_map(path, &out.file_, access);
+    out.open_ = err == DER_OK;
+    return err;
+  }
+
+  static der_error_t read(const char *path, file &out) {
+    out.close();
+    der_error_t err = der_file_read(path, &out.file_);
+    out.open_ = err == DER_OK;
+    return err;
+  }
+
+  explicit operator bool() const { return open_; }
+  bytes data() const {
+    return open_ ? bytes(file_.data, file_.size) : bytes();
+  }
+  children elements() const { return children(data()); }
+  const der_file_t *get() const { return &file_; }
+
+  void close() {
+    if (open_) {
+      der_file_free(&file_);
+      open_ = false;
+    }
+  }
+
+private:
+  der_file_t file_{};
+  bool open_ = false;
+};
+
+/* Certificate fields as views into the encoding that was parsed. */
+class certificate {
+public:
+  /* Decodes the requested X509_FIELD_* bits. On failure out is empty. */
+  static der_error_t parse(bytes der, certificate &out,
+                           std::uint32_t fields = X509_FIELD_ALL) {
+    der_error_t err =
+        x509_extract_fields(der.data(), der.size(), fields, &out.cert_);
+    if (err != DER_OK) {
+      out.cert_ = {};
+    }
+    return err;
+  }
+
+  std::uint32_t version() const { return cert_.version; }
+  bytes tbs() const { return view(cert_.tbs); }
+  bytes serial() const { return view(cert_.serial); }
+  bytes signature_algorithm() const { return view(cert_.signature_algorithm); }
+  bytes issuer() const { return view(cert_.issuer); }
+  bytes validity() const { return view(cert_.validity); }
+  std::int64_t not_before() const { return cert_.not_before; }
+  std::int64_t not_after() const { return cert_.not_after; }
+  bytes subject() const { return view(cert_.subject); }
+  bytes public_key_info() const { return view(cert_.public_key_info); }
+  bytes extensions() const { return view(cert_.extensions); }
+  bytes subject_key_id() const { return view(cert_.subject_key_id); }
+  bytes authority_key_id() const { return view(cert_.authority_key_id); }
+
+  std::size_t san_count() const { return cert_.san_count; }
+  /* The i-th dNSName, straight from the certificate. */
+  std::string_view san(std::size_t i) const { return text(cert_.san[i]); }
+
+  const x509_cert_t &get() const { return cert_; }
+
+private:
+  x509_cert_t cert_{};
+};
+
+/*
+ * The value of the first attribute of the given X509_ATTR_* type in a Name,
+ * copied into buffer as text. Empty if there is none.
+ */
+inline std::string_view name_attribute(bytes name, std::uint32_t attr,
+                                       std::span<char> buffer) {
+  x509_span_t span = {name.data(), name.size()};
+  if (buffer.empty() || x509_name_attribute(span, attr, buffer.data(),
+                                            buffer.size()) != DER_OK) {
+    return {};
+  }
+  return std::string_view(buffer.data());
+}
+
+} // namespace qcert
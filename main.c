@@ -1,6 +1,11 @@
 #include "b64/b64.h"
+#include "cmd/cmd.h"
 #include "der/der.h"
+#include "der/der_utils.h"
 #include "pem/pem.h"
+#include "util/oids.h"
+#include "util/stats.h"
+#include "util/trace.h"
 #include "util/util.h"
 #include "x509/x509.h"
 #include <stdbool.h>
@@ -9,11 +14,126 @@
 #include <stdlib.h>
 #include <string.h>
 
+static void print_stats(void) {
+  stats_t stats;
+  stats_merge(&stats);
+  stats_print(stderr, &stats);
+}
+
+static void write_trace(void) { trace_finish(); }
+
+static oid_registry_t oids;
+
 int main(int argc, char *argv[]) {
   const char *filename = "";
 
-  if (argc > 1) {
-    filename = argv[1];
+  /* Global options come before the command and are shifted off argv. */
+  for (;;) {
+    if (argc > 1 && strcmp(argv[1], "--stats") == 0) {
+      stats_t probe;
+      if (stats_merge(&probe)) {
+        atexit(print_stats);
+      } else {
+        fprintf(stderr,
+                "Warning: built with QCERT_STATS=0; --stats ignored\n");
+      }
+      argv[1] = argv[0];
+      argc--;
+      argv++;
+    } else if (argc > 2 && strcmp(argv[1], "--trace") == 0) {
+      if (trace_start(argv[2]) == 0) {
+        atexit(write_trace);
+      } else {
+        fprintf(stderr,
+                "Warning: built with QCERT_STATS=0; --trace ignored\n");
+      }
+      argv[2] = argv[0];
+      argc -= 2;
+      argv += 2;
+    } else if (argc > 2 && strcmp(argv[1], "--oids") == 0) {
+      size_t line;
+      oid_registry_init(&oids);
+      der_error_t err = oid_registry_load(&oids, argv[2], &line);
+      if (err != DER_OK) {
+        if (line > 0) {
+          fprintf(stderr, "Failed to load OIDs %s: line %zu: %s\n", argv[2],
+                  line, der_error_to_string(err));
+        } else {
+          fprintf(stderr, "Failed to load OIDs %s: %s\n", argv[2],
+                  der_error_to_string(err));
+        }
+        return 1;
+      }
+      oid_registry_install(&oids);
+      argv[2] = argv[0];
+      argc -= 2;
+      argv += 2;
+    } else {
+      break;
+    }
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+    return cmd_batch(argc - 2, argv + 2);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--watch") == 0) {
+    return cmd_watch(argc - 2, argv + 2);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--crl") == 0) {
+    return cmd_crl(argc - 2, argv + 2);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--diff") == 0) {
+    return cmd_diff(argc - 2, argv + 2);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--group") == 0) {
+    return cmd_group(argc - 2, argv + 2);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--daemon") == 0) {
+    return cmd_server(argc - 2, argv + 2);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--loadgen") == 0) {
+    return cmd_loadgen(argc - 2, argv + 2);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--p7b") == 0) {
+    return cmd_p7b(argc - 2, argv + 2);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--snapshot") == 0) {
+    return cmd_snapshot(argc - 2, argv + 2);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--store") == 0) {
+    return cmd_store(argc - 2, argv + 2);
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--stream") == 0) {
+    return cmd_stream(argc - 2, argv + 2);
+  }
+
+  uint32_t fields = X509_FIELD_ALL;
+  int file_arg = 1;
+  if (argc > 1 && strcmp(argv[1], "--fields") == 0) {
+    if (argc < 4 || !x509_parse_field_list(argv[2], &fields)) {
+      fprintf(stderr, "Usage: %s --fields LIST certificate_file\n", argv[0]);
+      fprintf(stderr, "Fields:");
+      for (size_t i = 0; x509_field_name(i); i++) {
+        fprintf(stderr, "%s %s", i > 0 ? "," : "", x509_field_name(i));
+      }
+      fprintf(stderr, "\n");
+      return 1;
+    }
+    file_arg = 3;
+  }
+
+  if (argc > file_arg) {
+    filename = argv[file_arg];
   } else {
     fprintf(stderr, "Error: No certificate file provided.\n");
     fprintf(stderr, "Usage: %s [certificate_file]\n", argv[0]);
@@ -22,8 +142,53 @@ int main(int argc, char *argv[]) {
 
   if (argc > 1 &&
       (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
-    printf("Usage: %s [certificate_file]\n", argv[0]);
-    printf("Parse X.509 certificates in PEM format.\n\n");
+    printf("Usage: %s [--stats] [--trace FILE] [--oids FILE] "
+           "[certificate_file]\n",
+           argv[0]);
+    printf("Parse X.509 certificates in PEM format. Before any command, "
+           "--stats\nprints parser counters and stage timings at exit, "
+           "--trace writes\nChrome trace-event JSON to FILE, and --oids "
+           "names the OIDs listed in FILE.\n\n");
+    printf("       %s --fields LIST [certificate_file]\n", argv[0]);
+    printf("Print only the listed comma-separated sections.\n\n");
+    printf("       %s --batch [--cache FILE] [--format text|json] "
+           "[--where EXPR] PATH...\n",
+           argv[0]);
+    printf("Summarize every certificate under the given paths.\n\n");
+    printf("       %s --watch [--debounce MS] [--format text|json] DIR\n",
+           argv[0]);
+    printf("Report added, changed and removed certificates as files "
+           "change.\n\n");
+    printf("       %s --crl info|compile|check ...\n", argv[0]);
+    printf("Inspect CRLs and check serials against a compiled revocation "
+           "set.\n\n");
+    printf("       %s --diff A B\n", argv[0]);
+    printf("Show where two certificates differ, by comparing subtree "
+           "hashes.\n\n");
+    printf("       %s --group issuer|subject|key|validity [--top N] "
+           "PATH...\n",
+           argv[0]);
+    printf("Count certificates that share an identical element.\n\n");
+    printf("       %s --daemon [--workers N] [--store DIR] [--snapshot FILE] "
+           "SOCKET\n",
+           argv[0]);
+    printf("Serve length-prefixed DER/PEM parse requests on a Unix "
+           "socket.\n\n");
+    printf("       %s --loadgen [--requests N] [--concurrency C] "
+           "[--pipeline D] SOCKET FILE\n",
+           argv[0]);
+    printf("Measure daemon throughput and latency.\n\n");
+    printf("       %s --p7b OUT PATH...\n", argv[0]);
+    printf("Bundle certificates into a certs-only PKCS#7 file.\n\n");
+    printf("       %s --snapshot build|info|issuers ...\n", argv[0]);
+    printf("Compile a trust store into an mmap-able snapshot.\n\n");
+    printf("       %s --store DIR add|reindex|query ...\n", argv[0]);
+    printf("Maintain an indexed on-disk certificate inventory.\n\n");
+    printf("       %s --stream [--chunk BYTES] [--format text|json] "
+           "[--where EXPR] [FILE]\n",
+           argv[0]);
+    printf("Summarize concatenated DER certificates from a file or "
+           "stdin.\n\n");
     return 0;
   }
 
@@ -40,7 +205,7 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  uint8_t der_data[8192];
+  uint8_t der_data[QCERT_MAX_DER_SIZE];
   int der_len = base64_decode(pem_data, der_data, sizeof(der_data));
   free(pem_data);
 
@@ -51,7 +216,7 @@ int main(int argc, char *argv[]) {
 
   printf("Certificate size: %d bytes\n\n", der_len);
 
-  parse_certificate(der_data, der_len);
+  parse_certificate_fields(der_data, der_len, fields);
 
   return 0;
 }
\ No newline at end of file
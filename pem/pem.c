@@ -1,5 +1,10 @@
 #include "pem.h"
+#include "../b64/b64.h"
+#include "../util/arena.h"
+#include "../util/stats.h"
+#include "../util/util.h"
 
+#ifndef QCERT_NO_STDIO
 char *read_pem_file(const char *filename) {
   FILE *file = fopen(filename, "r");
   if (!file) {
@@ -46,4 +51,161 @@ char *read_pem_file(const char *filename) {
 
   free(buffer);
   return b64_data;
-}
\ No newline at end of file
+}
+#endif
+
+static void *pem_alloc(arena_t *arena, size_t size) {
+  return arena ? arena_alloc(arena, size) : malloc(size);
+}
+
+/* Writes "<kind><label>-----" into out. */
+static bool pem_boundary(char *out, size_t size, const char *kind,
+                         const char *label) {
+  size_t kind_len = strlen(kind);
+  size_t label_len = strlen(label);
+  if (kind_len + label_len + 6 > size) {
+    return false;
+  }
+  memcpy(out, kind, kind_len);
+  memcpy(out + kind_len, label, label_len);
+  memcpy(out + kind_len + label_len, "-----", 6);
+  return true;
+}
+
+static int decode_blocks(const char *text, const char *label, arena_t *arena,
+                         pem_block_t **blocks, size_t *count) {
+  char begin[64];
+  char end[64];
+  if (!pem_boundary(begin, sizeof(begin), "-----BEGIN ", label) ||
+      !pem_boundary(end, sizeof(end), "-----END ", label)) {
+    return -1;
+  }
+
+  *blocks = NULL;
+  *count = 0;
+
+  size_t capacity = 0;
+  for (const char *p = text; (p = strstr(p, begin)) != NULL;
+       p += strlen(begin)) {
+    capacity++;
+  }
+  if (capacity == 0) {
+    return 0;
+  }
+
+  *blocks = pem_alloc(arena, capacity * sizeof(pem_block_t));
+  if (!*blocks) {
+    return -1;
+  }
+
+  const char *p = text;
+  while ((p = strstr(p, begin)) != NULL) {
+    const char *start = p + strlen(begin);
+    const char *stop = strstr(start, end);
+    if (!stop) {
+      break;
+    }
+
+    size_t b64_len = stop - start;
+    uint8_t *der = pem_alloc(arena, b64_len * 3 / 4 + 1);
+    if (!der) {
+      if (!arena) {
+        pem_free_blocks(*blocks, *count);
+      }
+      return -1;
+    }
+
+    STATS_STAGE_BEGIN(decode_start);
+    int der_len = base64_decode_n(start, b64_len, der, b64_len * 3 / 4 + 1);
+    STATS_STAGE_END(STATS_STAGE_BASE64, decode_start);
+    if (der_len <= 0) {
+      if (!arena) {
+        free(der);
+      }
+      p = stop + strlen(end);
+      continue;
+    }
+
+    (*blocks)[*count].der = der;
+    (*blocks)[*count].der_len = (size_t)der_len;
+    (*count)++;
+
+    p = stop + strlen(end);
+  }
+
+  return 0;
+}
+
+int pem_decode_blocks(const char *text, const char *label, pem_block_t **blocks,
+                      size_t *count) {
+  return decode_blocks(text, label, NULL, blocks, count);
+}
+
+int pem_decode_blocks_arena(const char *text, const char *label,
+                            arena_t *arena, pem_block_t **blocks,
+                            size_t *count) {
+  if (!arena) {
+    return -1;
+  }
+  return decode_blocks(text, label, arena, blocks, count);
+}
+
+int pem_read_certificates(const char *filename, pem_block_t **blocks,
+                          size_t *count) {
+  size_t size;
+  uint8_t *data = read_file(filename, &size);
+  if (!data) {
+    return -1;
+  }
+
+  if (size > 0 && data[0] == 0x30) {
+    *blocks = malloc(sizeof(pem_block_t));
+    if (!*blocks) {
+      free(data);
+      return -1;
+    }
+    (*blocks)[0].der = data;
+    (*blocks)[0].der_len = size;
+    *count = 1;
+    return 0;
+  }
+
+  int result = pem_decode_blocks((const char *)data, "CERTIFICATE", blocks,
+                                 count);
+  free(data);
+  return result;
+}
+
+int pem_read_certificates_arena(const char *filename, arena_t *arena,
+                                pem_block_t **blocks, size_t *count) {
+  size_t size;
+  uint8_t *data = arena_read_file(arena, filename, &size);
+  if (!data) {
+    return -1;
+  }
+
+  if (size > 0 && data[0] == 0x30) {
+    *blocks = arena_alloc(arena, sizeof(pem_block_t));
+    if (!*blocks) {
+      return -1;
+    }
+    (*blocks)[0].der = data;
+    (*blocks)[0].der_len = size;
+    *count = 1;
+    return 0;
+  }
+
+  return decode_blocks((const char *)data, "CERTIFICATE", arena, blocks,
+                       count);
+}
+
+void pem_free_blocks(pem_block_t *blocks, size_t count) {
+  if (!blocks) {
+    return;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    free(blocks[i].der);
+  }
+  free(blocks);
+}
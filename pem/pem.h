@@ -1,7 +1,33 @@
 #pragma once
 
+#include "../util/arena.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#ifndef QCERT_NO_STDIO
 #include <stdio.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
 
-char *read_pem_file(const char *filename);
\ No newline at end of file
+typedef struct {
+  uint8_t *der;
+  size_t der_len;
+} pem_block_t;
+
+#ifndef QCERT_NO_STDIO
+char *read_pem_file(const char *filename);
+#endif
+
+int pem_decode_blocks(const char *text, const char *label, pem_block_t **blocks,
+                      size_t *count);
+int pem_read_certificates(const char *filename, pem_block_t **blocks,
+                          size_t *count);
+void pem_free_blocks(pem_block_t *blocks, size_t count);
+
+/* Arena variants: everything is owned by the arena, so never free blocks. */
+int pem_decode_blocks_arena(const char *text, const char *label,
+                            arena_t *arena, pem_block_t **blocks,
+                            size_t *count);
+int pem_read_certificates_arena(const char *filename, arena_t *arena,
+                                pem_block_t **blocks, size_t *count);
\ No newline at end of file
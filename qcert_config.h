@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+ * Compile-time budgets for every fixed-size buffer the parser uses. Override
+ * any of them with -D. The embedded profile (-DQCERT_EMBEDDED) leaves out
+ * everything that prints, reads files or calls malloc; callers pass input
+ * buffers and static arena pools in. The library profile (-DQCERT_LIBRARY)
+ * builds libqcert for multithreaded hosts: files and malloc stay, printing,
+ * FILE streams and process-wide state go.
+ */
+
+#if defined(QCERT_EMBEDDED) || defined(QCERT_LIBRARY)
+/* Nothing prints or opens a FILE stream. */
+#define QCERT_NO_STDIO 1
+/*
+ * No mutable globals: no installed OID registry, no --stats counters and
+ * no per-thread arena. Callers pass whatever state they want shared.
+ */
+#define QCERT_REENTRANT 1
+#endif
+
+/* Largest DER certificate accepted from a PEM file. */
+#ifndef QCERT_MAX_DER_SIZE
+#define QCERT_MAX_DER_SIZE 8192
+#endif
+
+/* Arcs kept when an OID is decoded for display or lookup. */
+#ifndef QCERT_MAX_OID_ARCS
+#define QCERT_MAX_OID_ARCS 20
+#endif
+
+/* Longest name attribute value copied out, including the NUL. */
+#ifndef QCERT_MAX_NAME_VALUE
+#define QCERT_MAX_NAME_VALUE 256
+#endif
+
+/* Longest serial number decoded for display, in bytes. */
+#ifndef QCERT_MAX_SERIAL
+#define QCERT_MAX_SERIAL 64
+#endif
+
+/* Deepest nesting der_walk accepts; its explicit stack holds this many. */
+#ifndef QCERT_MAX_DEPTH
+#define QCERT_MAX_DEPTH 64
+#endif
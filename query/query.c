@@ -0,0 +1,602 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "query.h"
+#include "../util/util.h"
+#include "../x509/x509.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUERY_FIELD_NOT_BEFORE 0
+#define QUERY_FIELD_NOT_AFTER 1
+#define QUERY_FIELD_SUBJECT 0
+#define QUERY_FIELD_ISSUER 1
+
+typedef struct {
+  const char *text;
+  const char *pos;
+  int64_t now;
+  int depth;
+  query_t *query;
+  char *error;
+  size_t error_size;
+} query_parser_t;
+
+static const struct {
+  const char *name;
+  uint32_t attr;
+} name_attributes[] = {
+    {"CN", X509_ATTR_CN}, {"C", X509_ATTR_C},   {"L", X509_ATTR_L},
+    {"ST", X509_ATTR_ST}, {"O", X509_ATTR_O},   {"OU", X509_ATTR_OU},
+};
+
+static int parse_or(query_parser_t *parser);
+
+static int parse_error(query_parser_t *parser, const char *format, ...) {
+  if (parser->error && parser->error_size > 0) {
+    char message[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    snprintf(parser->error, parser->error_size, "%s at offset %zu", message,
+             (size_t)(parser->pos - parser->text));
+  }
+  return -1;
+}
+
+static void skip_space(query_parser_t *parser) {
+  while (isspace((unsigned char)*parser->pos)) {
+    parser->pos++;
+  }
+}
+
+static bool accept(query_parser_t *parser, const char *token) {
+  skip_space(parser);
+  size_t len = strlen(token);
+  if (strncmp(parser->pos, token, len) != 0) {
+    return false;
+  }
+  parser->pos += len;
+  return true;
+}
+
+static size_t read_ident(query_parser_t *parser, char *ident, size_t max) {
+  skip_space(parser);
+  size_t len = 0;
+  while (isalnum((unsigned char)parser->pos[len]) || parser->pos[len] == '_' ||
+         parser->pos[len] == '.') {
+    len++;
+  }
+  if (len == 0 || len >= max) {
+    return 0;
+  }
+  memcpy(ident, parser->pos, len);
+  ident[len] = '\0';
+  parser->pos += len;
+  return len;
+}
+
+static int read_string(query_parser_t *parser, char *value) {
+  if (!accept(parser, "\"")) {
+    return parse_error(parser, "expected a quoted string");
+  }
+
+  size_t len = 0;
+  while (*parser->pos && *parser->pos != '"') {
+    if (*parser->pos == '\\' && parser->pos[1]) {
+      parser->pos++;
+    }
+    if (len + 1 >= QUERY_VALUE_MAX) {
+      return parse_error(parser, "string too long");
+    }
+    value[len++] = *parser->pos++;
+  }
+  if (*parser->pos != '"') {
+    return parse_error(parser, "unterminated string");
+  }
+  parser->pos++;
+  value[len] = '\0';
+  return 0;
+}
+
+static query_insn_t *emit(query_parser_t *parser, query_op_t op) {
+  query_t *query = parser->query;
+  if (query->count == query->capacity) {
+    size_t capacity = query->capacity ? query->capacity * 2 : 16;
+    query_insn_t *grown = realloc(query->code, capacity * sizeof(query_insn_t));
+    if (!grown) {
+      parse_error(parser, "out of memory");
+      return NULL;
+    }
+    query->code = grown;
+    query->capacity = capacity;
+  }
+
+  query_insn_t *insn = &query->code[query->count++];
+  memset(insn, 0, sizeof(query_insn_t));
+  insn->op = (uint8_t)op;
+  return insn;
+}
+
+static int parse_cmp(query_parser_t *parser, query_cmp_t *cmp) {
+  static const struct {
+    const char *token;
+    query_cmp_t cmp;
+  } ops[] = {
+      {"==", QUERY_CMP_EQ}, {"!=", QUERY_CMP_NE},   {"!~", QUERY_CMP_NOT_GLOB},
+      {"<=", QUERY_CMP_LE}, {">=", QUERY_CMP_GE},   {"<", QUERY_CMP_LT},
+      {">", QUERY_CMP_GT},  {"~", QUERY_CMP_GLOB},
+  };
+
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    if (accept(parser, ops[i].token)) {
+      *cmp = ops[i].cmp;
+      return 0;
+    }
+  }
+  return parse_error(parser, "expected a comparison operator");
+}
+
+static int parse_time(query_parser_t *parser, int64_t *time) {
+  skip_space(parser);
+
+  if (*parser->pos == '"') {
+    char value[QUERY_VALUE_MAX];
+    if (read_string(parser, value) != 0) {
+      return -1;
+    }
+    /* "YYYY-MM-DD" becomes the GeneralizedTime YYYYMMDD000000Z. */
+    char generalized[16];
+    if (strlen(value) != 10 || value[4] != '-' || value[7] != '-') {
+      return parse_error(parser, "expected a YYYY-MM-DD date");
+    }
+    snprintf(generalized, sizeof(generalized), "%.4s%.2s%.2s000000Z", value,
+             value + 5, value + 8);
+    if (x509_parse_time(DER_TAG_GENERALIZED_TIME,
+                        (const uint8_t *)generalized, 15, time) != DER_OK) {
+      return parse_error(parser, "invalid date \"%s\"", value);
+    }
+    return 0;
+  }
+
+  int64_t base = 0;
+  int sign = 1;
+  if (accept(parser, "now")) {
+    base = parser->now;
+    if (accept(parser, "+")) {
+      sign = 1;
+    } else if (accept(parser, "-")) {
+      sign = -1;
+    } else {
+      *time = base;
+      return 0;
+    }
+    skip_space(parser);
+  }
+
+  if (!isdigit((unsigned char)*parser->pos)) {
+    return parse_error(parser, "expected a time");
+  }
+
+  char *end;
+  int64_t amount = strtoll(parser->pos, &end, 10);
+  parser->pos = end;
+
+  int64_t unit = 1;
+  switch (*parser->pos) {
+  case 's':
+    parser->pos++;
+    break;
+  case 'm':
+    unit = 60;
+    parser->pos++;
+    break;
+  case 'h':
+    unit = 3600;
+    parser->pos++;
+    break;
+  case 'd':
+    unit = 86400;
+    parser->pos++;
+    break;
+  case 'w':
+    unit = 7 * 86400;
+    parser->pos++;
+    break;
+  default:
+    break;
+  }
+
+  *time = base + sign * amount * unit;
+  return 0;
+}
+
+static void normalize_serial(const char *hex, char *out) {
+  size_t len = 0;
+  for (; *hex; hex++) {
+    if (isxdigit((unsigned char)*hex)) {
+      out[len++] = (char)toupper((unsigned char)*hex);
+    }
+  }
+  out[len] = '\0';
+
+  size_t skip = 0;
+  while (len - skip > 2 && out[skip] == '0' && out[skip + 1] == '0') {
+    skip += 2;
+  }
+  memmove(out, out + skip, len - skip + 1);
+}
+
+static int parse_comparison(query_parser_t *parser) {
+  char ident[32];
+  const char *start = parser->pos;
+  if (read_ident(parser, ident, sizeof(ident)) == 0) {
+    return parse_error(parser, "expected a field name");
+  }
+
+  query_insn_t insn;
+  memset(&insn, 0, sizeof(insn));
+
+  char *dot = strchr(ident, '.');
+  if (strcmp(ident, "notBefore") == 0 || strcmp(ident, "notAfter") == 0) {
+    insn.op = QUERY_OP_TIME;
+    insn.field = ident[3] == 'B' ? QUERY_FIELD_NOT_BEFORE : QUERY_FIELD_NOT_AFTER;
+    parser->query->fields |= X509_FIELD_VALIDITY;
+  } else if (strcmp(ident, "serial") == 0) {
+    insn.op = QUERY_OP_SERIAL;
+    parser->query->fields |= X509_FIELD_SERIAL;
+  } else if (strcmp(ident, "san") == 0) {
+    insn.op = QUERY_OP_SAN;
+    parser->query->fields |= X509_FIELD_SAN;
+  } else if (dot && (strncmp(ident, "subject.", 8) == 0 ||
+                     strncmp(ident, "issuer.", 7) == 0)) {
+    insn.op = QUERY_OP_NAME;
+    insn.field = ident[0] == 's' ? QUERY_FIELD_SUBJECT : QUERY_FIELD_ISSUER;
+    parser->query->fields |=
+        ident[0] == 's' ? X509_FIELD_SUBJECT : X509_FIELD_ISSUER;
+
+    bool found = false;
+    for (size_t i = 0; i < sizeof(name_attributes) / sizeof(name_attributes[0]);
+         i++) {
+      if (strcmp(dot + 1, name_attributes[i].name) == 0) {
+        insn.attr = (uint8_t)name_attributes[i].attr;
+        found = true;
+      }
+    }
+    if (!found) {
+      parser->pos = start;
+      return parse_error(parser, "unknown name attribute '%s'", dot + 1);
+    }
+  } else {
+    parser->pos = start;
+    return parse_error(parser, "unknown field '%s'", ident);
+  }
+
+  query_cmp_t cmp = QUERY_CMP_EQ;
+  if (parse_cmp(parser, &cmp) != 0) {
+    return -1;
+  }
+  insn.cmp = (uint8_t)cmp;
+
+  if (insn.op == QUERY_OP_TIME) {
+    if (cmp == QUERY_CMP_GLOB || cmp == QUERY_CMP_NOT_GLOB) {
+      return parse_error(parser, "'~' does not apply to times");
+    }
+    if (parse_time(parser, &insn.time) != 0) {
+      return -1;
+    }
+  } else {
+    if (cmp != QUERY_CMP_EQ && cmp != QUERY_CMP_NE &&
+        cmp != QUERY_CMP_GLOB && cmp != QUERY_CMP_NOT_GLOB) {
+      return parse_error(parser, "'%s' only supports ==, !=, ~ and !~",
+                         ident);
+    }
+    char value[QUERY_VALUE_MAX];
+    if (read_string(parser, value) != 0) {
+      return -1;
+    }
+    if (insn.op == QUERY_OP_SERIAL) {
+      normalize_serial(value, value);
+    }
+    insn.string = strdup(value);
+    if (!insn.string) {
+      return parse_error(parser, "out of memory");
+    }
+  }
+
+  query_insn_t *slot = emit(parser, (query_op_t)insn.op);
+  if (!slot) {
+    free(insn.string);
+    return -1;
+  }
+  *slot = insn;
+  return 0;
+}
+
+static int parse_unary(query_parser_t *parser) {
+  if (++parser->depth > QUERY_MAX_DEPTH) {
+    return parse_error(parser, "expression nested too deeply");
+  }
+
+  int result;
+  skip_space(parser);
+  if (parser->pos[0] == '!' && parser->pos[1] != '=' && parser->pos[1] != '~') {
+    parser->pos++;
+    result = parse_unary(parser);
+    if (result == 0 && !emit(parser, QUERY_OP_NOT)) {
+      result = -1;
+    }
+  } else if (accept(parser, "(")) {
+    result = parse_or(parser);
+    if (result == 0 && !accept(parser, ")")) {
+      result = parse_error(parser, "expected ')'");
+    }
+  } else {
+    result = parse_comparison(parser);
+  }
+
+  parser->depth--;
+  return result;
+}
+
+static int parse_chain(query_parser_t *parser, const char *token,
+                       query_op_t jump, int (*operand)(query_parser_t *)) {
+  if (operand(parser) != 0) {
+    return -1;
+  }
+
+  while (accept(parser, token)) {
+    if (!emit(parser, jump)) {
+      return -1;
+    }
+    size_t jump_at = parser->query->count - 1;
+    if (operand(parser) != 0) {
+      return -1;
+    }
+    parser->query->code[jump_at].target = (uint32_t)parser->query->count;
+  }
+
+  return 0;
+}
+
+static int parse_and(query_parser_t *parser) {
+  return parse_chain(parser, "&&", QUERY_OP_JUMP_IF_FALSE, parse_unary);
+}
+
+static int parse_or(query_parser_t *parser) {
+  return parse_chain(parser, "||", QUERY_OP_JUMP_IF_TRUE, parse_and);
+}
+
+int query_compile(const char *text, int64_t now, query_t *query, char *error,
+                  size_t error_size) {
+  if (!text || !query) {
+    return -1;
+  }
+
+  memset(query, 0, sizeof(query_t));
+
+  query_parser_t parser;
+  memset(&parser, 0, sizeof(parser));
+  parser.text = text;
+  parser.pos = text;
+  parser.now = now;
+  parser.query = query;
+  parser.error = error;
+  parser.error_size = error_size;
+
+  int result = parse_or(&parser);
+  if (result == 0) {
+    skip_space(&parser);
+    if (*parser.pos) {
+      result = parse_error(&parser, "unexpected '%c'", *parser.pos);
+    }
+  }
+
+  if (result != 0) {
+    query_free(query);
+  }
+  return result;
+}
+
+void query_free(query_t *query) {
+  if (!query) {
+    return;
+  }
+
+  for (size_t i = 0; i < query->count; i++) {
+    free(query->code[i].string);
+  }
+  free(query->code);
+  memset(query, 0, sizeof(query_t));
+}
+
+typedef struct {
+  const uint8_t *der;
+  size_t der_len;
+  uint32_t loaded;
+  x509_cert_t cert;
+} query_eval_t;
+
+static bool ensure_fields(query_eval_t *eval, uint32_t fields) {
+  if ((eval->loaded & fields) == fields) {
+    return true;
+  }
+
+  eval->loaded |= fields;
+  return x509_extract_fields(eval->der, eval->der_len, eval->loaded,
+                             &eval->cert) == DER_OK;
+}
+
+static bool chars_equal(char a, char b, bool nocase) {
+  return nocase ? tolower((unsigned char)a) == tolower((unsigned char)b)
+                : a == b;
+}
+
+static bool glob_match(const char *pattern, const char *text, size_t len,
+                       bool nocase) {
+  const char *star = NULL;
+  size_t star_pos = 0;
+  size_t t = 0;
+
+  while (t < len) {
+    if (*pattern == '*') {
+      star = pattern++;
+      star_pos = t;
+    } else if (*pattern &&
+               (*pattern == '?' || chars_equal(*pattern, text[t], nocase))) {
+      pattern++;
+      t++;
+    } else if (star) {
+      pattern = star + 1;
+      t = ++star_pos;
+    } else {
+      return false;
+    }
+  }
+
+  while (*pattern == '*') {
+    pattern++;
+  }
+  return *pattern == '\0';
+}
+
+static bool string_matches(const query_insn_t *insn, const char *text,
+                           size_t len, bool nocase) {
+  bool matched;
+  if (insn->cmp == QUERY_CMP_GLOB || insn->cmp == QUERY_CMP_NOT_GLOB) {
+    matched = glob_match(insn->string, text, len, nocase);
+  } else {
+    matched = strlen(insn->string) == len;
+    for (size_t i = 0; matched && i < len; i++) {
+      matched = chars_equal(insn->string[i], text[i], nocase);
+    }
+  }
+
+  bool negated = insn->cmp == QUERY_CMP_NE || insn->cmp == QUERY_CMP_NOT_GLOB;
+  return matched != negated;
+}
+
+static bool compare_time(query_cmp_t cmp, int64_t value, int64_t operand) {
+  switch (cmp) {
+  case QUERY_CMP_EQ:
+    return value == operand;
+  case QUERY_CMP_NE:
+    return value != operand;
+  case QUERY_CMP_LT:
+    return value < operand;
+  case QUERY_CMP_LE:
+    return value <= operand;
+  case QUERY_CMP_GT:
+    return value > operand;
+  case QUERY_CMP_GE:
+    return value >= operand;
+  default:
+    return false;
+  }
+}
+
+static bool evaluate(query_eval_t *eval, const query_insn_t *insn,
+                     bool *result) {
+  switch (insn->op) {
+  case QUERY_OP_TIME:
+    if (!ensure_fields(eval, X509_FIELD_VALIDITY)) {
+      return false;
+    }
+    *result = compare_time(insn->cmp,
+                           insn->field == QUERY_FIELD_NOT_BEFORE
+                               ? eval->cert.not_before
+                               : eval->cert.not_after,
+                           insn->time);
+    return true;
+
+  case QUERY_OP_NAME: {
+    bool subject = insn->field == QUERY_FIELD_SUBJECT;
+    if (!ensure_fields(eval,
+                       subject ? X509_FIELD_SUBJECT : X509_FIELD_ISSUER)) {
+      return false;
+    }
+    char value[QUERY_VALUE_MAX];
+    x509_name_attribute(subject ? eval->cert.subject : eval->cert.issuer,
+                        insn->attr, value, sizeof(value));
+    *result = string_matches(insn, value, strlen(value), false);
+    return true;
+  }
+
+  case QUERY_OP_SERIAL: {
+    if (!ensure_fields(eval, X509_FIELD_SERIAL)) {
+      return false;
+    }
+    char hex[QUERY_VALUE_MAX];
+    size_t len = eval->cert.serial.len < QUERY_VALUE_MAX / 2
+                     ? eval->cert.serial.len
+                     : QUERY_VALUE_MAX / 2 - 1;
+    hex_to_string(eval->cert.serial.data, len, hex);
+    normalize_serial(hex, hex);
+    *result = string_matches(insn, hex, strlen(hex), true);
+    return true;
+  }
+
+  case QUERY_OP_SAN: {
+    if (!ensure_fields(eval, X509_FIELD_SAN)) {
+      return false;
+    }
+    /* != and !~ hold when no name matches; == and ~ when any does. */
+    bool negated = insn->cmp == QUERY_CMP_NE || insn->cmp == QUERY_CMP_NOT_GLOB;
+    *result = negated;
+    for (size_t i = 0; i < eval->cert.san_count; i++) {
+      if (string_matches(insn, (const char *)eval->cert.san[i].data,
+                         eval->cert.san[i].len, true) != negated) {
+        *result = !negated;
+        break;
+      }
+    }
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
+
+bool query_match(const query_t *query, const uint8_t *der_data,
+                 size_t der_len) {
+  if (!query || !der_data) {
+    return false;
+  }
+
+  query_eval_t eval;
+  eval.der = der_data;
+  eval.der_len = der_len;
+  eval.loaded = 0;
+
+  bool acc = true;
+  size_t pc = 0;
+  while (pc < query->count) {
+    const query_insn_t *insn = &query->code[pc++];
+    switch (insn->op) {
+    case QUERY_OP_NOT:
+      acc = !acc;
+      break;
+    case QUERY_OP_JUMP_IF_FALSE:
+      if (!acc) {
+        pc = insn->target;
+      }
+      break;
+    case QUERY_OP_JUMP_IF_TRUE:
+      if (acc) {
+        pc = insn->target;
+      }
+      break;
+    default:
+      if (!evaluate(&eval, insn, &acc)) {
+        return false;
+      }
+      break;
+    }
+  }
+
+  return acc;
+}
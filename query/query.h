@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define QUERY_MAX_DEPTH 32
+#define QUERY_VALUE_MAX 256
+
+typedef enum {
+  QUERY_OP_TIME,
+  QUERY_OP_NAME,
+  QUERY_OP_SERIAL,
+  QUERY_OP_SAN,
+  QUERY_OP_NOT,
+  QUERY_OP_JUMP_IF_FALSE,
+  QUERY_OP_JUMP_IF_TRUE
+} query_op_t;
+
+typedef enum {
+  QUERY_CMP_EQ,
+  QUERY_CMP_NE,
+  QUERY_CMP_LT,
+  QUERY_CMP_LE,
+  QUERY_CMP_GT,
+  QUERY_CMP_GE,
+  QUERY_CMP_GLOB,
+  QUERY_CMP_NOT_GLOB
+} query_cmp_t;
+
+/*
+ * One instruction of an accumulator machine: comparisons overwrite the
+ * accumulator, NOT inverts it, and the jumps implement && and || by
+ * skipping the right-hand side once the result is known.
+ */
+typedef struct {
+  uint8_t op;
+  uint8_t cmp;
+  uint8_t field;
+  uint8_t attr;
+  uint32_t target;
+  int64_t time;
+  char *string;
+} query_insn_t;
+
+typedef struct {
+  query_insn_t *code;
+  size_t count;
+  size_t capacity;
+  uint32_t fields;
+} query_t;
+
+/*
+ * Compiles an expression such as
+ *   notAfter < now+30d && issuer.O == "Acme" && san ~ "*.corp"
+ * Time operands are `now[+-]N[smhdw]`, epoch seconds or "YYYY-MM-DD".
+ * On failure, returns -1 and writes a message to error.
+ */
+int query_compile(const char *text, int64_t now, query_t *query, char *error,
+                  size_t error_size);
+void query_free(query_t *query);
+
+/*
+ * Extracts certificate fields only as instructions need them. A predicate
+ * that fails early never parses the fields of later predicates. A
+ * certificate that cannot be parsed does not match.
+ */
+bool query_match(const query_t *query, const uint8_t *der_data,
+                 size_t der_len);
@@ -0,0 +1,206 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "loadgen.h"
+#include "server.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  const loadgen_config_t *config;
+  size_t requests;
+  double *latencies;
+  size_t completed;
+  size_t failed;
+  int fd;
+  double *starts; /* send times, a ring of depth slots */
+  size_t depth;
+  bool done;
+  pthread_mutex_t lock;
+  pthread_cond_t room;
+} loadgen_worker_t;
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static int loadgen_connect(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/*
+ * Writes the worker's requests, staying at most pipeline ahead of the
+ * responses. It runs beside the reader so that neither side can fill its
+ * socket buffer while the other waits.
+ */
+static void *loadgen_sender(void *arg) {
+  loadgen_worker_t *worker = arg;
+  const loadgen_config_t *config = worker->config;
+
+  for (size_t i = 0; i < worker->requests; i++) {
+    pthread_mutex_lock(&worker->lock);
+    while (!worker->done && i - worker->completed >= worker->depth) {
+      pthread_cond_wait(&worker->room, &worker->lock);
+    }
+    bool done = worker->done;
+    worker->starts[i % worker->depth] = now_us();
+    pthread_mutex_unlock(&worker->lock);
+
+    if (done || server_write_frame(worker->fd, config->payload,
+                                   config->payload_len) != 0) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+static void *loadgen_worker(void *arg) {
+  loadgen_worker_t *worker = arg;
+  const loadgen_config_t *config = worker->config;
+
+  worker->depth = config->pipeline > 0 ? config->pipeline : 1;
+  worker->starts = calloc(worker->depth, sizeof(double));
+  worker->fd = loadgen_connect(config->socket_path);
+  pthread_t sender;
+  if (!worker->starts || worker->fd < 0 ||
+      pthread_create(&sender, NULL, loadgen_sender, worker) != 0) {
+    if (worker->fd >= 0) {
+      close(worker->fd);
+    }
+    free(worker->starts);
+    worker->failed = worker->requests;
+    return NULL;
+  }
+
+  /* Responses come back in request order. */
+  while (worker->completed < worker->requests) {
+    uint8_t *response;
+    size_t response_len;
+    if (server_read_frame(worker->fd, &response, &response_len) != 0) {
+      worker->failed = worker->requests - worker->completed;
+      break;
+    }
+    free(response);
+
+    pthread_mutex_lock(&worker->lock);
+    worker->latencies[worker->completed] =
+        now_us() - worker->starts[worker->completed % worker->depth];
+    worker->completed++;
+    pthread_cond_signal(&worker->room);
+    pthread_mutex_unlock(&worker->lock);
+  }
+
+  pthread_mutex_lock(&worker->lock);
+  worker->done = true;
+  pthread_cond_signal(&worker->room);
+  pthread_mutex_unlock(&worker->lock);
+  shutdown(worker->fd, SHUT_RDWR);
+  pthread_join(sender, NULL);
+
+  close(worker->fd);
+  free(worker->starts);
+  return NULL;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+int loadgen_run(const loadgen_config_t *config, loadgen_result_t *result) {
+  if (!config || !result || config->concurrency <= 0) {
+    return -1;
+  }
+
+  memset(result, 0, sizeof(loadgen_result_t));
+
+  size_t threads_count = (size_t)config->concurrency;
+  loadgen_worker_t *workers = calloc(threads_count, sizeof(loadgen_worker_t));
+  pthread_t *threads = calloc(threads_count, sizeof(pthread_t));
+  double *latencies = calloc(config->requests + 1, sizeof(double));
+  if (!workers || !threads || !latencies) {
+    free(workers);
+    free(threads);
+    free(latencies);
+    return -1;
+  }
+
+  size_t offset = 0;
+  for (size_t i = 0; i < threads_count; i++) {
+    workers[i].config = config;
+    workers[i].requests = config->requests / threads_count +
+                          (i < config->requests % threads_count ? 1 : 0);
+    workers[i].latencies = &latencies[offset];
+    pthread_mutex_init(&workers[i].lock, NULL);
+    pthread_cond_init(&workers[i].room, NULL);
+    offset += workers[i].requests;
+  }
+
+  double start = now_us();
+  size_t started = 0;
+  for (; started < threads_count; started++) {
+    if (pthread_create(&threads[started], NULL, loadgen_worker,
+                       &workers[started]) != 0) {
+      break;
+    }
+  }
+  for (size_t i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  result->seconds = (now_us() - start) / 1e6;
+
+  size_t completed = 0;
+  for (size_t i = 0; i < threads_count; i++) {
+    if (i >= started) {
+      result->failed += workers[i].requests;
+      continue;
+    }
+    memmove(&latencies[completed], workers[i].latencies,
+            workers[i].completed * sizeof(double));
+    completed += workers[i].completed;
+    result->failed += workers[i].failed;
+  }
+  result->completed = completed;
+
+  if (completed > 0) {
+    qsort(latencies, completed, sizeof(double), compare_doubles);
+    result->p50_us = latencies[completed / 2];
+    result->p99_us = latencies[(completed * 99) / 100 < completed
+                                   ? (completed * 99) / 100
+                                   : completed - 1];
+    result->max_us = latencies[completed - 1];
+  }
+
+  for (size_t i = 0; i < threads_count; i++) {
+    pthread_mutex_destroy(&workers[i].lock);
+    pthread_cond_destroy(&workers[i].room);
+  }
+  free(workers);
+  free(threads);
+  free(latencies);
+  return 0;
+}
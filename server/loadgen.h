@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  const char *socket_path;
+  const uint8_t *payload;
+  size_t payload_len;
+  size_t requests;
+  int concurrency;
+  size_t pipeline; /* requests in flight per connection */
+} loadgen_config_t;
+
+typedef struct {
+  size_t completed;
+  size_t failed;
+  double seconds;
+  double p50_us;
+  double p99_us;
+  double max_us;
+} loadgen_result_t;
+
+int loadgen_run(const loadgen_config_t *config, loadgen_result_t *result);
@@ -0,0 +1,636 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "server.h"
+#include "../der/der_utils.h"
+#include "../pem/pem.h"
+#include "../util/arena.h"
+#include "../util/util.h"
+#include "../x509/x509.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/* How long a client may take to send one whole frame. */
+#define SERVER_FRAME_TIMEOUT_MS 5000
+/*
+ * Most whole frames read from one connection per wakeup, and most requests
+ * a worker takes per wakeup. A worker never splits one connection's run,
+ * so it can take up to twice this many.
+ */
+#define SERVER_BATCH_MAX 32
+#define SERVER_QUEUE_SIZE (SERVER_MAX_CONNECTIONS * SERVER_BATCH_MAX)
+
+/*
+ * Connections are non-blocking, so the poll loop never waits on one
+ * client: each wakeup reads what has arrived into the partial frame, and
+ * the request is queued only once it is whole.
+ */
+typedef struct {
+  int fd;
+  bool busy;
+  bool failed;
+  uint8_t header[4];
+  size_t header_len;
+  uint8_t *payload; /* allocated once the header is in */
+  size_t frame_len;
+  size_t payload_len;
+  int64_t deadline_ms; /* for the partial frame, 0 if none */
+} server_conn_t;
+
+typedef struct {
+  server_conn_t *conn;
+  uint8_t *payload;
+  size_t len;
+} server_request_t;
+
+typedef struct {
+  const server_config_t *config;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  server_request_t *queue;
+  size_t queue_head;
+  size_t queue_count;
+  bool stopping;
+  int wake[2];
+  server_conn_t *conns[SERVER_MAX_CONNECTIONS];
+  size_t conn_count;
+} server_t;
+
+static int read_full(int fd, uint8_t *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = read(fd, buf, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int64_t now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Waits for a full socket buffer to drain, for at most the frame timeout. */
+static int write_full(int fd, const uint8_t *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      struct pollfd pfd = {fd, POLLOUT, 0};
+      if (poll(&pfd, 1, SERVER_FRAME_TIMEOUT_MS) <= 0) {
+        return -1;
+      }
+      continue;
+    }
+    if (n <= 0) {
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+int server_read_frame(int fd, uint8_t **payload, size_t *len) {
+  uint8_t header[4];
+  if (read_full(fd, header, sizeof(header)) != 0) {
+    return -1;
+  }
+
+  size_t frame_len = ((size_t)header[0] << 24) | ((size_t)header[1] << 16) |
+                     ((size_t)header[2] << 8) | header[3];
+  if (frame_len > SERVER_MAX_REQUEST) {
+    return -1;
+  }
+
+  *payload = malloc(frame_len + 1);
+  if (!*payload) {
+    return -1;
+  }
+
+  if (read_full(fd, *payload, frame_len) != 0) {
+    free(*payload);
+    *payload = NULL;
+    return -1;
+  }
+
+  (*payload)[frame_len] = '\0';
+  *len = frame_len;
+  return 0;
+}
+
+int server_write_frame(int fd, const uint8_t *payload, size_t len) {
+  uint8_t header[4] = {(uint8_t)(len >> 24), (uint8_t)(len >> 16),
+                       (uint8_t)(len >> 8), (uint8_t)len};
+  if (write_full(fd, header, sizeof(header)) != 0) {
+    return -1;
+  }
+  return write_full(fd, payload, len);
+}
+
+/*
+ * Reads whatever the socket has for the connection's partial frame, never
+ * past its end. Returns 1 once the frame is whole, 0 if more is needed and
+ * -1 on EOF, a read error or an oversized frame.
+ */
+static int server_conn_read(server_conn_t *conn) {
+  for (;;) {
+    uint8_t *buf;
+    size_t want;
+    if (conn->header_len < sizeof(conn->header)) {
+      buf = conn->header + conn->header_len;
+      want = sizeof(conn->header) - conn->header_len;
+    } else {
+      buf = conn->payload + conn->payload_len;
+      want = conn->frame_len - conn->payload_len;
+    }
+
+    if (want > 0) {
+      ssize_t n = read(conn->fd, buf, want);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+      }
+      if (n <= 0) {
+        return -1;
+      }
+      if (conn->deadline_ms == 0) {
+        conn->deadline_ms = now_ms() + SERVER_FRAME_TIMEOUT_MS;
+      }
+      if (conn->header_len < sizeof(conn->header)) {
+        conn->header_len += (size_t)n;
+        if (conn->header_len < sizeof(conn->header)) {
+          continue;
+        }
+        conn->frame_len = ((size_t)conn->header[0] << 24) |
+                          ((size_t)conn->header[1] << 16) |
+                          ((size_t)conn->header[2] << 8) | conn->header[3];
+        if (conn->frame_len > SERVER_MAX_REQUEST) {
+          return -1;
+        }
+        conn->payload = malloc(conn->frame_len + 1);
+        if (!conn->payload) {
+          return -1;
+        }
+        continue;
+      }
+      conn->payload_len += (size_t)n;
+    }
+
+    if (conn->payload_len == conn->frame_len) {
+      conn->payload[conn->frame_len] = '\0';
+      return 1;
+    }
+  }
+}
+
+/* Hands the whole frame over to a request and starts the next one. */
+static void server_conn_take(server_conn_t *conn, server_request_t *request) {
+  request->conn = conn;
+  request->payload = conn->payload;
+  request->len = conn->frame_len;
+  conn->payload = NULL;
+  conn->header_len = 0;
+  conn->frame_len = 0;
+  conn->payload_len = 0;
+  conn->deadline_ms = 0;
+}
+
+static void server_conn_free(server_conn_t *conn) {
+  close(conn->fd);
+  free(conn->payload);
+  free(conn);
+}
+
+static void format_string(FILE *out, const uint8_t *data, size_t len) {
+  fputc('"', out);
+  for (size_t i = 0; i < len; i++) {
+    if (data[i] == '"' || data[i] == '\\') {
+      fprintf(out, "\\%c", data[i]);
+    } else if (data[i] < 0x20 || data[i] >= 0x7F) {
+      fprintf(out, "\\u%04x", data[i]);
+    } else {
+      fputc(data[i], out);
+    }
+  }
+  fputc('"', out);
+}
+
+static bool record_found(const store_record_t *record, void *user) {
+  (void)record;
+  *(bool *)user = true;
+  return false;
+}
+
+static bool issuer_found(const snapshot_t *snapshot,
+                         const snapshot_cert_t *cert, void *user) {
+  (void)snapshot;
+  *(const snapshot_cert_t **)user = cert;
+  return false;
+}
+
+static void format_cert(FILE *out, const server_config_t *config,
+                        const uint8_t *der_data, size_t der_len) {
+  x509_cert_t cert;
+  der_error_t err = x509_extract(der_data, der_len, &cert);
+  if (err != DER_OK) {
+    fprintf(out, "{\"error\":\"%s\"}", der_error_to_string(err));
+    return;
+  }
+
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  char hex[SHA256_DIGEST_SIZE * 2 + 1];
+  sha256(der_data, der_len, digest);
+  hex_to_string(digest, sizeof(digest), hex);
+  fprintf(out, "{\"sha256\":\"%s\"", hex);
+
+  char serial[2 * 64 + 1];
+  size_t serial_len = cert.serial.len < 64 ? cert.serial.len : 64;
+  hex_to_string(cert.serial.data, serial_len, serial);
+  fprintf(out, ",\"serial\":\"%s\"", serial);
+
+  char value[256];
+  fprintf(out, ",\"subject_cn\":");
+  x509_name_attribute(cert.subject, X509_ATTR_CN, value, sizeof(value));
+  format_string(out, (const uint8_t *)value, strlen(value));
+  fprintf(out, ",\"issuer_cn\":");
+  x509_name_attribute(cert.issuer, X509_ATTR_CN, value, sizeof(value));
+  format_string(out, (const uint8_t *)value, strlen(value));
+
+  char not_before[32], not_after[32];
+  x509_format_time(cert.not_before, not_before, sizeof(not_before));
+  x509_format_time(cert.not_after, not_after, sizeof(not_after));
+  fprintf(out, ",\"not_before\":\"%s\",\"not_after\":\"%s\",\"san\":[",
+          not_before, not_after);
+  for (size_t i = 0; i < cert.san_count; i++) {
+    if (i > 0) {
+      fputc(',', out);
+    }
+    format_string(out, cert.san[i].data, cert.san[i].len);
+  }
+  fputc(']', out);
+
+  if (config->store) {
+    store_query_t query;
+    memset(&query, 0, sizeof(query));
+    query.sha256 = digest;
+    bool found = false;
+    store_query(config->store, &query, record_found, &found);
+    fprintf(out, ",\"in_store\":%s", found ? "true" : "false");
+  }
+
+  if (config->snapshot) {
+    const snapshot_cert_t *issuer = NULL;
+    if (cert.authority_key_id.len > 0) {
+      snapshot_find_ski(config->snapshot, cert.authority_key_id.data,
+                        cert.authority_key_id.len, issuer_found, &issuer);
+    } else {
+      snapshot_find_subject(config->snapshot, cert.issuer.data,
+                            cert.issuer.len, issuer_found, &issuer);
+    }
+    if (issuer) {
+      hex_to_string(issuer->sha256, SHA256_DIGEST_SIZE, hex);
+      fprintf(out, ",\"issuer_sha256\":\"%s\"", hex);
+    } else {
+      fprintf(out, ",\"issuer_sha256\":null");
+    }
+  }
+
+  fputc('}', out);
+}
+
+static void server_process(const server_config_t *config,
+                           const server_request_t *request, arena_t *arena,
+                           FILE *out) {
+  pem_block_t *blocks = NULL;
+  size_t count = 0;
+
+  if (request->len > 0 && request->payload[0] == 0x30) {
+    fprintf(out, "{\"status\":\"ok\",\"certificates\":[");
+    format_cert(out, config, request->payload, request->len);
+    fprintf(out, "]}");
+  } else if (pem_decode_blocks_arena((const char *)request->payload,
+                                     "CERTIFICATE", arena, &blocks,
+                                     &count) == 0 &&
+             count > 0) {
+    fprintf(out, "{\"status\":\"ok\",\"certificates\":[");
+    for (size_t i = 0; i < count; i++) {
+      if (i > 0) {
+        fputc(',', out);
+      }
+      format_cert(out, config, blocks[i].der, blocks[i].der_len);
+    }
+    fprintf(out, "]}");
+  } else {
+    fprintf(out, "{\"status\":\"error\",\"error\":\"no certificate found\"}");
+  }
+}
+
+/*
+ * Answers one connection's run of requests, in order, with a single write
+ * of all their frames. Returns true if the write failed.
+ */
+static bool server_answer(const server_config_t *config,
+                          const server_request_t *requests, size_t count,
+                          arena_t *arena) {
+  char *response;
+  size_t response_len;
+  FILE *out = open_memstream(&response, &response_len);
+  if (!out) {
+    return true;
+  }
+
+  /* Each frame's length is filled in once the stream is closed. */
+  size_t starts[2 * SERVER_BATCH_MAX + 1];
+  static const uint8_t placeholder[4] = {0};
+  for (size_t i = 0; i < count; i++) {
+    starts[i] = (size_t)ftell(out);
+    fwrite(placeholder, 1, sizeof(placeholder), out);
+    server_process(config, &requests[i], arena, out);
+  }
+  starts[count] = (size_t)ftell(out);
+  if (fclose(out) != 0) {
+    free(response);
+    return true;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    size_t len = starts[i + 1] - starts[i] - 4;
+    uint8_t *header = (uint8_t *)response + starts[i];
+    header[0] = (uint8_t)(len >> 24);
+    header[1] = (uint8_t)(len >> 16);
+    header[2] = (uint8_t)(len >> 8);
+    header[3] = (uint8_t)len;
+  }
+
+  bool failed = write_full(requests[0].conn->fd, (uint8_t *)response,
+                           response_len) != 0;
+  free(response);
+  return failed;
+}
+
+static void *server_worker(void *arg) {
+  server_t *server = arg;
+  server_request_t batch[2 * SERVER_BATCH_MAX];
+  arena_t arena;
+  arena_init(&arena, ARENA_BLOCK_SIZE);
+
+  for (;;) {
+    pthread_mutex_lock(&server->lock);
+    while (server->queue_count == 0 && !server->stopping) {
+      pthread_cond_wait(&server->ready, &server->lock);
+    }
+    if (server->queue_count == 0) {
+      pthread_mutex_unlock(&server->lock);
+      break;
+    }
+
+    size_t count = 0;
+    while (server->queue_count > 0 &&
+           (count < SERVER_BATCH_MAX ||
+            server->queue[server->queue_head].conn == batch[count - 1].conn)) {
+      batch[count++] = server->queue[server->queue_head];
+      server->queue_head = (server->queue_head + 1) % SERVER_QUEUE_SIZE;
+      server->queue_count--;
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    arena_mark_t mark = arena_mark(&arena);
+    for (size_t i = 0; i < count;) {
+      size_t end = i + 1;
+      while (end < count && batch[end].conn == batch[i].conn) {
+        end++;
+      }
+
+      server_conn_t *conn = batch[i].conn;
+      bool failed = server_answer(server->config, &batch[i], end - i, &arena);
+      for (; i < end; i++) {
+        free(batch[i].payload);
+      }
+
+      pthread_mutex_lock(&server->lock);
+      conn->busy = false;
+      conn->failed = conn->failed || failed;
+      pthread_mutex_unlock(&server->lock);
+    }
+    arena_release(&arena, mark);
+
+    ssize_t ignored = write(server->wake[1], "w", 1);
+    (void)ignored;
+  }
+
+  arena_free(&arena);
+  return NULL;
+}
+
+static int server_listen(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  unlink(path);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, 128) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+static void server_io_loop(server_t *server, int listen_fd,
+                           volatile sig_atomic_t *stop) {
+  server_conn_t **conns = server->conns;
+  struct pollfd fds[SERVER_MAX_CONNECTIONS + 2];
+  server_conn_t *polled[SERVER_MAX_CONNECTIONS];
+
+  while (!*stop) {
+    int64_t now = now_ms();
+    size_t nfds = 0;
+    fds[nfds].fd = listen_fd;
+    fds[nfds++].events = POLLIN;
+    fds[nfds].fd = server->wake[0];
+    fds[nfds++].events = POLLIN;
+
+    pthread_mutex_lock(&server->lock);
+    for (size_t i = 0; i < server->conn_count;) {
+      server_conn_t *conn = conns[i];
+      if (!conn->busy && conn->deadline_ms != 0 && now > conn->deadline_ms) {
+        conn->failed = true;
+      }
+      if (!conn->busy && conn->failed) {
+        server_conn_free(conn);
+        conns[i] = conns[--server->conn_count];
+        continue;
+      }
+      if (!conn->busy) {
+        polled[nfds - 2] = conn;
+        fds[nfds].fd = conn->fd;
+        fds[nfds++].events = POLLIN;
+      }
+      i++;
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    int ready = poll(fds, nfds, 500);
+    if (ready <= 0) {
+      continue;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      char drain[64];
+      while (read(server->wake[0], drain, sizeof(drain)) > 0) {
+      }
+    }
+
+    for (size_t i = 2; i < nfds; i++) {
+      if (!fds[i].revents) {
+        continue;
+      }
+
+      /* A pipelining client may have several whole frames waiting. */
+      server_conn_t *conn = polled[i - 2];
+      server_request_t requests[SERVER_BATCH_MAX];
+      size_t count = 0;
+      int status = (fds[i].revents & POLLIN) ? server_conn_read(conn) : -1;
+      while (status > 0) {
+        server_conn_take(conn, &requests[count++]);
+        status = count < SERVER_BATCH_MAX ? server_conn_read(conn) : 0;
+      }
+      if (status < 0) {
+        conn->failed = true;
+      }
+      if (count == 0) {
+        continue;
+      }
+
+      /* Queued together, so one worker answers them with one write. */
+      pthread_mutex_lock(&server->lock);
+      for (size_t j = 0; j < count; j++) {
+        size_t tail =
+            (server->queue_head + server->queue_count) % SERVER_QUEUE_SIZE;
+        server->queue[tail] = requests[j];
+        server->queue_count++;
+      }
+      conn->busy = true;
+      pthread_cond_signal(&server->ready);
+      pthread_mutex_unlock(&server->lock);
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int fd;
+      while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+        server_conn_t *conn = calloc(1, sizeof(server_conn_t));
+        if (!conn || server->conn_count == SERVER_MAX_CONNECTIONS) {
+          free(conn);
+          close(fd);
+          continue;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        conn->fd = fd;
+        pthread_mutex_lock(&server->lock);
+        conns[server->conn_count++] = conn;
+        pthread_mutex_unlock(&server->lock);
+      }
+    }
+  }
+
+  pthread_mutex_lock(&server->lock);
+  server->stopping = true;
+  pthread_cond_broadcast(&server->ready);
+  pthread_mutex_unlock(&server->lock);
+
+  for (size_t i = 0; i < server->conn_count; i++) {
+    shutdown(conns[i]->fd, SHUT_RDWR);
+  }
+}
+
+int server_run(const server_config_t *config, volatile sig_atomic_t *stop) {
+  if (!config || !config->socket_path || config->workers <= 0) {
+    return -1;
+  }
+
+  server_t server;
+  memset(&server, 0, sizeof(server));
+  server.config = config;
+  server.queue = calloc(SERVER_QUEUE_SIZE, sizeof(server_request_t));
+  if (!server.queue || pipe(server.wake) != 0) {
+    free(server.queue);
+    return -1;
+  }
+  fcntl(server.wake[0], F_SETFL, O_NONBLOCK);
+  pthread_mutex_init(&server.lock, NULL);
+  pthread_cond_init(&server.ready, NULL);
+
+  int listen_fd = server_listen(config->socket_path);
+  if (listen_fd < 0) {
+    close(server.wake[0]);
+    close(server.wake[1]);
+    free(server.queue);
+    return -1;
+  }
+
+  pthread_t *threads = calloc((size_t)config->workers, sizeof(pthread_t));
+  int started = 0;
+  while (threads && started < config->workers &&
+         pthread_create(&threads[started], NULL, server_worker, &server) ==
+             0) {
+    started++;
+  }
+
+  int result = started > 0 ? 0 : -1;
+  if (started > 0) {
+    server_io_loop(&server, listen_fd, stop);
+  } else {
+    server.stopping = true;
+  }
+
+  for (int i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  for (size_t i = 0; i < server.conn_count; i++) {
+    server_conn_free(server.conns[i]);
+  }
+
+  close(listen_fd);
+  unlink(config->socket_path);
+  close(server.wake[0]);
+  close(server.wake[1]);
+  pthread_mutex_destroy(&server.lock);
+  pthread_cond_destroy(&server.ready);
+  free(threads);
+  free(server.queue);
+  return result;
+}
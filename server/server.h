@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../store/store.h"
+#include "../trust/snapshot.h"
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SERVER_MAX_REQUEST (1024 * 1024)
+#define SERVER_MAX_CONNECTIONS 1024
+
+typedef struct {
+  const char *socket_path;
+  int workers;
+  store_t *store;
+  const snapshot_t *snapshot; /* issuer lookups, NULL for none */
+} server_config_t;
+
+int server_run(const server_config_t *config, volatile sig_atomic_t *stop);
+
+int server_read_frame(int fd, uint8_t **payload, size_t *len);
+int server_write_frame(int fd, const uint8_t *payload, size_t len);
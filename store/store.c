@@ -0,0 +1,738 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "store.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STORE_HEADER_SIZE 16
+#define STORE_PATH_MAX 4096
+
+static const char *store_index_names[STORE_INDEX_COUNT] = {
+    "sha256.idx", "not_after.idx", "issuer.idx", "ski.idx", "san.idx"};
+
+static void store_path(const store_t *store, const char *name, char *path) {
+  snprintf(path, STORE_PATH_MAX, "%s/%s", store->dir, name);
+}
+
+static uint64_t sha256_key(const uint8_t *digest) {
+  uint64_t key = 0;
+  for (int i = 0; i < 8; i++) {
+    key = (key << 8) | digest[i];
+  }
+  return key;
+}
+
+static uint64_t time_key(int64_t time) {
+  return (uint64_t)time ^ 0x8000000000000000ULL;
+}
+
+uint64_t store_hash_hostname(const uint8_t *host, size_t len) {
+  uint8_t lower[256];
+  if (len > sizeof(lower)) {
+    len = sizeof(lower);
+  }
+  for (size_t i = 0; i < len; i++) {
+    lower[i] = (uint8_t)tolower(host[i]);
+  }
+  return hash64(lower, len);
+}
+
+static void store_unmap_index(store_index_t *index) {
+  if (index->map) {
+    munmap(index->map, index->map_size);
+  }
+  memset(index, 0, sizeof(store_index_t));
+}
+
+static void store_map_index(store_t *store, store_index_kind_t kind) {
+  store_index_t *index = &store->indexes[kind];
+  store_unmap_index(index);
+
+  char path[STORE_PATH_MAX];
+  store_path(store, store_index_names[kind], path);
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(store_index_header_t)) {
+    close(fd);
+    return;
+  }
+
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return;
+  }
+
+  /* count is bounded by the file before it is multiplied, so nothing wraps. */
+  const store_index_header_t *header = map;
+  size_t entries_size = (size_t)st.st_size - sizeof(store_index_header_t);
+  if (memcmp(header->magic, STORE_INDEX_MAGIC, 8) != 0 ||
+      header->count > entries_size / sizeof(store_index_entry_t) ||
+      header->count * sizeof(store_index_entry_t) != entries_size) {
+    munmap(map, (size_t)st.st_size);
+    return;
+  }
+
+  index->map = map;
+  index->map_size = (size_t)st.st_size;
+  index->entries =
+      (const store_index_entry_t *)((const uint8_t *)map +
+                                    sizeof(store_index_header_t));
+  index->count = header->count;
+}
+
+static der_error_t store_remap(store_t *store) {
+  if (store->data) {
+    munmap((void *)store->data, store->data_size);
+    store->data = NULL;
+    store->data_size = 0;
+  }
+
+  struct stat st;
+  if (fstat(store->data_fd, &st) != 0) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  void *map =
+      mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, store->data_fd, 0);
+  if (map == MAP_FAILED) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  store->data = map;
+  store->data_size = (size_t)st.st_size;
+  store->append_pos = store->data_size;
+  return DER_OK;
+}
+
+der_error_t store_open(store_t *store, const char *dir) {
+  if (!store || !dir) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  memset(store, 0, sizeof(store_t));
+  store->data_fd = -1;
+
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  store->dir = strdup(dir);
+  if (!store->dir) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  char path[STORE_PATH_MAX];
+  store_path(store, STORE_DATA_FILE, path);
+
+  store->data_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (store->data_fd < 0) {
+    store_close(store);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  struct stat st;
+  if (fstat(store->data_fd, &st) != 0) {
+    store_close(store);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  if (st.st_size == 0) {
+    uint8_t header[STORE_HEADER_SIZE] = {0};
+    memcpy(header, STORE_DATA_MAGIC, 8);
+    if (write(store->data_fd, header, sizeof(header)) != sizeof(header)) {
+      store_close(store);
+      return DER_ERROR_INVALID_DATA;
+    }
+  }
+
+  der_error_t err = store_remap(store);
+  if (err != DER_OK) {
+    store_close(store);
+    return err;
+  }
+
+  if (store->data_size < STORE_HEADER_SIZE ||
+      memcmp(store->data, STORE_DATA_MAGIC, 8) != 0) {
+    store_close(store);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  for (int i = 0; i < STORE_INDEX_COUNT; i++) {
+    store_map_index(store, (store_index_kind_t)i);
+  }
+
+  return DER_OK;
+}
+
+void store_close(store_t *store) {
+  if (!store) {
+    return;
+  }
+
+  for (int i = 0; i < STORE_INDEX_COUNT; i++) {
+    store_unmap_index(&store->indexes[i]);
+  }
+  if (store->data) {
+    munmap((void *)store->data, store->data_size);
+  }
+  if (store->data_fd >= 0) {
+    close(store->data_fd);
+  }
+  free(store->pending);
+  free(store->dir);
+
+  memset(store, 0, sizeof(store_t));
+  store->data_fd = -1;
+}
+
+static uint64_t index_coverage(const store_index_t *index) {
+  if (!index->map) {
+    return STORE_HEADER_SIZE;
+  }
+  return ((const store_index_header_t *)index->map)->data_size;
+}
+
+bool store_indexes_current(const store_t *store) {
+  for (int i = 0; i < STORE_INDEX_COUNT; i++) {
+    if (!store->indexes[i].map ||
+        index_coverage(&store->indexes[i]) != store->data_size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * The fields after the header must fit the record: the DER, both CNs and
+ * san_count length-prefixed names. The sums are 64-bit, so they cannot
+ * wrap on 32-bit and 16-bit lengths.
+ */
+static bool store_record_valid(const store_record_t *record) {
+  uint64_t avail = record->record_len - sizeof(store_record_t);
+  uint64_t used = (uint64_t)record->der_len + record->subject_cn_len +
+                  record->issuer_cn_len;
+  if (used > avail) {
+    return false;
+  }
+
+  const uint8_t *p = (const uint8_t *)record + sizeof(store_record_t) + used;
+  for (uint16_t i = 0; i < record->san_count; i++) {
+    if (avail - used < 2) {
+      return false;
+    }
+    uint64_t len = (uint64_t)(p[0] | (p[1] << 8));
+    used += 2;
+    if (len > avail - used) {
+      return false;
+    }
+    used += len;
+    p += 2 + len;
+  }
+  return true;
+}
+
+static const store_record_t *store_record_at(const store_t *store,
+                                             uint64_t offset) {
+  if (offset > store->data_size ||
+      store->data_size - offset < sizeof(store_record_t)) {
+    return NULL;
+  }
+
+  const store_record_t *record =
+      (const store_record_t *)(store->data + offset);
+  if (record->magic != STORE_RECORD_MAGIC ||
+      record->record_len < sizeof(store_record_t) ||
+      record->record_len > store->data_size - offset ||
+      !store_record_valid(record)) {
+    return NULL;
+  }
+  return record;
+}
+
+const uint8_t *store_record_der(const store_record_t *record) {
+  return (const uint8_t *)record + sizeof(store_record_t);
+}
+
+x509_span_t store_record_subject_cn(const store_record_t *record) {
+  x509_span_t span = {store_record_der(record) + record->der_len,
+                      record->subject_cn_len};
+  return span;
+}
+
+x509_span_t store_record_issuer_cn(const store_record_t *record) {
+  x509_span_t span = {store_record_der(record) + record->der_len +
+                          record->subject_cn_len,
+                      record->issuer_cn_len};
+  return span;
+}
+
+static const uint8_t *store_record_sans(const store_record_t *record) {
+  return store_record_der(record) + record->der_len + record->subject_cn_len +
+         record->issuer_cn_len;
+}
+
+bool store_record_has_san(const store_record_t *record, const char *host) {
+  size_t host_len = strlen(host);
+  const uint8_t *p = store_record_sans(record);
+
+  for (uint16_t i = 0; i < record->san_count; i++) {
+    uint16_t len = (uint16_t)(p[0] | (p[1] << 8));
+    p += 2;
+    if (len == host_len) {
+      size_t j = 0;
+      while (j < len && tolower(p[j]) == tolower((unsigned char)host[j])) {
+        j++;
+      }
+      if (j == len) {
+        return true;
+      }
+    }
+    p += len;
+  }
+  return false;
+}
+
+static bool pending_find(const store_t *store, const uint8_t *digest) {
+  if (store->pending_capacity == 0) {
+    return false;
+  }
+
+  size_t mask = store->pending_capacity - 1;
+  for (size_t i = sha256_key(digest) & mask;; i = (i + 1) & mask) {
+    const store_key_t *slot = &store->pending[i];
+    if (slot->offset == 0) {
+      return false;
+    }
+    if (memcmp(slot->sha256, digest, SHA256_DIGEST_SIZE) == 0) {
+      return true;
+    }
+  }
+}
+
+static der_error_t pending_insert(store_t *store, const uint8_t *digest,
+                                  uint64_t offset) {
+  if ((store->pending_count + 1) * 2 > store->pending_capacity) {
+    size_t capacity =
+        store->pending_capacity ? store->pending_capacity * 2 : 1024;
+    store_key_t *table = calloc(capacity, sizeof(store_key_t));
+    if (!table) {
+      return DER_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    for (size_t i = 0; i < store->pending_capacity; i++) {
+      store_key_t *old = &store->pending[i];
+      if (old->offset == 0) {
+        continue;
+      }
+      size_t j = sha256_key(old->sha256) & (capacity - 1);
+      while (table[j].offset != 0) {
+        j = (j + 1) & (capacity - 1);
+      }
+      table[j] = *old;
+    }
+
+    free(store->pending);
+    store->pending = table;
+    store->pending_capacity = capacity;
+  }
+
+  size_t mask = store->pending_capacity - 1;
+  size_t i = sha256_key(digest) & mask;
+  while (store->pending[i].offset != 0) {
+    i = (i + 1) & mask;
+  }
+  memcpy(store->pending[i].sha256, digest, SHA256_DIGEST_SIZE);
+  store->pending[i].offset = offset;
+  store->pending_count++;
+  return DER_OK;
+}
+
+static der_error_t pending_load(store_t *store) {
+  uint64_t offset = index_coverage(&store->indexes[STORE_INDEX_SHA256]);
+  if (offset > store->data_size) {
+    offset = STORE_HEADER_SIZE;
+  }
+
+  const store_record_t *record;
+  while ((record = store_record_at(store, offset)) != NULL) {
+    der_error_t err = pending_insert(store, record->sha256, offset);
+    if (err != DER_OK) {
+      return err;
+    }
+    offset += record->record_len;
+  }
+
+  store->pending_loaded = true;
+  return DER_OK;
+}
+
+static size_t index_lower_bound(const store_index_t *index, uint64_t key) {
+  size_t lo = 0, hi = index->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (index->entries[mid].key < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static bool store_contains(store_t *store, const uint8_t *digest) {
+  const store_index_t *index = &store->indexes[STORE_INDEX_SHA256];
+  uint64_t key = sha256_key(digest);
+
+  for (size_t i = index_lower_bound(index, key);
+       i < index->count && index->entries[i].key == key; i++) {
+    const store_record_t *record =
+        store_record_at(store, index->entries[i].offset);
+    if (record && memcmp(record->sha256, digest, SHA256_DIGEST_SIZE) == 0) {
+      return true;
+    }
+  }
+
+  return pending_find(store, digest);
+}
+
+der_error_t store_add(store_t *store, const uint8_t *der_data, size_t der_len,
+                      bool *added) {
+  if (!store || !der_data || !added) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  *added = false;
+
+  x509_cert_t cert;
+  der_error_t err = x509_extract(der_data, der_len, &cert);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  if (!store->pending_loaded) {
+    err = pending_load(store);
+    if (err != DER_OK) {
+      return err;
+    }
+  }
+
+  store_record_t record;
+  memset(&record, 0, sizeof(record));
+  sha256(der_data, der_len, record.sha256);
+
+  if (store_contains(store, record.sha256)) {
+    return DER_OK;
+  }
+
+  char subject_cn[256], issuer_cn[256];
+  if (x509_name_attribute(cert.subject, X509_ATTR_CN, subject_cn,
+                          sizeof(subject_cn)) != DER_OK) {
+    subject_cn[0] = '\0';
+  }
+  if (x509_name_attribute(cert.issuer, X509_ATTR_CN, issuer_cn,
+                          sizeof(issuer_cn)) != DER_OK) {
+    issuer_cn[0] = '\0';
+  }
+
+  record.magic = STORE_RECORD_MAGIC;
+  record.not_before = cert.not_before;
+  record.not_after = cert.not_after;
+  record.issuer_hash = hash64(cert.issuer.data, cert.issuer.len);
+  record.subject_hash = hash64(cert.subject.data, cert.subject.len);
+  record.ski_hash =
+      cert.subject_key_id.len
+          ? hash64(cert.subject_key_id.data, cert.subject_key_id.len)
+          : 0;
+  record.der_len = (uint32_t)der_len;
+  record.subject_cn_len = (uint16_t)strlen(subject_cn);
+  record.issuer_cn_len = (uint16_t)strlen(issuer_cn);
+  record.san_count = (uint16_t)cert.san_count;
+
+  size_t len = sizeof(record) + der_len + record.subject_cn_len +
+               record.issuer_cn_len;
+  for (size_t i = 0; i < cert.san_count; i++) {
+    len += 2 + cert.san[i].len;
+  }
+  len = (len + 7) & ~(size_t)7;
+  record.record_len = (uint32_t)len;
+
+  uint8_t *buffer = calloc(1, len);
+  if (!buffer) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  uint8_t *p = buffer;
+  memcpy(p, &record, sizeof(record));
+  p += sizeof(record);
+  memcpy(p, der_data, der_len);
+  p += der_len;
+  memcpy(p, subject_cn, record.subject_cn_len);
+  p += record.subject_cn_len;
+  memcpy(p, issuer_cn, record.issuer_cn_len);
+  p += record.issuer_cn_len;
+  for (size_t i = 0; i < cert.san_count; i++) {
+    p[0] = (uint8_t)cert.san[i].len;
+    p[1] = (uint8_t)(cert.san[i].len >> 8);
+    memcpy(p + 2, cert.san[i].data, cert.san[i].len);
+    p += 2 + cert.san[i].len;
+  }
+
+  ssize_t written = write(store->data_fd, buffer, len);
+  free(buffer);
+  if (written != (ssize_t)len) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  err = pending_insert(store, record.sha256, store->append_pos);
+  if (err != DER_OK) {
+    return err;
+  }
+  store->append_pos += len;
+
+  *added = true;
+  return DER_OK;
+}
+
+typedef struct {
+  store_index_entry_t *entries;
+  size_t count;
+  size_t capacity;
+} index_builder_t;
+
+static der_error_t index_builder_add(index_builder_t *builder, uint64_t key,
+                                     uint64_t offset) {
+  if (builder->count == builder->capacity) {
+    size_t capacity = builder->capacity ? builder->capacity * 2 : 1024;
+    store_index_entry_t *entries =
+        realloc(builder->entries, capacity * sizeof(store_index_entry_t));
+    if (!entries) {
+      return DER_ERROR_BUFFER_TOO_SMALL;
+    }
+    builder->entries = entries;
+    builder->capacity = capacity;
+  }
+
+  builder->entries[builder->count].key = key;
+  builder->entries[builder->count].offset = offset;
+  builder->count++;
+  return DER_OK;
+}
+
+static int compare_entries(const void *a, const void *b) {
+  const store_index_entry_t *x = a;
+  const store_index_entry_t *y = b;
+  if (x->key != y->key) {
+    return x->key < y->key ? -1 : 1;
+  }
+  if (x->offset != y->offset) {
+    return x->offset < y->offset ? -1 : 1;
+  }
+  return 0;
+}
+
+static der_error_t index_builder_write(store_t *store, store_index_kind_t kind,
+                                       index_builder_t *builder) {
+  qsort(builder->entries, builder->count, sizeof(store_index_entry_t),
+        compare_entries);
+
+  size_t unique = 0;
+  for (size_t i = 0; i < builder->count; i++) {
+    if (unique == 0 ||
+        compare_entries(&builder->entries[unique - 1], &builder->entries[i]) !=
+            0) {
+      builder->entries[unique++] = builder->entries[i];
+    }
+  }
+
+  store_index_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, STORE_INDEX_MAGIC, 8);
+  header.count = unique;
+  header.data_size = store->data_size;
+
+  char path[STORE_PATH_MAX], tmp_path[STORE_PATH_MAX + 4];
+  store_path(store, store_index_names[kind], path);
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  FILE *fp = fopen(tmp_path, "wb");
+  if (!fp) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(builder->entries, sizeof(store_index_entry_t), unique, fp) ==
+                unique;
+  ok = fclose(fp) == 0 && ok;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    remove(tmp_path);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  store_map_index(store, kind);
+  return DER_OK;
+}
+
+der_error_t store_build_indexes(store_t *store) {
+  if (!store) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  der_error_t err = store_remap(store);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  index_builder_t builders[STORE_INDEX_COUNT];
+  memset(builders, 0, sizeof(builders));
+
+  uint64_t offset = STORE_HEADER_SIZE;
+  const store_record_t *record;
+  while (err == DER_OK && (record = store_record_at(store, offset)) != NULL) {
+    err = index_builder_add(&builders[STORE_INDEX_SHA256],
+                            sha256_key(record->sha256), offset);
+    if (err == DER_OK) {
+      err = index_builder_add(&builders[STORE_INDEX_NOT_AFTER],
+                              time_key(record->not_after), offset);
+    }
+    if (err == DER_OK) {
+      err = index_builder_add(&builders[STORE_INDEX_ISSUER],
+                              record->issuer_hash, offset);
+    }
+    if (err == DER_OK && record->ski_hash != 0) {
+      err = index_builder_add(&builders[STORE_INDEX_SKI], record->ski_hash,
+                              offset);
+    }
+
+    const uint8_t *p = store_record_sans(record);
+    for (uint16_t i = 0; err == DER_OK && i < record->san_count; i++) {
+      uint16_t len = (uint16_t)(p[0] | (p[1] << 8));
+      err = index_builder_add(&builders[STORE_INDEX_SAN],
+                              store_hash_hostname(p + 2, len), offset);
+      p += 2 + len;
+    }
+
+    offset += record->record_len;
+  }
+
+  for (int i = 0; err == DER_OK && i < STORE_INDEX_COUNT; i++) {
+    err = index_builder_write(store, (store_index_kind_t)i, &builders[i]);
+  }
+
+  for (int i = 0; i < STORE_INDEX_COUNT; i++) {
+    free(builders[i].entries);
+  }
+
+  if (err == DER_OK) {
+    free(store->pending);
+    store->pending = NULL;
+    store->pending_count = 0;
+    store->pending_capacity = 0;
+    store->pending_loaded = false;
+  }
+
+  return err;
+}
+
+static bool record_matches(const store_record_t *record,
+                           const store_query_t *query) {
+  if (query->sha256 &&
+      memcmp(record->sha256, query->sha256, SHA256_DIGEST_SIZE) != 0) {
+    return false;
+  }
+  if (query->by_not_after && (record->not_after < query->not_after_min ||
+                              record->not_after > query->not_after_max)) {
+    return false;
+  }
+  if (query->by_issuer && record->issuer_hash != query->issuer_hash) {
+    return false;
+  }
+  if (query->by_ski && record->ski_hash != query->ski_hash) {
+    return false;
+  }
+  if (query->san && !store_record_has_san(record, query->san)) {
+    return false;
+  }
+  return true;
+}
+
+static der_error_t store_scan(store_t *store, const store_query_t *query,
+                              store_match_fn match, void *user) {
+  uint64_t offset = STORE_HEADER_SIZE;
+  const store_record_t *record;
+
+  while ((record = store_record_at(store, offset)) != NULL) {
+    if (record_matches(record, query) && !match(record, user)) {
+      break;
+    }
+    offset += record->record_len;
+  }
+
+  return DER_OK;
+}
+
+der_error_t store_query(store_t *store, const store_query_t *query,
+                        store_match_fn match, void *user) {
+  if (!store || !query || !match) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  if (store->append_pos != store->data_size) {
+    der_error_t err = store_remap(store);
+    if (err != DER_OK) {
+      return err;
+    }
+  }
+
+  if (!store_indexes_current(store)) {
+    return store_scan(store, query, match, user);
+  }
+
+  store_index_kind_t kind;
+  uint64_t lo, hi;
+  if (query->sha256) {
+    kind = STORE_INDEX_SHA256;
+    lo = hi = sha256_key(query->sha256);
+  } else if (query->by_ski) {
+    kind = STORE_INDEX_SKI;
+    lo = hi = query->ski_hash;
+  } else if (query->san) {
+    kind = STORE_INDEX_SAN;
+    lo = hi = store_hash_hostname((const uint8_t *)query->san,
+                                  strlen(query->san));
+  } else if (query->by_issuer) {
+    kind = STORE_INDEX_ISSUER;
+    lo = hi = query->issuer_hash;
+  } else if (query->by_not_after) {
+    kind = STORE_INDEX_NOT_AFTER;
+    lo = time_key(query->not_after_min);
+    hi = time_key(query->not_after_max);
+  } else {
+    return store_scan(store, query, match, user);
+  }
+
+  const store_index_t *index = &store->indexes[kind];
+  for (size_t i = index_lower_bound(index, lo);
+       i < index->count && index->entries[i].key <= hi; i++) {
+    const store_record_t *record =
+        store_record_at(store, index->entries[i].offset);
+    if (record && record_matches(record, query) && !match(record, user)) {
+      break;
+    }
+  }
+
+  return DER_OK;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "../der/der.h"
+#include "../util/sha256.h"
+#include "../x509/x509.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STORE_DATA_FILE "certs.dat"
+#define STORE_DATA_MAGIC "QCSTORE1"
+#define STORE_INDEX_MAGIC "QCINDEX1"
+#define STORE_RECORD_MAGIC 0x31524351u
+
+typedef enum {
+  STORE_INDEX_SHA256 = 0,
+  STORE_INDEX_NOT_AFTER,
+  STORE_INDEX_ISSUER,
+  STORE_INDEX_SKI,
+  STORE_INDEX_SAN,
+  STORE_INDEX_COUNT
+} store_index_kind_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t record_len;
+  uint8_t sha256[SHA256_DIGEST_SIZE];
+  int64_t not_before;
+  int64_t not_after;
+  uint64_t issuer_hash;
+  uint64_t subject_hash;
+  uint64_t ski_hash;
+  uint32_t der_len;
+  uint16_t subject_cn_len;
+  uint16_t issuer_cn_len;
+  uint16_t san_count;
+  uint16_t reserved[3];
+} store_record_t;
+
+typedef struct {
+  char magic[8];
+  uint64_t count;
+  uint64_t data_size;
+  uint64_t reserved;
+} store_index_header_t;
+
+typedef struct {
+  uint64_t key;
+  uint64_t offset;
+} store_index_entry_t;
+
+typedef struct {
+  void *map;
+  size_t map_size;
+  const store_index_entry_t *entries;
+  size_t count;
+} store_index_t;
+
+typedef struct {
+  uint8_t sha256[SHA256_DIGEST_SIZE];
+  uint64_t offset;
+} store_key_t;
+
+typedef struct {
+  char *dir;
+  int data_fd;
+  const uint8_t *data;
+  size_t data_size;
+  size_t append_pos;
+  store_index_t indexes[STORE_INDEX_COUNT];
+  store_key_t *pending;
+  size_t pending_count;
+  size_t pending_capacity;
+  bool pending_loaded;
+} store_t;
+
+typedef struct {
+  bool by_not_after;
+  int64_t not_after_min;
+  int64_t not_after_max;
+  bool by_issuer;
+  uint64_t issuer_hash;
+  bool by_ski;
+  uint64_t ski_hash;
+  const char *san;
+  const uint8_t *sha256;
+} store_query_t;
+
+typedef bool (*store_match_fn)(const store_record_t *record, void *user);
+
+der_error_t store_open(store_t *store, const char *dir);
+void store_close(store_t *store);
+
+der_error_t store_add(store_t *store, const uint8_t *der_data, size_t der_len,
+                      bool *added);
+der_error_t store_build_indexes(store_t *store);
+bool store_indexes_current(const store_t *store);
+
+der_error_t store_query(store_t *store, const store_query_t *query,
+                        store_match_fn match, void *user);
+
+const uint8_t *store_record_der(const store_record_t *record);
+x509_span_t store_record_subject_cn(const store_record_t *record);
+x509_span_t store_record_issuer_cn(const store_record_t *record);
+bool store_record_has_san(const store_record_t *record, const char *host);
+
+uint64_t store_hash_hostname(const uint8_t *host, size_t len);
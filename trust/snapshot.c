@@ -0,0 +1,511 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "snapshot.h"
+#include "../batch/batch.h"
+#include "../pem/pem.h"
+#include "../util/trace.h"
+#include "../util/util.h"
+#include "../x509/x509.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+  uint8_t *der;
+  snapshot_cert_t info;
+} snapshot_item_t;
+
+typedef struct {
+  char **paths;
+  size_t count;
+  size_t capacity;
+} snapshot_paths_t;
+
+typedef struct {
+  const snapshot_paths_t *paths;
+  size_t *next;
+  snapshot_item_t *items;
+  size_t count;
+  size_t capacity;
+  size_t parsed_files;
+  size_t failed;
+} snapshot_worker_t;
+
+static int collect_path(const char *path, const struct stat *st, void *user) {
+  (void)st;
+  snapshot_paths_t *paths = user;
+
+  if (paths->count == paths->capacity) {
+    size_t capacity = paths->capacity ? paths->capacity * 2 : 256;
+    char **grown = realloc(paths->paths, capacity * sizeof(char *));
+    if (!grown) {
+      return -1;
+    }
+    paths->paths = grown;
+    paths->capacity = capacity;
+  }
+
+  paths->paths[paths->count] = strdup(path);
+  if (!paths->paths[paths->count]) {
+    return -1;
+  }
+  paths->count++;
+  return 0;
+}
+
+static bool worker_add(snapshot_worker_t *worker, uint8_t *der,
+                       size_t der_len) {
+  x509_cert_t cert;
+  if (x509_extract_fields(der, der_len,
+                          X509_FIELD_VALIDITY | X509_FIELD_SUBJECT |
+                              X509_FIELD_SUBJECT_KEY_ID,
+                          &cert) != DER_OK) {
+    return false;
+  }
+
+  if (worker->count == worker->capacity) {
+    size_t capacity = worker->capacity ? worker->capacity * 2 : 64;
+    snapshot_item_t *grown =
+        realloc(worker->items, capacity * sizeof(snapshot_item_t));
+    if (!grown) {
+      return false;
+    }
+    worker->items = grown;
+    worker->capacity = capacity;
+  }
+
+  snapshot_item_t *item = &worker->items[worker->count++];
+  memset(item, 0, sizeof(snapshot_item_t));
+  item->der = der;
+  sha256(der, der_len, item->info.sha256);
+  item->info.der_len = (uint32_t)der_len;
+  item->info.subject_offset = (uint32_t)(cert.subject.data - der);
+  item->info.subject_len = (uint32_t)cert.subject.len;
+  item->info.subject_hash = hash64(cert.subject.data, cert.subject.len);
+  if (cert.subject_key_id.len > 0) {
+    item->info.ski_offset = (uint32_t)(cert.subject_key_id.data - der);
+    item->info.ski_len = (uint32_t)cert.subject_key_id.len;
+    item->info.ski_hash =
+        hash64(cert.subject_key_id.data, cert.subject_key_id.len);
+  }
+  item->info.not_after = cert.not_after;
+  return true;
+}
+
+static void *snapshot_worker(void *arg) {
+  snapshot_worker_t *worker = arg;
+
+  for (;;) {
+    size_t i = __sync_fetch_and_add(worker->next, 1);
+    if (i >= worker->paths->count) {
+      break;
+    }
+
+    TRACE_BEGIN(start);
+    pem_block_t *blocks;
+    size_t count;
+    if (pem_read_certificates(worker->paths->paths[i], &blocks, &count) !=
+        0) {
+      worker->failed++;
+      TRACE_END(start, "file", worker->paths->paths[i]);
+      continue;
+    }
+    worker->parsed_files++;
+
+    for (size_t j = 0; j < count; j++) {
+      if (worker_add(worker, blocks[j].der, blocks[j].der_len)) {
+        blocks[j].der = NULL;
+      } else {
+        worker->failed++;
+      }
+    }
+    pem_free_blocks(blocks, count);
+    TRACE_END(start, "file", worker->paths->paths[i]);
+  }
+
+  return NULL;
+}
+
+static int compare_items(const void *a, const void *b) {
+  const snapshot_item_t *x = a;
+  const snapshot_item_t *y = b;
+  return memcmp(x->info.sha256, y->info.sha256, SHA256_DIGEST_SIZE);
+}
+
+static int compare_index(const void *a, const void *b) {
+  const snapshot_index_entry_t *x = a;
+  const snapshot_index_entry_t *y = b;
+  if (x->key != y->key) {
+    return x->key < y->key ? -1 : 1;
+  }
+  return x->cert_index < y->cert_index ? -1 : x->cert_index > y->cert_index;
+}
+
+static der_error_t snapshot_write(const char *output, snapshot_item_t *items,
+                                  size_t count) {
+  size_t ski_count = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (items[i].info.ski_len > 0) {
+      ski_count++;
+    }
+  }
+
+  snapshot_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+  header.cert_count = count;
+  header.ski_count = ski_count;
+  header.certs_offset = sizeof(snapshot_header_t);
+  header.subject_index_offset =
+      header.certs_offset + count * sizeof(snapshot_cert_t);
+  header.ski_index_offset =
+      header.subject_index_offset + count * sizeof(snapshot_index_entry_t);
+  header.blob_offset =
+      header.ski_index_offset + ski_count * sizeof(snapshot_index_entry_t);
+
+  snapshot_index_entry_t *subjects =
+      malloc((count + 1) * sizeof(snapshot_index_entry_t));
+  snapshot_index_entry_t *skis =
+      malloc((ski_count + 1) * sizeof(snapshot_index_entry_t));
+  if (!subjects || !skis) {
+    free(subjects);
+    free(skis);
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  uint64_t blob_pos = 0;
+  size_t ski_pos = 0;
+  for (size_t i = 0; i < count; i++) {
+    snapshot_cert_t *info = &items[i].info;
+    info->der_offset = header.blob_offset + blob_pos;
+    blob_pos += (info->der_len + 7) & ~(uint64_t)7;
+
+    subjects[i].key = info->subject_hash;
+    subjects[i].cert_index = i;
+    if (info->ski_len > 0) {
+      skis[ski_pos].key = info->ski_hash;
+      skis[ski_pos].cert_index = i;
+      ski_pos++;
+    }
+  }
+  qsort(subjects, count, sizeof(snapshot_index_entry_t), compare_index);
+  qsort(skis, ski_count, sizeof(snapshot_index_entry_t), compare_index);
+
+  header.blob_size = blob_pos;
+  header.total_size = header.blob_offset + blob_pos;
+
+  size_t out_len = strlen(output);
+  char *tmp_path = malloc(out_len + 5);
+  FILE *fp = NULL;
+  if (tmp_path) {
+    memcpy(tmp_path, output, out_len);
+    memcpy(tmp_path + out_len, ".tmp", 5);
+    fp = fopen(tmp_path, "wb");
+  }
+  if (!fp) {
+    free(tmp_path);
+    free(subjects);
+    free(skis);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  for (size_t i = 0; ok && i < count; i++) {
+    ok = fwrite(&items[i].info, sizeof(snapshot_cert_t), 1, fp) == 1;
+  }
+  ok = ok &&
+       fwrite(subjects, sizeof(snapshot_index_entry_t), count, fp) == count &&
+       fwrite(skis, sizeof(snapshot_index_entry_t), ski_count, fp) ==
+           ski_count;
+
+  static const uint8_t padding[8] = {0};
+  for (size_t i = 0; ok && i < count; i++) {
+    size_t len = items[i].info.der_len;
+    size_t pad = ((len + 7) & ~(size_t)7) - len;
+    ok = fwrite(items[i].der, 1, len, fp) == len &&
+         fwrite(padding, 1, pad, fp) == pad;
+  }
+
+  ok = fclose(fp) == 0 && ok;
+  if (!ok || rename(tmp_path, output) != 0) {
+    remove(tmp_path);
+    ok = false;
+  }
+
+  free(tmp_path);
+  free(subjects);
+  free(skis);
+  return ok ? DER_OK : DER_ERROR_INVALID_DATA;
+}
+
+der_error_t snapshot_build(const char *output, const char *const *paths,
+                           size_t path_count, int threads,
+                           snapshot_build_stats_t *stats) {
+  if (!output || !paths || !stats || threads <= 0) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  memset(stats, 0, sizeof(snapshot_build_stats_t));
+
+  snapshot_paths_t files;
+  memset(&files, 0, sizeof(files));
+  for (size_t i = 0; i < path_count; i++) {
+    if (batch_walk(paths[i], collect_path, &files) != 0) {
+      stats->failed++;
+    }
+  }
+  stats->files = files.count;
+
+  size_t next = 0;
+  snapshot_worker_t *workers = calloc((size_t)threads, sizeof(*workers));
+  pthread_t *ids = calloc((size_t)threads, sizeof(pthread_t));
+  der_error_t err = (workers && ids) ? DER_OK : DER_ERROR_BUFFER_TOO_SMALL;
+
+  int started = 0;
+  for (; err == DER_OK && started < threads; started++) {
+    workers[started].paths = &files;
+    workers[started].next = &next;
+    if (pthread_create(&ids[started], NULL, snapshot_worker,
+                       &workers[started]) != 0) {
+      break;
+    }
+  }
+  for (int i = 0; i < started; i++) {
+    pthread_join(ids[i], NULL);
+  }
+  if (err == DER_OK && started == 0) {
+    err = DER_ERROR_INVALID_DATA;
+  }
+
+  size_t total = 0;
+  for (int i = 0; i < started; i++) {
+    total += workers[i].count;
+    stats->failed += workers[i].failed;
+  }
+
+  snapshot_item_t *items = malloc((total + 1) * sizeof(snapshot_item_t));
+  size_t count = 0;
+  for (int i = 0; i < started; i++) {
+    if (items) {
+      memcpy(&items[count], workers[i].items,
+             workers[i].count * sizeof(snapshot_item_t));
+      count += workers[i].count;
+    } else {
+      for (size_t j = 0; j < workers[i].count; j++) {
+        free(workers[i].items[j].der);
+      }
+    }
+    free(workers[i].items);
+  }
+
+  if (err == DER_OK && !items) {
+    err = DER_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  if (items) {
+    qsort(items, count, sizeof(snapshot_item_t), compare_items);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+      if (unique > 0 && compare_items(&items[unique - 1], &items[i]) == 0) {
+        free(items[i].der);
+        stats->duplicates++;
+        continue;
+      }
+      items[unique++] = items[i];
+    }
+    stats->parsed = unique;
+
+    if (err == DER_OK) {
+      err = snapshot_write(output, items, unique);
+    }
+
+    for (size_t i = 0; i < unique; i++) {
+      free(items[i].der);
+    }
+    free(items);
+  }
+
+  for (size_t i = 0; i < files.count; i++) {
+    free(files.paths[i]);
+  }
+  free(files.paths);
+  free(workers);
+  free(ids);
+  return err;
+}
+
+/* Whether count items of size bytes at offset fit, without wrapping. */
+static bool snapshot_range_ok(uint64_t offset, uint64_t count, uint64_t size,
+                              uint64_t file_size) {
+  if (offset > file_size) {
+    return false;
+  }
+  return size == 0 || count <= (file_size - offset) / size;
+}
+
+der_error_t snapshot_open(snapshot_t *snapshot, const char *filename) {
+  if (!snapshot || !filename) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  memset(snapshot, 0, sizeof(snapshot_t));
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(snapshot_header_t)) {
+    close(fd);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return DER_ERROR_INVALID_DATA;
+  }
+  posix_madvise(map, (size_t)st.st_size, POSIX_MADV_RANDOM);
+
+  const snapshot_header_t *header = map;
+  uint64_t size = (uint64_t)st.st_size;
+  if (memcmp(header->magic, SNAPSHOT_MAGIC, 8) != 0 ||
+      header->total_size != size ||
+      !snapshot_range_ok(header->certs_offset, header->cert_count,
+                         sizeof(snapshot_cert_t), size) ||
+      !snapshot_range_ok(header->subject_index_offset, header->cert_count,
+                         sizeof(snapshot_index_entry_t), size) ||
+      !snapshot_range_ok(header->ski_index_offset, header->ski_count,
+                         sizeof(snapshot_index_entry_t), size) ||
+      !snapshot_range_ok(header->blob_offset, header->blob_size, 1, size)) {
+    munmap(map, (size_t)st.st_size);
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  const uint8_t *base = map;
+  snapshot->map = map;
+  snapshot->map_size = (size_t)st.st_size;
+  snapshot->header = header;
+  snapshot->certs = (const snapshot_cert_t *)(base + header->certs_offset);
+  snapshot->subject_index =
+      (const snapshot_index_entry_t *)(base + header->subject_index_offset);
+  snapshot->ski_index =
+      (const snapshot_index_entry_t *)(base + header->ski_index_offset);
+
+  /*
+   * Only the header is checked here, so opening stays O(1) in the number
+   * of roots. Index entries and certificate ranges are checked as lookups
+   * reach them.
+   */
+  return DER_OK;
+}
+
+void snapshot_close(snapshot_t *snapshot) {
+  if (!snapshot) {
+    return;
+  }
+
+  if (snapshot->map) {
+    munmap(snapshot->map, snapshot->map_size);
+  }
+  memset(snapshot, 0, sizeof(snapshot_t));
+}
+
+const uint8_t *snapshot_cert_der(const snapshot_t *snapshot,
+                                 const snapshot_cert_t *cert) {
+  if (!snapshot_range_ok(cert->der_offset, cert->der_len, 1,
+                         snapshot->map_size) ||
+      (uint64_t)cert->subject_offset + cert->subject_len > cert->der_len ||
+      (uint64_t)cert->ski_offset + cert->ski_len > cert->der_len) {
+    return NULL;
+  }
+  return (const uint8_t *)snapshot->map + cert->der_offset;
+}
+
+/* The certificate an index entry names, or NULL if it is out of range. */
+static const snapshot_cert_t *
+snapshot_index_cert(const snapshot_t *snapshot,
+                    const snapshot_index_entry_t *entry) {
+  if (entry->cert_index >= snapshot->header->cert_count) {
+    return NULL;
+  }
+  return &snapshot->certs[entry->cert_index];
+}
+
+const snapshot_cert_t *snapshot_find_sha256(const snapshot_t *snapshot,
+                                            const uint8_t *digest) {
+  size_t lo = 0, hi = snapshot->header->cert_count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    int cmp =
+        memcmp(snapshot->certs[mid].sha256, digest, SHA256_DIGEST_SIZE);
+    if (cmp == 0) {
+      return &snapshot->certs[mid];
+    }
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return NULL;
+}
+
+static size_t index_lower_bound(const snapshot_index_entry_t *index,
+                                size_t count, uint64_t key) {
+  size_t lo = 0, hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (index[mid].key < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+void snapshot_find_subject(const snapshot_t *snapshot, const uint8_t *name,
+                           size_t name_len, snapshot_match_fn match,
+                           void *user) {
+  uint64_t key = hash64(name, name_len);
+  size_t count = snapshot->header->cert_count;
+
+  for (size_t i = index_lower_bound(snapshot->subject_index, count, key);
+       i < count && snapshot->subject_index[i].key == key; i++) {
+    const snapshot_cert_t *cert =
+        snapshot_index_cert(snapshot, &snapshot->subject_index[i]);
+    const uint8_t *der = cert ? snapshot_cert_der(snapshot, cert) : NULL;
+    if (der && cert->subject_len == name_len &&
+        memcmp(der + cert->subject_offset, name, name_len) == 0 &&
+        !match(snapshot, cert, user)) {
+      return;
+    }
+  }
+}
+
+void snapshot_find_ski(const snapshot_t *snapshot, const uint8_t *ski,
+                       size_t ski_len, snapshot_match_fn match, void *user) {
+  uint64_t key = hash64(ski, ski_len);
+  size_t count = snapshot->header->ski_count;
+
+  for (size_t i = index_lower_bound(snapshot->ski_index, count, key);
+       i < count && snapshot->ski_index[i].key == key; i++) {
+    const snapshot_cert_t *cert =
+        snapshot_index_cert(snapshot, &snapshot->ski_index[i]);
+    const uint8_t *der = cert ? snapshot_cert_der(snapshot, cert) : NULL;
+    if (der && cert->ski_len == ski_len &&
+        memcmp(der + cert->ski_offset, ski, ski_len) == 0 &&
+        !match(snapshot, cert, user)) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../der/der.h"
+#include "../util/sha256.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAPSHOT_MAGIC "QCSNAP01"
+
+typedef struct {
+  char magic[8];
+  uint64_t total_size;
+  uint64_t cert_count;
+  uint64_t certs_offset;
+  uint64_t subject_index_offset;
+  uint64_t ski_index_offset;
+  uint64_t ski_count;
+  uint64_t blob_offset;
+  uint64_t blob_size;
+} snapshot_header_t;
+
+typedef struct {
+  uint8_t sha256[SHA256_DIGEST_SIZE];
+  uint64_t der_offset;
+  uint32_t der_len;
+  uint32_t subject_offset;
+  uint32_t subject_len;
+  uint32_t ski_len;
+  uint32_t ski_offset;
+  uint32_t reserved;
+  uint64_t subject_hash;
+  uint64_t ski_hash;
+  int64_t not_after;
+} snapshot_cert_t;
+
+typedef struct {
+  uint64_t key;
+  uint64_t cert_index;
+} snapshot_index_entry_t;
+
+typedef struct {
+  void *map;
+  size_t map_size;
+  const snapshot_header_t *header;
+  const snapshot_cert_t *certs;
+  const snapshot_index_entry_t *subject_index;
+  const snapshot_index_entry_t *ski_index;
+} snapshot_t;
+
+typedef struct {
+  size_t files;
+  size_t parsed;
+  size_t duplicates;
+  size_t failed;
+} snapshot_build_stats_t;
+
+typedef bool (*snapshot_match_fn)(const snapshot_t *snapshot,
+                                  const snapshot_cert_t *cert, void *user);
+
+der_error_t snapshot_build(const char *output, const char *const *paths,
+                           size_t path_count, int threads,
+                           snapshot_build_stats_t *stats);
+
+der_error_t snapshot_open(snapshot_t *snapshot, const char *filename);
+void snapshot_close(snapshot_t *snapshot);
+
+/* NULL if the certificate's ranges fall outside the mapping. */
+const uint8_t *snapshot_cert_der(const snapshot_t *snapshot,
+                                 const snapshot_cert_t *cert);
+const snapshot_cert_t *snapshot_find_sha256(const snapshot_t *snapshot,
+                                            const uint8_t *digest);
+void snapshot_find_subject(const snapshot_t *snapshot, const uint8_t *name,
+                           size_t name_len, snapshot_match_fn match,
+                           void *user);
+void snapshot_find_ski(const snapshot_t *snapshot, const uint8_t *ski,
+                       size_t ski_len, snapshot_match_fn match, void *user);
@@ -0,0 +1,224 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "arena.h"
+#include "stats.h"
+#include <string.h>
+#ifndef QCERT_EMBEDDED
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void arena_init(arena_t *arena, size_t block_size) {
+  memset(arena, 0, sizeof(arena_t));
+  arena->block_size = block_size > 0 ? block_size : ARENA_BLOCK_SIZE;
+}
+
+bool arena_init_buffer(arena_t *arena, void *buffer, size_t size) {
+  memset(arena, 0, sizeof(arena_t));
+  arena->fixed = true;
+
+  uintptr_t start = ((uintptr_t)buffer + ARENA_ALIGN - 1) &
+                    ~(uintptr_t)(ARENA_ALIGN - 1);
+  size_t skip = (size_t)(start - (uintptr_t)buffer);
+  if (!buffer || size < skip + sizeof(arena_block_t)) {
+    return false;
+  }
+
+  arena_block_t *block = (arena_block_t *)start;
+  block->next = NULL;
+  block->size = size - skip - sizeof(arena_block_t);
+  block->used = 0;
+  block->reserved = 0;
+
+  arena->first = block;
+  arena->current = block;
+  arena->block_size = block->size;
+  return true;
+}
+
+void arena_free(arena_t *arena) {
+  if (!arena || arena->fixed) {
+    return;
+  }
+
+#ifndef QCERT_EMBEDDED
+  arena_block_t *block = arena->first;
+  while (block) {
+    arena_block_t *next = block->next;
+    free(block);
+    block = next;
+  }
+#endif
+
+  arena->first = NULL;
+  arena->current = NULL;
+}
+
+static uint8_t *block_data(arena_block_t *block) {
+  return (uint8_t *)(block + 1);
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+  if (!arena) {
+    return NULL;
+  }
+
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if (size == 0) {
+    size = ARENA_ALIGN;
+  }
+
+  /* Every block after current is unused, so it can be taken over whole. */
+  arena_block_t *block = arena->current;
+  while (block && block->used + size > block->size) {
+    block = block->next;
+    if (block) {
+      block->used = 0;
+    }
+  }
+
+  if (!block) {
+#ifdef QCERT_EMBEDDED
+    return NULL;
+#else
+    if (arena->fixed) {
+      return NULL;
+    }
+    size_t block_size = size > arena->block_size ? size : arena->block_size;
+    block = malloc(sizeof(arena_block_t) + block_size);
+    if (!block) {
+      return NULL;
+    }
+    block->size = block_size;
+    block->used = 0;
+    block->reserved = 0;
+
+    if (arena->current) {
+      block->next = arena->current->next;
+      arena->current->next = block;
+    } else {
+      block->next = arena->first;
+      arena->first = block;
+    }
+    arena->stats.block_mallocs++;
+    STATS_ADD(STATS_BLOCK_MALLOCS, 1);
+#endif
+  }
+
+  arena->current = block;
+  void *ptr = block_data(block) + block->used;
+  block->used += size;
+
+  arena->stats.allocations++;
+  arena->stats.bytes += size;
+  STATS_ADD(STATS_ALLOCATIONS, 1);
+  STATS_ADD(STATS_ALLOCATED_BYTES, size);
+  return ptr;
+}
+
+arena_mark_t arena_mark(const arena_t *arena) {
+  arena_mark_t mark;
+  mark.block = arena->current;
+  mark.used = arena->current ? arena->current->used : 0;
+  return mark;
+}
+
+void arena_release(arena_t *arena, arena_mark_t mark) {
+  arena->stats.releases++;
+
+  if (!mark.block) {
+    arena->current = arena->first;
+    if (arena->current) {
+      arena->current->used = 0;
+    }
+    return;
+  }
+
+  arena->current = mark.block;
+  mark.block->used = mark.used;
+}
+
+void arena_reset(arena_t *arena) {
+  arena_mark_t start = {NULL, 0};
+  arena_release(arena, start);
+}
+
+#ifndef QCERT_EMBEDDED
+uint8_t *arena_read_file(arena_t *arena, const char *filename, size_t *size) {
+  STATS_STAGE_BEGIN(start);
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t file_size = (size_t)st.st_size;
+  uint8_t *buffer = arena_alloc(arena, file_size + 1);
+  if (!buffer) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t done = 0;
+  while (done < file_size) {
+    ssize_t n = read(fd, buffer + done, file_size - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      close(fd);
+      return NULL;
+    }
+    done += (size_t)n;
+  }
+  close(fd);
+
+  buffer[file_size] = '\0';
+  *size = file_size;
+  STATS_ADD(STATS_FILES_READ, 1);
+  STATS_ADD(STATS_BYTES_READ, file_size);
+  STATS_STAGE_END(STATS_STAGE_READ, start);
+  return buffer;
+}
+#endif
+
+#ifndef QCERT_REENTRANT
+static pthread_key_t thread_key;
+static pthread_once_t thread_once = PTHREAD_ONCE_INIT;
+static __thread arena_t *thread_arena;
+
+static void thread_arena_destroy(void *value) {
+  arena_free(value);
+  free(value);
+}
+
+static void thread_key_init(void) {
+  pthread_key_create(&thread_key, thread_arena_destroy);
+}
+
+arena_t *arena_thread(void) {
+  if (thread_arena) {
+    return thread_arena;
+  }
+
+  pthread_once(&thread_once, thread_key_init);
+
+  arena_t *arena = malloc(sizeof(arena_t));
+  if (!arena) {
+    return NULL;
+  }
+  arena_init(arena, ARENA_BLOCK_SIZE);
+  pthread_setspecific(thread_key, arena);
+  thread_arena = arena;
+  return arena;
+}
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../qcert_config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+/* data[] follows the header; four words keep it ARENA_ALIGN-aligned. */
+typedef struct arena_block {
+  struct arena_block *next;
+  size_t size;
+  size_t used;
+  size_t reserved;
+} arena_block_t;
+
+typedef struct {
+  uint64_t allocations;
+  uint64_t bytes;
+  uint64_t block_mallocs;
+  uint64_t releases;
+} arena_stats_t;
+
+typedef struct {
+  arena_block_t *first;
+  arena_block_t *current;
+  size_t block_size;
+  bool fixed;
+  arena_stats_t stats;
+} arena_t;
+
+typedef struct {
+  arena_block_t *block;
+  size_t used;
+} arena_mark_t;
+
+void arena_init(arena_t *arena, size_t block_size);
+/*
+ * Serves allocations from a caller-owned buffer only. arena_alloc returns
+ * NULL once the buffer is used up, and arena_free leaves the buffer alone.
+ * Returns false if the buffer is too small to hold the block header.
+ */
+bool arena_init_buffer(arena_t *arena, void *buffer, size_t size);
+void arena_free(arena_t *arena);
+
+void *arena_alloc(arena_t *arena, size_t size);
+
+/*
+ * Rewinds to a mark in O(1). Blocks are kept for reuse, so a steady
+ * allocate/release cycle stops calling malloc once the arena has grown to
+ * its working size.
+ */
+arena_mark_t arena_mark(const arena_t *arena);
+void arena_release(arena_t *arena, arena_mark_t mark);
+void arena_reset(arena_t *arena);
+
+#ifndef QCERT_EMBEDDED
+/* Reads a whole file into the arena with a terminating NUL. */
+uint8_t *arena_read_file(arena_t *arena, const char *filename, size_t *size);
+#endif
+
+#ifndef QCERT_REENTRANT
+/* Per-thread arena, created on first use and freed when the thread exits. */
+arena_t *arena_thread(void);
+#endif
@@ -0,0 +1,404 @@
+#include "oids.h"
+#include "util.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef QCERT_REENTRANT
+const oid_registry_t *oid_registry_installed;
+
+void oid_registry_install(const oid_registry_t *registry) {
+  oid_registry_installed = registry;
+}
+#endif
+
+static uint64_t arcs_hash(const uint32_t *arcs, size_t arc_count) {
+  uint64_t hash = 0x9e3779b97f4a7c15ULL ^ arc_count;
+  for (size_t i = 0; i < arc_count; i++) {
+    hash = (hash ^ arcs[i]) * 0xff51afd7ed558ccdULL;
+  }
+  return hash ^ (hash >> 29);
+}
+
+static bool same_oid(const oid_entry_t *entry, const uint32_t *arcs,
+                     size_t arc_count) {
+  return entry->arc_count == arc_count &&
+         memcmp(entry->arcs, arcs, arc_count * sizeof(uint32_t)) == 0;
+}
+
+/*
+ * Builds a snapshot from a list of entries in one allocation: the header,
+ * the entries, the hash slots and then the names. A later entry for the
+ * same OID replaces an earlier one.
+ */
+static oid_snapshot_t *snapshot_build(const oid_entry_t *list, size_t count) {
+  size_t slot_count = 8;
+  while (slot_count < count * 2) {
+    slot_count *= 2;
+  }
+  size_t names = 0;
+  for (size_t i = 0; i < count; i++) {
+    names += strlen(list[i].name) + 1;
+  }
+
+  size_t size = sizeof(oid_snapshot_t) + count * sizeof(oid_entry_t) +
+                slot_count * sizeof(uint32_t) + names;
+  oid_snapshot_t *snapshot = malloc(size);
+  if (!snapshot) {
+    return NULL;
+  }
+  memset(snapshot, 0, sizeof(oid_snapshot_t));
+  snapshot->entries = (oid_entry_t *)(snapshot + 1);
+  snapshot->slots = (uint32_t *)(snapshot->entries + count);
+  snapshot->mask = slot_count - 1;
+  memset(snapshot->slots, 0, slot_count * sizeof(uint32_t));
+  char *name = (char *)(snapshot->slots + slot_count);
+
+  for (size_t i = 0; i < count; i++) {
+    const oid_entry_t *entry = &list[i];
+    size_t slot = arcs_hash(entry->arcs, entry->arc_count) & snapshot->mask;
+    while (snapshot->slots[slot] &&
+           !same_oid(&snapshot->entries[snapshot->slots[slot] - 1],
+                     entry->arcs, entry->arc_count)) {
+      slot = (slot + 1) & snapshot->mask;
+    }
+    if (!snapshot->slots[slot]) {
+      snapshot->slots[slot] = (uint32_t)++snapshot->count;
+    }
+
+    oid_entry_t *copy = &snapshot->entries[snapshot->slots[slot] - 1];
+    *copy = *entry;
+    size_t len = strlen(entry->name) + 1;
+    memcpy(name, entry->name, len);
+    copy->name = name;
+    name += len;
+  }
+  return snapshot;
+}
+
+/* Publishes a snapshot and retires the one it replaces. Lock held. */
+static void publish(oid_registry_t *registry, oid_snapshot_t *snapshot) {
+  oid_snapshot_t *old = registry->current;
+  __atomic_store_n(&registry->current, snapshot, __ATOMIC_RELEASE);
+  if (old) {
+    old->retired = registry->retired;
+    registry->retired = old;
+  }
+}
+
+static void free_chain(oid_snapshot_t *snapshot) {
+  while (snapshot) {
+    oid_snapshot_t *next = snapshot->retired;
+    free(snapshot);
+    snapshot = next;
+  }
+}
+
+void oid_registry_init(oid_registry_t *registry) {
+  registry->current = NULL;
+  registry->retired = NULL;
+  pthread_mutex_init(&registry->lock, NULL);
+}
+
+void oid_registry_free(oid_registry_t *registry) {
+#ifndef QCERT_REENTRANT
+  if (oid_registry_installed == registry) {
+    oid_registry_installed = NULL;
+  }
+#endif
+  free(registry->current);
+  free_chain(registry->retired);
+  registry->current = NULL;
+  registry->retired = NULL;
+  pthread_mutex_destroy(&registry->lock);
+}
+
+void oid_registry_reclaim(oid_registry_t *registry) {
+  pthread_mutex_lock(&registry->lock);
+  oid_snapshot_t *retired = registry->retired;
+  registry->retired = NULL;
+  pthread_mutex_unlock(&registry->lock);
+  free_chain(retired);
+}
+
+der_error_t oid_registry_add(oid_registry_t *registry, const uint32_t *arcs,
+                             size_t arc_count, const char *name,
+                             oid_format_t format, void *arg) {
+  if (!registry || !arcs || !name) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (arc_count < 2 || arc_count > QCERT_MAX_OID_ARCS) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  oid_entry_t entry;
+  memset(&entry, 0, sizeof(entry));
+  memcpy(entry.arcs, arcs, arc_count * sizeof(uint32_t));
+  entry.arc_count = arc_count;
+  entry.name = name;
+  entry.format = format;
+  entry.arg = arg;
+  return oid_registry_add_all(registry, &entry, 1);
+}
+
+der_error_t oid_registry_add_all(oid_registry_t *registry,
+                                 const oid_entry_t *entries, size_t count) {
+  if (!registry || (!entries && count > 0)) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (!entries[i].name) {
+      return DER_ERROR_NULL_POINTER;
+    }
+    if (entries[i].arc_count < 2 ||
+        entries[i].arc_count > QCERT_MAX_OID_ARCS ||
+        strlen(entries[i].name) >= OID_REGISTRY_MAX_NAME) {
+      return DER_ERROR_INVALID_DATA;
+    }
+  }
+  if (count == 0) {
+    return DER_OK;
+  }
+
+  pthread_mutex_lock(&registry->lock);
+  const oid_snapshot_t *old = registry->current;
+  size_t kept = old ? old->count : 0;
+  oid_entry_t *list = malloc((kept + count) * sizeof(oid_entry_t));
+  if (!list) {
+    pthread_mutex_unlock(&registry->lock);
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+  if (kept > 0) {
+    memcpy(list, old->entries, kept * sizeof(oid_entry_t));
+  }
+  for (size_t i = 0; i < count; i++) {
+    list[kept + i] = entries[i];
+    list[kept + i].from_file = false;
+  }
+
+  oid_snapshot_t *snapshot = snapshot_build(list, kept + count);
+  free(list);
+  if (snapshot) {
+    publish(registry, snapshot);
+  }
+  pthread_mutex_unlock(&registry->lock);
+  return snapshot ? DER_OK : DER_ERROR_BUFFER_TOO_SMALL;
+}
+
+der_error_t oid_format_string(const uint8_t *value, size_t len, char *out,
+                              size_t size, void *arg) {
+  (void)arg;
+  der_ctx_t ctx;
+  der_init(&ctx, (uint8_t *)value, len);
+  der_tlv_t tlv;
+  der_error_t err = der_decode_tlv(&ctx, &tlv);
+  if (err != DER_OK) {
+    return err;
+  }
+  if (tlv.tag != DER_TAG_UTF8_STRING && tlv.tag != DER_TAG_PRINTABLE_STRING &&
+      tlv.tag != DER_TAG_IA5_STRING) {
+    return DER_ERROR_INVALID_TAG;
+  }
+  if (tlv.length >= size) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+  memcpy(out, tlv.value, tlv.length);
+  out[tlv.length] = '\0';
+  return DER_OK;
+}
+
+der_error_t oid_format_hex(const uint8_t *value, size_t len, char *out,
+                           size_t size, void *arg) {
+  (void)arg;
+  if (len * 2 >= size) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+  hex_to_string(value, len, out);
+  return DER_OK;
+}
+
+static const struct {
+  const char *name;
+  oid_format_t format;
+} formats[] = {
+    {"[string]", oid_format_string},
+    {"[hex]", oid_format_hex},
+};
+
+static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+/* Parses dotted arcs at *p, leaving *p after them. */
+static bool parse_arcs(char **p, oid_entry_t *entry) {
+  char *s = *p;
+  entry->arc_count = 0;
+  for (;;) {
+    if (*s < '0' || *s > '9' || entry->arc_count >= QCERT_MAX_OID_ARCS) {
+      return false;
+    }
+    uint64_t arc = 0;
+    while (*s >= '0' && *s <= '9') {
+      arc = arc * 10 + (uint64_t)(*s++ - '0');
+      if (arc > UINT32_MAX) {
+        return false;
+      }
+    }
+    entry->arcs[entry->arc_count++] = (uint32_t)arc;
+    if (*s != '.') {
+      break;
+    }
+    s++;
+  }
+  *p = s;
+
+  /* The first two arcs must be encodable as DER's combined first octets. */
+  return entry->arc_count >= 2 && entry->arcs[0] <= 2 &&
+         (entry->arcs[0] == 2 || entry->arcs[1] < 40);
+}
+
+/*
+ * Parses one line in place; the name is NUL-terminated inside it. Returns
+ * false on a syntax error and leaves entry->name NULL for a blank line.
+ */
+static bool parse_line(char *line, oid_entry_t *entry) {
+  memset(entry, 0, sizeof(oid_entry_t));
+  char *hash = strchr(line, '#');
+  if (hash) {
+    *hash = '\0';
+  }
+  while (is_space(*line)) {
+    line++;
+  }
+  if (*line == '\0') {
+    return true;
+  }
+
+  if (!parse_arcs(&line, entry) || !is_space(*line)) {
+    return false;
+  }
+  while (is_space(*line)) {
+    line++;
+  }
+  size_t len = strlen(line);
+  while (len > 0 && is_space(line[len - 1])) {
+    line[--len] = '\0';
+  }
+  if (len > 0 && line[len - 1] == ']') {
+    char *open = strrchr(line, '[');
+    size_t i = 0;
+    while (i < sizeof(formats) / sizeof(formats[0]) &&
+           (!open || strcmp(open, formats[i].name) != 0)) {
+      i++;
+    }
+    if (i == sizeof(formats) / sizeof(formats[0])) {
+      return false;
+    }
+    entry->format = formats[i].format;
+    len = (size_t)(open - line);
+    while (len > 0 && is_space(line[len - 1])) {
+      len--;
+    }
+    line[len] = '\0';
+  }
+  if (len == 0 || len >= OID_REGISTRY_MAX_NAME) {
+    return false;
+  }
+  entry->name = line;
+  entry->from_file = true;
+  return true;
+}
+
+der_error_t oid_registry_load(oid_registry_t *registry, const char *path,
+                              size_t *line) {
+  if (line) {
+    *line = 0;
+  }
+  if (!registry || !path) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  size_t size;
+  char *text = (char *)read_file(path, &size);
+  if (!text) {
+    return DER_ERROR_INVALID_DATA;
+  }
+  size_t lines = 1;
+  for (size_t i = 0; i < size; i++) {
+    lines += text[i] == '\n';
+  }
+
+  pthread_mutex_lock(&registry->lock);
+  const oid_snapshot_t *old = registry->current;
+  size_t kept = old ? old->count : 0;
+  oid_entry_t *list = malloc((lines + kept) * sizeof(oid_entry_t));
+  der_error_t err = list ? DER_OK : DER_ERROR_BUFFER_TOO_SMALL;
+
+  /* File entries first, so added entries for the same OID win. */
+  size_t count = 0;
+  char *next = text;
+  for (size_t n = 1; err == DER_OK && next; n++) {
+    char *current = next;
+    next = strchr(current, '\n');
+    if (next) {
+      *next++ = '\0';
+    }
+    if (!parse_line(current, &list[count])) {
+      err = DER_ERROR_INVALID_DATA;
+      if (line) {
+        *line = n;
+      }
+    } else if (list[count].name) {
+      count++;
+    }
+  }
+  for (size_t i = 0; err == DER_OK && i < kept; i++) {
+    if (!old->entries[i].from_file) {
+      list[count++] = old->entries[i];
+    }
+  }
+
+  if (err == DER_OK) {
+    oid_snapshot_t *snapshot = snapshot_build(list, count);
+    if (snapshot) {
+      publish(registry, snapshot);
+    } else {
+      err = DER_ERROR_BUFFER_TOO_SMALL;
+    }
+  }
+  pthread_mutex_unlock(&registry->lock);
+  free(list);
+  free(text);
+  return err;
+}
+
+const oid_entry_t *oid_registry_lookup(const oid_registry_t *registry,
+                                       const uint32_t *arcs, size_t arc_count) {
+  const oid_snapshot_t *snapshot =
+      __atomic_load_n(&registry->current, __ATOMIC_ACQUIRE);
+  if (!snapshot || arc_count > QCERT_MAX_OID_ARCS) {
+    return NULL;
+  }
+
+  size_t slot = arcs_hash(arcs, arc_count) & snapshot->mask;
+  while (snapshot->slots[slot]) {
+    const oid_entry_t *entry = &snapshot->entries[snapshot->slots[slot] - 1];
+    if (same_oid(entry, arcs, arc_count)) {
+      return entry;
+    }
+    slot = (slot + 1) & snapshot->mask;
+  }
+  return NULL;
+}
+
+const char *oid_registry_name(const oid_registry_t *registry,
+                              const uint32_t *arcs, size_t arc_count) {
+  const char *name = get_oid_name(arcs, arc_count);
+  if (name || !registry) {
+    return name;
+  }
+#ifndef QCERT_REENTRANT
+  if (registry == oid_registry_installed) {
+    return NULL; /* get_oid_name looked there already */
+  }
+#endif
+  const oid_entry_t *entry = oid_registry_lookup(registry, arcs, arc_count);
+  return entry ? entry->name : NULL;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "../der/der.h"
+#include "../qcert_config.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Runtime OID registry for names get_oid_name does not know, such as
+ * private policy and extension OIDs. Readers never lock: a lookup loads the
+ * current snapshot with one acquire load and probes its hash table. A
+ * writer copies the snapshot, changes the copy and publishes it with a
+ * release store, so registering or reloading never stalls a parse. Writers
+ * serialize on a mutex among themselves.
+ *
+ * Replaced snapshots are retired, not freed, because a reader may still
+ * hold a name from one. They are freed by oid_registry_reclaim, at a point
+ * where the caller knows no lookup is in flight, or by oid_registry_free.
+ */
+#define OID_REGISTRY_MAX_NAME 128
+
+/*
+ * Renders an extension or attribute value as text for printing. Returns
+ * DER_OK if out now holds a NUL-terminated string.
+ */
+typedef der_error_t (*oid_format_t)(const uint8_t *value, size_t len,
+                                    char *out, size_t size, void *arg);
+
+/* A UTF8String, PrintableString or IA5String, as its text. */
+der_error_t oid_format_string(const uint8_t *value, size_t len, char *out,
+                              size_t size, void *arg);
+/* Any value, as hex. */
+der_error_t oid_format_hex(const uint8_t *value, size_t len, char *out,
+                           size_t size, void *arg);
+
+typedef struct {
+  uint32_t arcs[QCERT_MAX_OID_ARCS];
+  size_t arc_count;
+  const char *name;
+  oid_format_t format; /* NULL if the value is only printed as a size */
+  void *arg;
+  bool from_file; /* replaced as a whole by oid_registry_load */
+} oid_entry_t;
+
+/* Immutable once published. */
+typedef struct oid_snapshot {
+  struct oid_snapshot *retired; /* next older retired snapshot */
+  oid_entry_t *entries;
+  size_t count;
+  uint32_t *slots; /* entry index + 1, 0 for empty */
+  size_t mask;     /* slot count - 1 */
+} oid_snapshot_t;
+
+typedef struct {
+  oid_snapshot_t *current; /* published with __atomic_store_n */
+  oid_snapshot_t *retired;
+  pthread_mutex_t lock; /* held by writers only */
+} oid_registry_t;
+
+void oid_registry_init(oid_registry_t *registry);
+void oid_registry_free(oid_registry_t *registry);
+
+/*
+ * Adds an entry, or replaces the one for the same OID. name is copied;
+ * format may be NULL. Each call copies every entry into a new snapshot and
+ * retires the old one until oid_registry_reclaim, so n calls take O(n^2)
+ * time and retained memory: register many entries with
+ * oid_registry_add_all instead.
+ */
+der_error_t oid_registry_add(oid_registry_t *registry, const uint32_t *arcs,
+                             size_t arc_count, const char *name,
+                             oid_format_t format, void *arg);
+
+/*
+ * Adds or replaces count entries in one snapshot, later entries winning
+ * for the same OID. Names are copied and from_file is ignored. Nothing
+ * changes if any entry is invalid.
+ */
+der_error_t oid_registry_add_all(oid_registry_t *registry,
+                                 const oid_entry_t *entries, size_t count);
+
+/*
+ * Reads "1.3.6.1.4.1.99999.1 Name of the OID" lines ('#' starts a comment)
+ * and publishes them in place of the entries from any earlier load, all at
+ * once. A name may end in "[string]" or "[hex]" to print values with
+ * oid_format_string or oid_format_hex. Entries added with oid_registry_add
+ * are kept. On a syntax error nothing changes and *line, if given, is the
+ * line number.
+ */
+der_error_t oid_registry_load(oid_registry_t *registry, const char *path,
+                              size_t *line);
+
+/* Frees retired snapshots. No lookup may be running on another thread. */
+void oid_registry_reclaim(oid_registry_t *registry);
+
+/*
+ * The registered entry for an OID, or NULL. It stays valid until the next
+ * oid_registry_reclaim or oid_registry_free.
+ */
+const oid_entry_t *oid_registry_lookup(const oid_registry_t *registry,
+                                       const uint32_t *arcs, size_t arc_count);
+
+/* get_oid_name's built-in names first, then the registry's. */
+const char *oid_registry_name(const oid_registry_t *registry,
+                              const uint32_t *arcs, size_t arc_count);
+
+#ifndef QCERT_REENTRANT
+/*
+ * The registry get_oid_name falls back on, or NULL. Reentrant builds have
+ * no installed registry: call oid_registry_name instead.
+ */
+extern const oid_registry_t *oid_registry_installed;
+void oid_registry_install(const oid_registry_t *registry);
+#endif
@@ -0,0 +1,129 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "stats.h"
+#include "trace.h"
+#include <string.h>
+
+static const char *const counter_names[STATS_COUNTER_COUNT] = {
+    "TLVs decoded",  "bytes skipped",   "OID name hits",
+    "OID name misses", "allocations",   "allocated bytes",
+    "block mallocs", "files read",      "bytes read",
+    "certs parsed",
+};
+
+static const char *const stage_names[STATS_STAGE_COUNT] = {
+    "read", "base64", "filter", "parse", "hash", "emit",
+};
+
+#ifdef QCERT_STATS_ENABLED
+#include <pthread.h>
+#include <time.h>
+
+__thread stats_block_t stats_thread;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;
+static stats_block_t *stats_live;
+static stats_t stats_retired;
+
+static void stats_add(stats_t *into, const stats_t *from) {
+  for (size_t i = 0; i < STATS_COUNTER_COUNT; i++) {
+    into->counters[i] += from->counters[i];
+  }
+  for (size_t i = 0; i < STATS_STAGE_COUNT; i++) {
+    into->stage_ns[i] += from->stage_ns[i];
+    into->stage_calls[i] += from->stage_calls[i];
+  }
+}
+
+/* Runs at thread exit: fold the block into the total and unlink it. */
+static void stats_retire(void *value) {
+  stats_block_t *block = value;
+  pthread_mutex_lock(&stats_lock);
+  stats_add(&stats_retired, &block->stats);
+  for (stats_block_t **p = &stats_live; *p; p = &(*p)->next) {
+    if (*p == block) {
+      *p = block->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&stats_lock);
+}
+
+static void stats_key_init(void) { pthread_key_create(&stats_key, stats_retire); }
+
+void stats_register(void) {
+  pthread_once(&stats_once, stats_key_init);
+  pthread_mutex_lock(&stats_lock);
+  stats_thread.registered = 1;
+  stats_thread.next = stats_live;
+  stats_live = &stats_thread;
+  pthread_mutex_unlock(&stats_lock);
+  pthread_setspecific(stats_key, &stats_thread);
+}
+
+uint64_t stats_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void stats_stage_end(stats_stage_t stage, uint64_t start_ns) {
+  if (trace_active) {
+    trace_span(stage_names[stage], start_ns, NULL);
+  }
+  stats_t *stats = stats_local();
+  stats->stage_ns[stage] += stats_now_ns() - start_ns;
+  stats->stage_calls[stage]++;
+}
+
+int stats_merge(stats_t *out) {
+  pthread_mutex_lock(&stats_lock);
+  *out = stats_retired;
+  for (stats_block_t *block = stats_live; block; block = block->next) {
+    stats_add(out, &block->stats);
+  }
+  pthread_mutex_unlock(&stats_lock);
+  return 1;
+}
+
+#else
+
+int stats_merge(stats_t *out) {
+  memset(out, 0, sizeof(stats_t));
+  return 0;
+}
+
+#endif
+
+void stats_print(FILE *out, const stats_t *stats) {
+  fprintf(out, "stats:\n");
+  for (size_t i = 0; i < STATS_COUNTER_COUNT; i++) {
+    fprintf(out, "  %-16s %llu\n", counter_names[i],
+            (unsigned long long)stats->counters[i]);
+  }
+
+  uint64_t lookups =
+      stats->counters[STATS_OID_HITS] + stats->counters[STATS_OID_MISSES];
+  if (lookups > 0) {
+    fprintf(out, "  %-16s %llu (%.1f%% hit)\n", "OID lookups",
+            (unsigned long long)lookups,
+            100.0 * (double)stats->counters[STATS_OID_HITS] /
+                (double)lookups);
+  }
+
+  uint64_t total = 0;
+  for (size_t i = 0; i < STATS_STAGE_COUNT; i++) {
+    total += stats->stage_ns[i];
+  }
+  fprintf(out, "  %-8s %12s %10s %10s %6s\n", "stage", "calls", "total ms",
+          "ns/call", "share");
+  for (size_t i = 0; i < STATS_STAGE_COUNT; i++) {
+    uint64_t calls = stats->stage_calls[i];
+    fprintf(out, "  %-8s %12llu %10.2f %10.0f %5.1f%%\n", stage_names[i],
+            (unsigned long long)calls, (double)stats->stage_ns[i] / 1e6,
+            calls ? (double)stats->stage_ns[i] / (double)calls : 0.0,
+            total ? 100.0 * (double)stats->stage_ns[i] / (double)total : 0.0);
+  }
+}
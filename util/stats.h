@@ -0,0 +1,93 @@
+#pragma once
+
+#include "../qcert_config.h"
+#include <stdint.h>
+#ifndef QCERT_NO_STDIO
+#include <stdio.h>
+#endif
+
+/*
+ * Hot-path counters and stage timers for --stats. Each thread counts into
+ * its own block, so the hot path is a plain add with no atomics; blocks are
+ * merged when the summary is printed and folded into a process total when
+ * their thread exits. Built with -DQCERT_STATS (the default host build;
+ * `make QCERT_STATS=0` turns it off). Without it, and always in the
+ * embedded profile, every macro below expands to nothing.
+ */
+#if defined(QCERT_STATS) && !defined(QCERT_REENTRANT)
+#define QCERT_STATS_ENABLED 1
+#endif
+
+typedef enum {
+  STATS_TLVS_DECODED,
+  STATS_BYTES_SKIPPED,
+  STATS_OID_HITS,
+  STATS_OID_MISSES,
+  STATS_ALLOCATIONS,
+  STATS_ALLOCATED_BYTES,
+  STATS_BLOCK_MALLOCS,
+  STATS_FILES_READ,
+  STATS_BYTES_READ,
+  STATS_CERTS_PARSED,
+  STATS_COUNTER_COUNT
+} stats_counter_t;
+
+typedef enum {
+  STATS_STAGE_READ,
+  STATS_STAGE_BASE64,
+  STATS_STAGE_FILTER,
+  STATS_STAGE_PARSE,
+  STATS_STAGE_HASH,
+  STATS_STAGE_EMIT,
+  STATS_STAGE_COUNT
+} stats_stage_t;
+
+typedef struct {
+  uint64_t counters[STATS_COUNTER_COUNT];
+  uint64_t stage_ns[STATS_STAGE_COUNT];
+  uint64_t stage_calls[STATS_STAGE_COUNT];
+} stats_t;
+
+#ifdef QCERT_STATS_ENABLED
+
+typedef struct stats_block {
+  stats_t stats;
+  int registered;
+  struct stats_block *next;
+} stats_block_t;
+
+extern __thread stats_block_t stats_thread;
+
+void stats_register(void);
+uint64_t stats_now_ns(void);
+/* Adds the stage's time and, under --trace, records it as a span. */
+void stats_stage_end(stats_stage_t stage, uint64_t start_ns);
+
+static inline stats_t *stats_local(void) {
+  if (!stats_thread.registered) {
+    stats_register();
+  }
+  return &stats_thread.stats;
+}
+
+#define STATS_ADD(counter, n) (stats_local()->counters[counter] += (n))
+#define STATS_STAGE_BEGIN(var) uint64_t var = stats_now_ns()
+#define STATS_STAGE_END(stage, var) stats_stage_end(stage, var)
+
+#else
+
+#define STATS_ADD(counter, n) ((void)sizeof((counter) + (n)))
+#define STATS_STAGE_BEGIN(var)
+#define STATS_STAGE_END(stage, var) ((void)0)
+
+#endif
+
+#ifndef QCERT_NO_STDIO
+/*
+ * Sums the totals of exited threads and the live blocks of running ones.
+ * Counts of threads still working are read without synchronisation, so call
+ * it once workers have been joined. Returns 0 when stats are compiled out.
+ */
+int stats_merge(stats_t *out);
+void stats_print(FILE *out, const stats_t *stats);
+#endif
@@ -0,0 +1,193 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef QCERT_STATS_ENABLED
+#include <pthread.h>
+
+typedef struct {
+  const char *name;
+  uint64_t start_ns;
+  uint64_t dur_ns;
+  uint32_t tid;
+  char detail[TRACE_DETAIL_MAX];
+} trace_event_t;
+
+typedef struct trace_ring {
+  trace_event_t events[TRACE_RING_EVENTS];
+  uint64_t head;
+  bool in_use;
+  struct trace_ring *next;
+} trace_ring_t;
+
+bool trace_active;
+
+static const char *trace_path;
+static uint64_t trace_origin;
+static uint32_t trace_next_tid;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+static trace_ring_t *trace_rings;
+
+static __thread trace_ring_t *thread_ring;
+static __thread uint32_t thread_tid;
+
+/* Runs at thread exit: the ring keeps its events but can be reused. */
+static void trace_release(void *value) {
+  trace_ring_t *ring = value;
+  pthread_mutex_lock(&trace_lock);
+  ring->in_use = false;
+  pthread_mutex_unlock(&trace_lock);
+}
+
+static void trace_key_init(void) {
+  pthread_key_create(&trace_key, trace_release);
+}
+
+static trace_ring_t *trace_attach(void) {
+  pthread_once(&trace_once, trace_key_init);
+  pthread_mutex_lock(&trace_lock);
+  trace_ring_t *ring = trace_rings;
+  while (ring && ring->in_use) {
+    ring = ring->next;
+  }
+  if (!ring) {
+    ring = calloc(1, sizeof(trace_ring_t));
+    if (ring) {
+      ring->next = trace_rings;
+      trace_rings = ring;
+    }
+  }
+  if (ring) {
+    ring->in_use = true;
+  }
+  thread_tid = ++trace_next_tid;
+  pthread_mutex_unlock(&trace_lock);
+
+  if (ring) {
+    pthread_setspecific(trace_key, ring);
+  }
+  thread_ring = ring;
+  return ring;
+}
+
+void trace_span(const char *name, uint64_t start_ns, const char *detail) {
+  uint64_t now = stats_now_ns();
+  trace_ring_t *ring = thread_ring ? thread_ring : trace_attach();
+  if (!ring) {
+    return;
+  }
+
+  trace_event_t *event = &ring->events[ring->head % TRACE_RING_EVENTS];
+  event->name = name;
+  event->start_ns = start_ns;
+  event->dur_ns = now - start_ns;
+  event->tid = thread_tid;
+  event->detail[0] = '\0';
+  if (detail) {
+    /* Keep the end of long paths; it names the file. */
+    size_t len = strlen(detail);
+    if (len >= TRACE_DETAIL_MAX) {
+      detail += len - (TRACE_DETAIL_MAX - 1);
+    }
+    strcpy(event->detail, detail);
+  }
+  ring->head++;
+}
+
+int trace_start(const char *path) {
+  trace_path = path;
+  trace_origin = stats_now_ns();
+  trace_active = true;
+  /* The calling thread takes tid 1, which the trace names "main". */
+  trace_attach();
+  return 0;
+}
+
+static void write_json_string(FILE *out, const char *str) {
+  fputc('"', out);
+  for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+    if (*p == '"' || *p == '\\') {
+      fprintf(out, "\\%c", *p);
+    } else if (*p < 0x20) {
+      fprintf(out, "\\u%04x", *p);
+    } else {
+      fputc(*p, out);
+    }
+  }
+  fputc('"', out);
+}
+
+int trace_finish(void) {
+  if (!trace_active) {
+    return 0;
+  }
+  trace_active = false;
+
+  FILE *out = fopen(trace_path, "w");
+  if (!out) {
+    perror(trace_path);
+    return -1;
+  }
+
+  pthread_mutex_lock(&trace_lock);
+  uint64_t dropped = 0;
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  for (uint32_t tid = 1; tid <= trace_next_tid; tid++) {
+    fprintf(out,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+            tid == 1 ? "" : ",\n", tid, tid == 1 ? "main" : "thread", tid);
+  }
+  for (trace_ring_t *ring = trace_rings; ring; ring = ring->next) {
+    uint64_t first = 0;
+    if (ring->head > TRACE_RING_EVENTS) {
+      first = ring->head - TRACE_RING_EVENTS;
+      dropped += first;
+    }
+    for (uint64_t i = first; i < ring->head; i++) {
+      const trace_event_t *event = &ring->events[i % TRACE_RING_EVENTS];
+      fprintf(out,
+              ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+              "\"ts\":%.3f,\"dur\":%.3f",
+              event->name, event->tid,
+              (double)(event->start_ns - trace_origin) / 1e3,
+              (double)event->dur_ns / 1e3);
+      if (event->detail[0]) {
+        fprintf(out, ",\"args\":{\"detail\":");
+        write_json_string(out, event->detail);
+        fputc('}', out);
+      }
+      fputc('}', out);
+    }
+  }
+  pthread_mutex_unlock(&trace_lock);
+
+  fprintf(out, "\n],\"otherData\":{\"dropped_spans\":%llu}}\n",
+          (unsigned long long)dropped);
+  if (fclose(out) != 0) {
+    perror(trace_path);
+    return -1;
+  }
+  if (dropped > 0) {
+    fprintf(stderr, "trace: %llu oldest spans dropped; raise "
+                    "TRACE_RING_EVENTS to keep them\n",
+            (unsigned long long)dropped);
+  }
+  return 0;
+}
+
+#else
+
+int trace_start(const char *path) {
+  (void)path;
+  return -1;
+}
+
+int trace_finish(void) { return 0; }
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "stats.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Chrome trace-event export for --trace. Each thread appends complete
+ * ("ph":"X") spans to its own ring of TRACE_RING_EVENTS entries without
+ * locks; when a ring wraps the oldest spans are overwritten and counted as
+ * dropped. Rings outlive their threads and are handed to new threads, so
+ * short-lived workers do not each cost a ring. trace_finish writes every
+ * ring as JSON that chrome://tracing and Perfetto open directly.
+ *
+ * Part of the QCERT_STATS instrumentation: stage spans come from
+ * STATS_STAGE_END, and without QCERT_STATS everything here is compiled out.
+ */
+#ifndef TRACE_RING_EVENTS
+#define TRACE_RING_EVENTS 32768
+#endif
+#define TRACE_DETAIL_MAX 48
+
+#ifdef QCERT_STATS_ENABLED
+
+extern bool trace_active;
+
+/* Records a span from start_ns to now; detail may be NULL. */
+void trace_span(const char *name, uint64_t start_ns, const char *detail);
+
+#define TRACE_BEGIN(var) uint64_t var = trace_active ? stats_now_ns() : 0
+#define TRACE_END(var, name, detail)                                           \
+  do {                                                                         \
+    if (trace_active) {                                                        \
+      trace_span(name, var, detail);                                           \
+    }                                                                          \
+  } while (0)
+
+#else
+
+#define TRACE_BEGIN(var)
+#define TRACE_END(var, name, detail) ((void)0)
+
+#endif
+
+#ifndef QCERT_EMBEDDED
+/* Returns -1 when instrumentation is compiled out. */
+int trace_start(const char *path);
+/* Writes the trace; call once workers have been joined. */
+int trace_finish(void);
+#endif
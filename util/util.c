@@ -1,5 +1,19 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "util.h"
+#include "stats.h"
+#include <stdlib.h>
+#ifndef QCERT_REENTRANT
+#include "oids.h"
+#endif
+#ifndef QCERT_EMBEDDED
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
+#ifndef QCERT_NO_STDIO
 void print_oid(const uint32_t *oid, size_t oid_len) {
   for (size_t i = 0; i < oid_len; i++) {
     printf("%u", oid[i]);
@@ -16,7 +30,9 @@ void print_oid_with_name(const uint32_t *oid, size_t oid_len) {
     printf(" (%s)", name);
   }
 }
-const char *get_oid_name(const uint32_t *oid, size_t oid_len) {
+#endif
+
+static const char *oid_name(const uint32_t *oid, size_t oid_len) {
   if (oid_len == 7 && oid[0] == 1 && oid[1] == 2 && oid[2] == 840 &&
       oid[3] == 113549 && oid[4] == 1 && oid[5] == 1) {
     switch (oid[6]) {
@@ -33,12 +49,12 @@ const char *get_oid_name(const uint32_t *oid, size_t oid_len) {
     }
   }
 
-  if (oid_len == 7 && oid[0] == 1 && oid[1] == 2 && oid[2] == 840 &&
+  if (oid_len == 6 && oid[0] == 1 && oid[1] == 2 && oid[2] == 840 &&
       oid[3] == 10045 && oid[4] == 2 && oid[5] == 1) {
     return "Elliptic Curve Public Key";
   }
 
-  if (oid_len == 8 && oid[0] == 1 && oid[1] == 2 && oid[2] == 840 &&
+  if (oid_len == 7 && oid[0] == 1 && oid[1] == 2 && oid[2] == 840 &&
       oid[3] == 10045 && oid[4] == 4 && oid[5] == 3) {
     switch (oid[6]) {
     case 2:
@@ -71,8 +87,9 @@ const char *get_oid_name(const uint32_t *oid, size_t oid_len) {
     }
   }
 
-  if (oid_len == 8 && oid[0] == 1 && oid[1] == 3 && oid[2] == 6 &&
-      oid[3] == 1 && oid[4] == 5 && oid[5] == 5 && oid[6] == 7 && oid[7] == 1) {
+  if (oid_len == 9 && oid[0] == 1 && oid[1] == 3 && oid[2] == 6 &&
+      oid[3] == 1 && oid[4] == 5 && oid[5] == 5 && oid[6] == 7 &&
+      oid[7] == 1 && oid[8] == 1) {
     return "Authority Information Access";
   }
 
@@ -85,6 +102,20 @@ const char *get_oid_name(const uint32_t *oid, size_t oid_len) {
   return NULL;
 }
 
+const char *get_oid_name(const uint32_t *oid, size_t oid_len) {
+  const char *name = oid_name(oid, oid_len);
+#ifndef QCERT_REENTRANT
+  if (!name && oid_registry_installed) {
+    const oid_entry_t *entry =
+        oid_registry_lookup(oid_registry_installed, oid, oid_len);
+    name = entry ? entry->name : NULL;
+  }
+#endif
+  STATS_ADD(name ? STATS_OID_HITS : STATS_OID_MISSES, 1);
+  return name;
+}
+
+#ifndef QCERT_NO_STDIO
 void print_hex(const uint8_t *data, size_t len) {
   for (size_t i = 0; i < len; i++) {
     printf("%02x", data[i]);
@@ -99,4 +130,103 @@ void print_hex(const uint8_t *data, size_t len) {
   if (len % 16 != 0) {
     printf("\n");
   }
-}
\ No newline at end of file
+}
+#endif
+
+uint64_t hash64(const uint8_t *data, size_t len) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+void hex_to_string(const uint8_t *data, size_t len, char *out) {
+  static const char digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < len; i++) {
+    out[i * 2] = digits[data[i] >> 4];
+    out[i * 2 + 1] = digits[data[i] & 0x0F];
+  }
+  out[len * 2] = '\0';
+}
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+int hex_from_string(const char *hex, uint8_t *out, size_t max_len) {
+  size_t out_len = 0;
+
+  while (*hex) {
+    if (*hex == ':' || *hex == ' ') {
+      hex++;
+      continue;
+    }
+
+    int hi = hex_digit(hex[0]);
+    int lo = hex[1] ? hex_digit(hex[1]) : -1;
+    if (hi < 0 || lo < 0 || out_len >= max_len) {
+      return -1;
+    }
+
+    out[out_len++] = (uint8_t)((hi << 4) | lo);
+    hex += 2;
+  }
+
+  return (int)out_len;
+}
+
+#ifndef QCERT_EMBEDDED
+uint8_t *read_file(const char *filename, size_t *size) {
+  STATS_STAGE_BEGIN(start);
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t file_size = (size_t)st.st_size;
+  uint8_t *buffer = malloc(file_size + 1);
+  if (!buffer) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t done = 0;
+  while (done < file_size) {
+    ssize_t n = read(fd, buffer + done, file_size - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      close(fd);
+      free(buffer);
+      return NULL;
+    }
+    done += (size_t)n;
+  }
+  close(fd);
+
+  buffer[file_size] = '\0';
+  *size = file_size;
+  STATS_ADD(STATS_FILES_READ, 1);
+  STATS_ADD(STATS_BYTES_READ, file_size);
+  STATS_STAGE_END(STATS_STAGE_READ, start);
+  return buffer;
+}
+#endif
@@ -1,10 +1,22 @@
 #pragma once
 
+#include "../qcert_config.h"
 #include <stddef.h>
 #include <stdint.h>
+#ifndef QCERT_NO_STDIO
 #include <stdio.h>
+#endif
 
 const char *get_oid_name(const uint32_t *oid, size_t oid_len);
+#ifndef QCERT_NO_STDIO
 void print_oid(const uint32_t *oid, size_t oid_len);
 void print_oid_with_name(const uint32_t *oid, size_t oid_len);
-void print_hex(const uint8_t *data, size_t len);
\ No newline at end of file
+void print_hex(const uint8_t *data, size_t len);
+#endif
+
+uint64_t hash64(const uint8_t *data, size_t len);
+void hex_to_string(const uint8_t *data, size_t len, char *out);
+int hex_from_string(const char *hex, uint8_t *out, size_t max_len);
+#ifndef QCERT_EMBEDDED
+uint8_t *read_file(const char *filename, size_t *size);
+#endif
@@ -1,49 +1,180 @@
 #include "x509.h"
 #include "../der/der.h"
-
-void parse_version(der_ctx_t *ctx) {
-  uint8_t tag;
-  if (der_peek_tag(ctx, &tag) == DER_OK && (tag & 0xE0) == 0xA0) {
-    der_tlv_t tlv;
-    if (der_decode_tlv(ctx, &tlv) == DER_OK) {
-      printf("  Version: ");
-      if (tlv.length >= 3 && tlv.value[0] == DER_TAG_INTEGER) {
-        size_t int_len = tlv.value[1];
-        if (int_len > 0 && int_len <= 4) {
-          uint32_t version = 0;
-          for (size_t i = 0; i < int_len; i++) {
-            version = (version << 8) | tlv.value[2 + i];
-          }
-          printf("v%u (0x%x)\n", version + 1, version);
-        } else {
-          printf("(invalid)\n");
-        }
-      }
-    }
-  } else {
-    printf("  Version: v1 (default)\n");
-  }
-}
-
-void parse_serial_number(der_ctx_t *ctx) {
-  uint8_t serial[64];
-  size_t serial_len = sizeof(serial);
-
-  if (der_decode_integer(ctx, serial, &serial_len, sizeof(serial)) == DER_OK) {
-    printf("  Serial Number: ");
-    print_hex(serial, serial_len);
-    printf("\n");
-  }
-}
-
-void parse_algorithm_identifier(der_ctx_t *ctx, const char *name) {
+#include "../der/der_utils.h"
+#include "../util/stats.h"
+
+#ifndef QCERT_REENTRANT
+#include "../util/oids.h"
+#endif
+
+/* Time ::= CHOICE { utcTime UTCTime, generalTime GeneralizedTime } */
+static const der_template_t not_before_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_UTC_TIME,
+     .store = DER_STORE_CONVERT, .offset = offsetof(x509_cert_t, not_before),
+     .convert = x509_time_convert},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_GENERALIZED_TIME,
+     .store = DER_STORE_CONVERT, .offset = offsetof(x509_cert_t, not_before),
+     .convert = x509_time_convert},
+    DER_TEMPLATE_END,
+};
+
+static const der_template_t not_after_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_UTC_TIME,
+     .store = DER_STORE_CONVERT, .offset = offsetof(x509_cert_t, not_after),
+     .convert = x509_time_convert},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_GENERALIZED_TIME,
+     .store = DER_STORE_CONVERT, .offset = offsetof(x509_cert_t, not_after),
+     .convert = x509_time_convert},
+    DER_TEMPLATE_END,
+};
+
+/* Validity ::= SEQUENCE { notBefore Time, notAfter Time } */
+static const der_template_t validity_template[] = {
+    {.kind = DER_TMPL_CHOICE, .field = X509_FIELD_VALIDITY,
+     .children = not_before_template},
+    {.kind = DER_TMPL_CHOICE, .field = X509_FIELD_VALIDITY,
+     .children = not_after_template},
+    DER_TEMPLATE_END,
+};
+
+/* version [0] EXPLICIT INTEGER DEFAULT v1 */
+static const der_template_t version_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_INTEGER,
+     .store = DER_STORE_UINT32, .field = X509_FIELD_VERSION,
+     .offset = offsetof(x509_cert_t, version)},
+    DER_TEMPLATE_END,
+};
+
+static const der_template_t tbs_template[] = {
+    {.kind = DER_TMPL_CONSTRUCTED,
+     .tag = DER_CLASS_CONTEXT | DER_CONSTRUCTED | 0,
+     .flags = DER_TMPL_OPTIONAL, .field = X509_FIELD_VERSION,
+     .children = version_template},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_INTEGER,
+     .store = DER_STORE_VALUE, .field = X509_FIELD_SERIAL,
+     .offset = offsetof(x509_cert_t, serial)},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_SEQUENCE,
+     .store = DER_STORE_TLV, .field = X509_FIELD_SIGNATURE_ALGORITHM,
+     .offset = offsetof(x509_cert_t, signature_algorithm)},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_SEQUENCE,
+     .store = DER_STORE_TLV, .field = X509_FIELD_ISSUER,
+     .offset = offsetof(x509_cert_t, issuer)},
+    {.kind = DER_TMPL_CONSTRUCTED, .tag = DER_TAG_SEQUENCE,
+     .store = DER_STORE_TLV, .field = X509_FIELD_VALIDITY,
+     .offset = offsetof(x509_cert_t, validity), .children = validity_template},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_SEQUENCE,
+     .store = DER_STORE_TLV, .field = X509_FIELD_SUBJECT,
+     .offset = offsetof(x509_cert_t, subject)},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_SEQUENCE,
+     .store = DER_STORE_TLV, .field = X509_FIELD_PUBLIC_KEY,
+     .offset = offsetof(x509_cert_t, public_key_info)},
+    /* issuerUniqueID [1] and subjectUniqueID [2] IMPLICIT BIT STRING */
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_CLASS_CONTEXT | 1,
+     .flags = DER_TMPL_OPTIONAL},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_CLASS_CONTEXT | 2,
+     .flags = DER_TMPL_OPTIONAL},
+    /* extensions [3] EXPLICIT Extensions; decoded per OID afterwards */
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_CLASS_CONTEXT | DER_CONSTRUCTED | 3,
+     .flags = DER_TMPL_OPTIONAL, .store = DER_STORE_VALUE,
+     .field = X509_EXTENSION_FIELDS,
+     .offset = offsetof(x509_cert_t, extensions)},
+    DER_TEMPLATE_END,
+};
+
+/* Certificate ::= SEQUENCE { tbsCertificate, signatureAlgorithm, signature } */
+static const der_template_t certificate_fields_template[] = {
+    {.kind = DER_TMPL_CONSTRUCTED, .tag = DER_TAG_SEQUENCE,
+     .store = DER_STORE_TLV, .offset = offsetof(x509_cert_t, tbs),
+     .children = tbs_template},
+    DER_TEMPLATE_END,
+};
+
+static const der_template_t certificate_template[] = {
+    {.kind = DER_TMPL_CONSTRUCTED, .tag = DER_TAG_SEQUENCE,
+     .children = certificate_fields_template},
+    DER_TEMPLATE_END,
+};
+
+static const der_template_t subject_key_id_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_OCTET_STRING,
+     .store = DER_STORE_VALUE, .offset = offsetof(x509_cert_t, subject_key_id)},
+    DER_TEMPLATE_END,
+};
+
+/* AuthorityKeyIdentifier ::= SEQUENCE { keyIdentifier [0] OPTIONAL, ... } */
+static const der_template_t authority_key_id_fields_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_CLASS_CONTEXT | 0,
+     .flags = DER_TMPL_OPTIONAL, .store = DER_STORE_VALUE,
+     .offset = offsetof(x509_cert_t, authority_key_id)},
+    DER_TEMPLATE_END,
+};
+
+static const der_template_t authority_key_id_template[] = {
+    {.kind = DER_TMPL_CONSTRUCTED, .tag = DER_TAG_SEQUENCE,
+     .children = authority_key_id_fields_template},
+    DER_TEMPLATE_END,
+};
+
+/* SubjectAltName ::= SEQUENCE OF GeneralName; only dNSName [2] is kept. */
+static const der_template_t san_template[] = {
+    {.kind = DER_TMPL_SEQUENCE_OF, .tag = DER_TAG_SEQUENCE,
+     .store = DER_STORE_VALUE, .offset = offsetof(x509_cert_t, san),
+     .count_offset = offsetof(x509_cert_t, san_count), .max = X509_MAX_SANS,
+     .item_tag = DER_CLASS_CONTEXT | 2},
+    DER_TEMPLATE_END,
+};
+
+/*
+ * Extension contents with extnValue opened as a container, so the value is
+ * decoded in the same pass as the OID and critical flag that precede it.
+ */
+static const der_template_t subject_key_id_extension[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_OID},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_BOOLEAN,
+     .flags = DER_TMPL_OPTIONAL},
+    {.kind = DER_TMPL_CONSTRUCTED, .tag = DER_TAG_OCTET_STRING,
+     .children = subject_key_id_template},
+    DER_TEMPLATE_END,
+};
+
+static const der_template_t san_extension[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_OID},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_BOOLEAN,
+     .flags = DER_TMPL_OPTIONAL},
+    {.kind = DER_TMPL_CONSTRUCTED, .tag = DER_TAG_OCTET_STRING,
+     .children = san_template},
+    DER_TEMPLATE_END,
+};
+
+static const der_template_t authority_key_id_extension[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_OID},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_BOOLEAN,
+     .flags = DER_TMPL_OPTIONAL},
+    {.kind = DER_TMPL_CONSTRUCTED, .tag = DER_TAG_OCTET_STRING,
+     .children = authority_key_id_template},
+    DER_TEMPLATE_END,
+};
+
+/* id-ce extensions (2.5.29.n) by their last arc. */
+static const struct {
+  uint8_t arc;
+  uint32_t field;
+  const der_template_t *tmpl;
+} extension_templates[] = {
+    {14, X509_FIELD_SUBJECT_KEY_ID, subject_key_id_extension},
+    {17, X509_FIELD_SAN, san_extension},
+    {35, X509_FIELD_AUTHORITY_KEY_ID, authority_key_id_extension},
+};
+
+#ifndef QCERT_NO_STDIO
+static void parse_algorithm_identifier(der_ctx_t *ctx, const char *name) {
   size_t seq_len;
   if (der_decode_sequence_header(ctx, &seq_len) == DER_OK) {
     printf("  %s:\n", name);
 
-    uint32_t oid[16];
-    size_t oid_len = 16;
-    if (der_decode_oid(ctx, oid, &oid_len, 16) == DER_OK) {
+    uint32_t oid[QCERT_MAX_OID_ARCS];
+    size_t oid_len = QCERT_MAX_OID_ARCS;
+    if (der_decode_oid(ctx, oid, &oid_len, QCERT_MAX_OID_ARCS) == DER_OK) {
       printf("    Algorithm: ");
       print_oid_with_name(oid, oid_len);
       printf("\n");
@@ -56,7 +187,7 @@ void parse_algorithm_identifier(der_ctx_t *ctx, const char *name) {
   }
 }
 
-void parse_name(der_ctx_t *ctx, const char *name_type) {
+static void parse_name(der_ctx_t *ctx, const char *name_type) {
   size_t seq_len;
   if (der_decode_sequence_header(ctx, &seq_len) == DER_OK) {
     printf("  %s:\n", name_type);
@@ -68,9 +199,9 @@ void parse_name(der_ctx_t *ctx, const char *name_type) {
       if (der_decode_set_header(ctx, &set_len) == DER_OK) {
         size_t seq2_len;
         if (der_decode_sequence_header(ctx, &seq2_len) == DER_OK) {
-          uint32_t oid[16];
-          size_t oid_len = 16;
-          if (der_decode_oid(ctx, oid, &oid_len, 16) == DER_OK) {
+          uint32_t oid[QCERT_MAX_OID_ARCS];
+          size_t oid_len = QCERT_MAX_OID_ARCS;
+          if (der_decode_oid(ctx, oid, &oid_len, QCERT_MAX_OID_ARCS) == DER_OK) {
             printf("    ");
 
             if (oid_len == 4 && oid[0] == 2 && oid[1] == 5 && oid[2] == 4) {
@@ -105,7 +236,7 @@ void parse_name(der_ctx_t *ctx, const char *name_type) {
 
             uint8_t tag;
             if (der_peek_tag(ctx, &tag) == DER_OK) {
-              char value[256];
+              char value[QCERT_MAX_NAME_VALUE];
               size_t value_len = sizeof(value) - 1;
 
               if (tag == DER_TAG_UTF8_STRING) {
@@ -133,7 +264,7 @@ void parse_name(der_ctx_t *ctx, const char *name_type) {
   }
 }
 
-void parse_validity(der_ctx_t *ctx) {
+static void parse_validity(der_ctx_t *ctx) {
   size_t seq_len;
   if (der_decode_sequence_header(ctx, &seq_len) == DER_OK) {
     printf("  Validity:\n");
@@ -141,7 +272,6 @@ void parse_validity(der_ctx_t *ctx) {
     uint8_t tag;
     if (der_peek_tag(ctx, &tag) == DER_OK) {
       char time_str[32];
-      size_t time_len = sizeof(time_str) - 1;
 
       printf("    Not Before: ");
       if (tag == DER_TAG_UTC_TIME || tag == DER_TAG_GENERALIZED_TIME) {
@@ -162,7 +292,6 @@ void parse_validity(der_ctx_t *ctx) {
 
     if (der_peek_tag(ctx, &tag) == DER_OK) {
       char time_str[32];
-      size_t time_len = sizeof(time_str) - 1;
 
       printf("    Not After: ");
       if (tag == DER_TAG_UTC_TIME || tag == DER_TAG_GENERALIZED_TIME) {
@@ -183,16 +312,13 @@ void parse_validity(der_ctx_t *ctx) {
   }
 }
 
-void parse_public_key_info(der_ctx_t *ctx) {
+static void parse_public_key_info(der_ctx_t *ctx) {
   size_t seq_len;
   if (der_decode_sequence_header(ctx, &seq_len) == DER_OK) {
     printf("  Public Key Info:\n");
 
     parse_algorithm_identifier(ctx, "Public Key Algorithm");
 
-    uint8_t bit_string[512];
-    size_t bit_string_len = sizeof(bit_string);
-
     uint8_t tag;
     if (der_peek_tag(ctx, &tag) == DER_OK && tag == DER_TAG_BIT_STRING) {
       der_tlv_t tlv;
@@ -208,89 +334,500 @@ void parse_public_key_info(der_ctx_t *ctx) {
   }
 }
 
-void parse_extensions(der_ctx_t *ctx) {
-  uint8_t tag;
-  if (der_peek_tag(ctx, &tag) == DER_OK && (tag & 0xE0) == 0xA0) {
-    der_tlv_t ext_tlv;
-    if (der_decode_tlv(ctx, &ext_tlv) == DER_OK) {
-      printf("  Extensions:\n");
-
-      der_ctx_t ext_ctx;
-      der_init(&ext_ctx, (uint8_t *)ext_tlv.value, ext_tlv.length);
-
-      size_t ext_seq_len;
-      if (der_decode_sequence_header(&ext_ctx, &ext_seq_len) == DER_OK) {
-        size_t end_pos = der_get_position(&ext_ctx) + ext_seq_len;
-
-        while (der_get_position(&ext_ctx) < end_pos) {
-          size_t ext_len;
-          if (der_decode_sequence_header(&ext_ctx, &ext_len) == DER_OK) {
-            uint32_t ext_oid[16];
-            size_t ext_oid_len = 16;
-            if (der_decode_oid(&ext_ctx, ext_oid, &ext_oid_len, 16) == DER_OK) {
-              printf("    Extension: ");
-              print_oid_with_name(ext_oid, ext_oid_len);
-              printf("\n");
-
-              uint8_t next_tag;
-              if (der_peek_tag(&ext_ctx, &next_tag) == DER_OK &&
-                  next_tag == DER_TAG_BOOLEAN) {
-                bool critical;
-                if (der_decode_boolean(&ext_ctx, &critical) == DER_OK) {
-                  printf("      Critical: %s\n", critical ? "true" : "false");
-                }
-              }
+typedef struct {
+  x509_span_t oid;
+  x509_span_t critical;
+  x509_span_t value;
+} x509_extension_t;
+
+/* Extension ::= SEQUENCE { extnID, critical BOOLEAN DEFAULT FALSE, extnValue } */
+static const der_template_t extension_template[] = {
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_OID, .store = DER_STORE_TLV,
+     .offset = offsetof(x509_extension_t, oid)},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_BOOLEAN,
+     .flags = DER_TMPL_OPTIONAL, .store = DER_STORE_VALUE,
+     .offset = offsetof(x509_extension_t, critical)},
+    {.kind = DER_TMPL_ELEMENT, .tag = DER_TAG_OCTET_STRING,
+     .store = DER_STORE_VALUE, .offset = offsetof(x509_extension_t, value)},
+    DER_TEMPLATE_END,
+};
+
+static void parse_extensions(der_ctx_t *ctx) {
+  size_t seq_len;
+  if (der_decode_sequence_header(ctx, &seq_len) != DER_OK) {
+    return;
+  }
+  printf("  Extensions:\n");
 
-              if (der_peek_tag(&ext_ctx, &next_tag) == DER_OK &&
-                  next_tag == DER_TAG_OCTET_STRING) {
-                der_tlv_t val_tlv;
-                if (der_decode_tlv(&ext_ctx, &val_tlv) == DER_OK) {
-                  printf("      Value: (%zu bytes)\n", val_tlv.length);
-                }
-              }
-            }
-          }
-        }
-      }
+  while (der_get_remaining(ctx) > 0) {
+    der_tlv_t item;
+    if (der_decode_tlv(ctx, &item) != DER_OK) {
+      return;
+    }
+
+    x509_extension_t ext = {0};
+    if (der_template_decode(extension_template, item.value, item.length,
+                            DER_TEMPLATE_ALL, &ext) != DER_OK) {
+      continue;
     }
+
+    der_ctx_t oid_ctx;
+    der_init(&oid_ctx, (uint8_t *)ext.oid.data, ext.oid.len);
+    uint32_t oid[QCERT_MAX_OID_ARCS];
+    size_t oid_len = QCERT_MAX_OID_ARCS;
+    if (der_decode_oid(&oid_ctx, oid, &oid_len, QCERT_MAX_OID_ARCS) != DER_OK) {
+      continue;
+    }
+    printf("    Extension: ");
+    print_oid_with_name(oid, oid_len);
+    printf("\n");
+
+    if (ext.critical.data) {
+      bool critical = ext.critical.len == 1 && ext.critical.data[0] != 0;
+      printf("      Critical: %s\n", critical ? "true" : "false");
+    }
+    printf("      Value: (%zu bytes)\n", ext.value.len);
+
+#ifndef QCERT_REENTRANT
+    const oid_entry_t *entry =
+        oid_registry_installed
+            ? oid_registry_lookup(oid_registry_installed, oid, oid_len)
+            : NULL;
+    char text[QCERT_MAX_NAME_VALUE];
+    if (entry && entry->format &&
+        entry->format(ext.value.data, ext.value.len, text, sizeof(text),
+                      entry->arg) == DER_OK) {
+      printf("      Decoded: %s\n", text);
+    }
+#endif
   }
 }
 
-void parse_certificate(const uint8_t *der_data, size_t der_len) {
+static void print_section(x509_span_t span,
+                          void (*printer)(der_ctx_t *, const char *),
+                          const char *label) {
   der_ctx_t ctx;
-  der_init(&ctx, (uint8_t *)der_data, der_len);
+  der_init(&ctx, (uint8_t *)span.data, span.len);
+  printer(&ctx, label);
+}
+
+void parse_certificate(const uint8_t *der_data, size_t der_len) {
+  parse_certificate_fields(der_data, der_len, X509_FIELD_ALL);
+}
 
+void parse_certificate_fields(const uint8_t *der_data, size_t der_len,
+                              uint32_t fields) {
   printf("X.509 Certificate:\n");
 
-  size_t cert_len;
-  if (der_decode_sequence_header(&ctx, &cert_len) != DER_OK) {
-    printf("Failed to parse certificate SEQUENCE\n");
+  /* Printing walks the extensions itself, so none are decoded here. */
+  x509_cert_t cert;
+  der_error_t err = x509_extract_fields(
+      der_data, der_len,
+      fields & ~(X509_FIELD_SUBJECT_KEY_ID | X509_FIELD_AUTHORITY_KEY_ID |
+                 X509_FIELD_SAN),
+      &cert);
+  if (err != DER_OK) {
+    printf("Failed to parse certificate: %s\n", der_error_to_string(err));
     return;
   }
 
-  size_t tbs_len;
-  if (der_decode_sequence_header(&ctx, &tbs_len) != DER_OK) {
-    printf("Failed to parse TBSCertificate SEQUENCE\n");
-    return;
+  printf("TBSCertificate:\n");
+
+  if (fields & X509_FIELD_VERSION) {
+    /* DER omits a DEFAULT value, so v1 is never encoded explicitly. */
+    if (cert.version == 0) {
+      printf("  Version: v1 (default)\n");
+    } else {
+      printf("  Version: v%u (0x%x)\n", cert.version + 1, cert.version);
+    }
   }
 
-  printf("TBSCertificate:\n");
+  if (fields & X509_FIELD_SERIAL) {
+    printf("  Serial Number: ");
+    print_hex(cert.serial.data, cert.serial.len);
+    printf("\n");
+  }
+
+  if (fields & X509_FIELD_SIGNATURE_ALGORITHM) {
+    print_section(cert.signature_algorithm, parse_algorithm_identifier,
+                  "Signature Algorithm");
+  }
+  if (fields & X509_FIELD_ISSUER) {
+    print_section(cert.issuer, parse_name, "Issuer");
+  }
+  if (fields & X509_FIELD_VALIDITY) {
+    der_ctx_t ctx;
+    der_init(&ctx, (uint8_t *)cert.validity.data, cert.validity.len);
+    parse_validity(&ctx);
+  }
+  if (fields & X509_FIELD_SUBJECT) {
+    print_section(cert.subject, parse_name, "Subject");
+  }
+  if (fields & X509_FIELD_PUBLIC_KEY) {
+    der_ctx_t ctx;
+    der_init(&ctx, (uint8_t *)cert.public_key_info.data,
+             cert.public_key_info.len);
+    parse_public_key_info(&ctx);
+  }
+  if ((fields & X509_FIELD_EXTENSIONS) && cert.extensions.data) {
+    der_ctx_t ctx;
+    der_init(&ctx, (uint8_t *)cert.extensions.data, cert.extensions.len);
+    parse_extensions(&ctx);
+  }
+
+  printf("\nCertificate parsed successfully!\n");
+}
+#endif
+
+static int64_t days_from_civil(int64_t year, int64_t month, int64_t day) {
+  year -= month <= 2;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  int64_t yoe = year - era * 400;
+  int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
 
-  parse_version(&ctx);
+static bool parse_digits(const uint8_t *p, size_t n, int64_t *out) {
+  *out = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (p[i] < '0' || p[i] > '9') {
+      return false;
+    }
+    *out = *out * 10 + (p[i] - '0');
+  }
+  return true;
+}
 
-  parse_serial_number(&ctx);
+der_error_t x509_parse_time(uint8_t tag, const uint8_t *value, size_t len,
+                            int64_t *time) {
+  if (!value || !time) {
+    return DER_ERROR_NULL_POINTER;
+  }
 
-  parse_algorithm_identifier(&ctx, "Signature Algorithm");
+  int64_t year;
+  size_t pos;
+  if (tag == DER_TAG_UTC_TIME && len >= 13) {
+    if (!parse_digits(value, 2, &year)) {
+      return DER_ERROR_INVALID_DATA;
+    }
+    year += year < 50 ? 2000 : 1900;
+    pos = 2;
+  } else if (tag == DER_TAG_GENERALIZED_TIME && len >= 15) {
+    if (!parse_digits(value, 4, &year)) {
+      return DER_ERROR_INVALID_DATA;
+    }
+    pos = 4;
+  } else {
+    return DER_ERROR_INVALID_DATA;
+  }
 
-  parse_name(&ctx, "Issuer");
+  int64_t month, day, hour, minute, second;
+  if (!parse_digits(value + pos, 2, &month) ||
+      !parse_digits(value + pos + 2, 2, &day) ||
+      !parse_digits(value + pos + 4, 2, &hour) ||
+      !parse_digits(value + pos + 6, 2, &minute) ||
+      !parse_digits(value + pos + 8, 2, &second)) {
+    return DER_ERROR_INVALID_DATA;
+  }
 
-  parse_validity(&ctx);
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 ||
+      minute > 59 || second > 60) {
+    return DER_ERROR_INVALID_DATA;
+  }
 
-  parse_name(&ctx, "Subject");
+  *time = days_from_civil(year, month, day) * 86400 + hour * 3600 +
+          minute * 60 + second;
+  return DER_OK;
+}
 
-  parse_public_key_info(&ctx);
+der_error_t x509_time_convert(const der_tlv_t *tlv, void *time) {
+  return x509_parse_time(tlv->tag, tlv->value, tlv->length, time);
+}
 
-  parse_extensions(&ctx);
+static int64_t civil_from_time(int64_t time, int64_t *month, int64_t *day,
+                               int64_t *secs) {
+  int64_t days = time >= 0 ? time / 86400 : (time - 86399) / 86400;
+  *secs = time - days * 86400;
+
+  int64_t z = days + 719468;
+  int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  int64_t doe = z - era * 146097;
+  int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int64_t mp = (5 * doy + 2) / 153;
+  *day = doy - (153 * mp + 2) / 5 + 1;
+  *month = mp < 10 ? mp + 3 : mp - 9;
+  return yoe + era * 400 + (*month <= 2);
+}
 
-  printf("\nCertificate parsed successfully!\n");
+der_error_t x509_encode_time(int64_t time, uint8_t *out, size_t size,
+                             size_t *len) {
+  if (!out || !len) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  int64_t month, day, secs;
+  int64_t year = civil_from_time(time, &month, &day, &secs);
+  if (year < 0 || year > 9999) {
+    return DER_ERROR_OVERFLOW;
+  }
+
+  /* RFC 5280 4.1.2.5: UTCTime through 2049, GeneralizedTime after. */
+  bool utc = year >= 1950 && year < 2050;
+  size_t digits = utc ? 12 : 14;
+  if (size < digits + 3) {
+    return DER_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  int64_t parts[] = {year, month, day, secs / 3600, secs / 60 % 60, secs % 60};
+  uint8_t *p = out + 2 + digits;
+  *p = 'Z';
+  for (size_t i = 6; i-- > 0;) {
+    int64_t value = parts[i];
+    for (size_t n = i == 0 ? digits - 10 : 2; n > 0; n--) {
+      *--p = (uint8_t)('0' + value % 10);
+      value /= 10;
+    }
+  }
+  out[0] = utc ? DER_TAG_UTC_TIME : DER_TAG_GENERALIZED_TIME;
+  out[1] = (uint8_t)(digits + 1);
+  *len = digits + 3;
+  return DER_OK;
+}
+
+void x509_format_time(int64_t time, char *buf, size_t size) {
+  int64_t month, day, secs;
+  int64_t year = civil_from_time(time, &month, &day, &secs);
+
+#ifdef QCERT_NO_STDIO
+  /* No stdio in these profiles, so the digits are written by hand. */
+  char text[] = "0000-00-00T00:00:00Z";
+  int64_t parts[] = {year, month, day, secs / 3600, secs / 60 % 60, secs % 60};
+  size_t ends[] = {4, 7, 10, 13, 16, 19};
+  for (size_t i = 0; i < 6; i++) {
+    int64_t value = parts[i] < 0 ? 0 : parts[i];
+    for (size_t pos = ends[i]; value > 0 && pos-- > (i ? ends[i] - 2 : 0);) {
+      text[pos] = (char)('0' + value % 10);
+      value /= 10;
+    }
+  }
+  if (size > 0) {
+    size_t len = sizeof(text) < size ? sizeof(text) : size;
+    memcpy(buf, text, len - 1);
+    buf[len - 1] = '\0';
+  }
+#else
+  snprintf(buf, size, "%04d-%02d-%02dT%02d:%02d:%02dZ", (int)year, (int)month,
+           (int)day, (int)(secs / 3600), (int)(secs / 60 % 60),
+           (int)(secs % 60));
+#endif
+}
+
+der_error_t x509_name_attribute(x509_span_t name, uint32_t attr, char *value,
+                                size_t max_len) {
+  if (!name.data || !value || max_len == 0) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  der_ctx_t ctx;
+  der_init(&ctx, (uint8_t *)name.data, name.len);
+
+  size_t seq_len;
+  der_error_t err = der_decode_sequence_header(&ctx, &seq_len);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  while (der_get_remaining(&ctx) > 0) {
+    der_tlv_t rdn;
+    err = der_decode_tlv(&ctx, &rdn);
+    if (err != DER_OK) {
+      return err;
+    }
+
+    der_ctx_t rdn_ctx;
+    der_init(&rdn_ctx, (uint8_t *)rdn.value, rdn.length);
+
+    size_t atv_len;
+    if (der_decode_sequence_header(&rdn_ctx, &atv_len) != DER_OK) {
+      continue;
+    }
+
+    uint32_t oid[QCERT_MAX_OID_ARCS];
+    size_t oid_len;
+    if (der_decode_oid(&rdn_ctx, oid, &oid_len, QCERT_MAX_OID_ARCS) !=
+        DER_OK) {
+      continue;
+    }
+
+    if (oid_len == 4 && oid[0] == 2 && oid[1] == 5 && oid[2] == 4 &&
+        oid[3] == attr) {
+      der_tlv_t str;
+      err = der_decode_tlv(&rdn_ctx, &str);
+      if (err != DER_OK) {
+        return err;
+      }
+
+      size_t copy_len = str.length < max_len - 1 ? str.length : max_len - 1;
+      memcpy(value, str.value, copy_len);
+      value[copy_len] = '\0';
+      return DER_OK;
+    }
+  }
+
+  value[0] = '\0';
+  return DER_ERROR_INVALID_DATA;
+}
+
+der_error_t x509_decode_extension(const uint8_t *value, size_t len,
+                                  uint32_t fields, x509_cert_t *cert) {
+  if (len < 2 || value[0] != DER_TAG_OID) {
+    return DER_ERROR_INVALID_TAG;
+  }
+
+  /* Matched on the encoded OID: 06 03 55 1D n is 2.5.29.n. */
+  if (len < 5 || value[1] != 3 || value[2] != 0x55 || value[3] != 0x1D) {
+    return DER_OK;
+  }
+  for (size_t i = 0;
+       i < sizeof(extension_templates) / sizeof(extension_templates[0]);
+       i++) {
+    if (extension_templates[i].arc == value[4] &&
+        (extension_templates[i].field & fields)) {
+      /* A malformed value leaves its field empty, as before. */
+      der_template_decode(extension_templates[i].tmpl, value, len,
+                          DER_TEMPLATE_ALL, cert);
+    }
+  }
+  return DER_OK;
+}
+
+uint32_t x509_extension_fields(const uint8_t *value, size_t len) {
+  if (len < 5 || value[0] != DER_TAG_OID || value[1] != 3 ||
+      value[2] != 0x55 || value[3] != 0x1D) {
+    return 0;
+  }
+  for (size_t i = 0;
+       i < sizeof(extension_templates) / sizeof(extension_templates[0]);
+       i++) {
+    if (extension_templates[i].arc == value[4]) {
+      return extension_templates[i].field;
+    }
+  }
+  return 0;
+}
+
+static der_error_t extract_extensions(x509_cert_t *cert, uint32_t fields) {
+  der_ctx_t ctx;
+  der_init(&ctx, (uint8_t *)cert->extensions.data, cert->extensions.len);
+
+  size_t seq_len;
+  der_error_t err = der_decode_sequence_header(&ctx, &seq_len);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  /*
+   * extnValue is ANY DEFINED BY extnID, so each extension is dispatched on
+   * its OID and only the ones that were asked for are decoded.
+   */
+  while (der_get_remaining(&ctx) > 0) {
+    der_tlv_t ext;
+    err = der_decode_tlv(&ctx, &ext);
+    if (err != DER_OK) {
+      return err;
+    }
+    err = x509_decode_extension(ext.value, ext.length, fields, cert);
+    if (err != DER_OK) {
+      return err;
+    }
+  }
+
+  return DER_OK;
+}
+
+der_error_t x509_extract(const uint8_t *der_data, size_t der_len,
+                         x509_cert_t *cert) {
+  return x509_extract_fields(der_data, der_len, X509_FIELD_ALL, cert);
+}
+
+der_error_t x509_extract_fields(const uint8_t *der_data, size_t der_len,
+                                uint32_t fields, x509_cert_t *cert) {
+  if (!der_data || !cert) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  /* san[] is only read up to san_count, so the array is left as is. */
+  memset(cert, 0, offsetof(x509_cert_t, san));
+  cert->san_count = 0;
+
+  STATS_ADD(STATS_CERTS_PARSED, 1);
+  fields &= X509_FIELD_ALL;
+  der_error_t err =
+      der_template_decode(certificate_template, der_data, der_len, fields, cert);
+  if (err != DER_OK) {
+    return err;
+  }
+
+  if ((fields & (X509_FIELD_SUBJECT_KEY_ID | X509_FIELD_AUTHORITY_KEY_ID |
+                 X509_FIELD_SAN)) &&
+      cert->extensions.data) {
+    return extract_extensions(cert, fields);
+  }
+  return DER_OK;
+}
+
+static const struct {
+  const char *name;
+  uint32_t fields;
+} field_names[] = {
+    {"all", X509_FIELD_ALL},
+    {"version", X509_FIELD_VERSION},
+    {"serial", X509_FIELD_SERIAL},
+    {"signature", X509_FIELD_SIGNATURE_ALGORITHM},
+    {"issuer", X509_FIELD_ISSUER},
+    {"validity", X509_FIELD_VALIDITY},
+    {"not_before", X509_FIELD_VALIDITY},
+    {"not_after", X509_FIELD_VALIDITY},
+    {"subject", X509_FIELD_SUBJECT},
+    {"public_key", X509_FIELD_PUBLIC_KEY},
+    {"extensions", X509_FIELD_EXTENSIONS},
+    {"ski", X509_FIELD_SUBJECT_KEY_ID},
+    {"aki", X509_FIELD_AUTHORITY_KEY_ID},
+    {"san", X509_FIELD_SAN},
+};
+
+bool x509_parse_field_list(const char *list, uint32_t *fields) {
+  if (!list || !fields) {
+    return false;
+  }
+
+  *fields = 0;
+  while (*list) {
+    size_t len = strcspn(list, ",");
+    bool found = false;
+    for (size_t i = 0; i < sizeof(field_names) / sizeof(field_names[0]); i++) {
+      if (strlen(field_names[i].name) == len &&
+          strncmp(field_names[i].name, list, len) == 0) {
+        *fields |= field_names[i].fields;
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+    list += len;
+    if (*list == ',') {
+      list++;
+    }
+  }
+
+  return *fields != 0;
+}
+
+const char *x509_field_name(size_t i) {
+  return i < sizeof(field_names) / sizeof(field_names[0]) ? field_names[i].name
+                                                          : NULL;
 }
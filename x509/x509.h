@@ -1,9 +1,97 @@
 #pragma once
 
+#include "../der/der.h"
+#include "../der/der_template.h"
 #include "../util/util.h"
 #include <stddef.h>
 #include <stdint.h>
+#ifndef QCERT_NO_STDIO
 #include <stdio.h>
+#endif
 #include <string.h>
 
-void parse_certificate(const uint8_t *der_data, size_t der_len);
\ No newline at end of file
+#define X509_MAX_SANS 32
+
+#define X509_ATTR_CN 3
+#define X509_ATTR_C 6
+#define X509_ATTR_L 7
+#define X509_ATTR_ST 8
+#define X509_ATTR_O 10
+#define X509_ATTR_OU 11
+
+#define X509_FIELD_VERSION (1u << 0)
+#define X509_FIELD_SERIAL (1u << 1)
+#define X509_FIELD_SIGNATURE_ALGORITHM (1u << 2)
+#define X509_FIELD_ISSUER (1u << 3)
+#define X509_FIELD_VALIDITY (1u << 4)
+#define X509_FIELD_SUBJECT (1u << 5)
+#define X509_FIELD_PUBLIC_KEY (1u << 6)
+#define X509_FIELD_EXTENSIONS (1u << 7)
+#define X509_FIELD_SUBJECT_KEY_ID (1u << 8)
+#define X509_FIELD_AUTHORITY_KEY_ID (1u << 9)
+#define X509_FIELD_SAN (1u << 10)
+#define X509_FIELD_ALL 0x7FFu
+#define X509_EXTENSION_FIELDS                                                 \
+  (X509_FIELD_EXTENSIONS | X509_FIELD_SUBJECT_KEY_ID |                        \
+   X509_FIELD_AUTHORITY_KEY_ID | X509_FIELD_SAN)
+
+typedef der_span_t x509_span_t;
+
+typedef struct {
+  x509_span_t tbs;
+  uint32_t version;
+  x509_span_t serial;
+  x509_span_t signature_algorithm;
+  x509_span_t issuer;
+  x509_span_t validity;
+  int64_t not_before;
+  int64_t not_after;
+  x509_span_t subject;
+  x509_span_t public_key_info;
+  x509_span_t extensions;
+  x509_span_t subject_key_id;
+  x509_span_t authority_key_id;
+  x509_span_t san[X509_MAX_SANS];
+  size_t san_count;
+} x509_cert_t;
+
+#ifndef QCERT_NO_STDIO
+void parse_certificate(const uint8_t *der_data, size_t der_len);
+void parse_certificate_fields(const uint8_t *der_data, size_t der_len,
+                              uint32_t fields);
+#endif
+
+der_error_t x509_extract(const uint8_t *der_data, size_t der_len,
+                         x509_cert_t *cert);
+/*
+ * Fills only the sections named in fields. Unrequested sections are hopped
+ * over by their headers and are not checked, and decoding stops after the
+ * last requested section. The extensions are only decoded when SKI, AKI or
+ * SAN is requested.
+ */
+der_error_t x509_extract_fields(const uint8_t *der_data, size_t der_len,
+                                uint32_t fields, x509_cert_t *cert);
+/*
+ * Decodes the contents of one Extension into cert when it is an SKI, AKI or
+ * SAN named in fields; other extensions are ignored.
+ */
+der_error_t x509_decode_extension(const uint8_t *value, size_t len,
+                                  uint32_t fields, x509_cert_t *cert);
+/* The field an Extension's contents decode into, or 0 if none. */
+uint32_t x509_extension_fields(const uint8_t *value, size_t len);
+bool x509_parse_field_list(const char *list, uint32_t *fields);
+/* The i-th name x509_parse_field_list accepts, or NULL past the last. */
+const char *x509_field_name(size_t i);
+der_error_t x509_parse_time(uint8_t tag, const uint8_t *value, size_t len,
+                            int64_t *time);
+/* der_template convert function for Time; time points at an int64_t. */
+der_error_t x509_time_convert(const der_tlv_t *tlv, void *time);
+/*
+ * Writes time as a complete Time element: UTCTime for 1950 through 2049 and
+ * GeneralizedTime otherwise, as RFC 5280 requires. Needs 17 bytes at most.
+ */
+der_error_t x509_encode_time(int64_t time, uint8_t *out, size_t size,
+                             size_t *len);
+void x509_format_time(int64_t time, char *buf, size_t size);
+der_error_t x509_name_attribute(x509_span_t name, uint32_t attr, char *value,
+                                size_t max_len);
\ No newline at end of file
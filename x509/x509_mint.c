@@ -0,0 +1,126 @@
+#include "x509_mint.h"
+
+/* Slots in the order x509_mint_init adds them. */
+enum {
+  SLOT_SERIAL,
+  SLOT_NOT_BEFORE,
+  SLOT_NOT_AFTER,
+  SLOT_COMMON_NAME,
+  SLOT_PUBLIC_KEY,
+  SLOT_DNS_NAMES,
+  SLOT_COUNT
+};
+
+#define TAG_EXPLICIT(n) (DER_CLASS_CONTEXT | DER_CONSTRUCTED | (n))
+#define TAG_DNS_NAME (DER_CLASS_CONTEXT | 2)
+
+static const uint8_t version_v3[] = {TAG_EXPLICIT(0), 0x03,
+                                     DER_TAG_INTEGER, 0x01, 0x02};
+static const uint8_t oid_common_name[] = {0x55, 0x04, 0x03};
+static const uint8_t oid_subject_alt_name[] = {0x55, 0x1D, 0x11};
+
+der_error_t x509_mint_init(x509_mint_t *mint,
+                           const x509_mint_profile_t *profile) {
+  if (!mint || !profile) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (!profile->signature_algorithm.data || !profile->issuer.data) {
+    return DER_ERROR_NULL_POINTER;
+  }
+
+  der_mint_t *der = &mint->der;
+  der_mint_init(der, mint->pool, sizeof(mint->pool));
+  mint->subject_alt_name = profile->subject_alt_name;
+
+  size_t slot;
+  der_mint_open(der, DER_TAG_SEQUENCE);
+  der_mint_raw(der, version_v3, sizeof(version_v3));
+  der_mint_slot(der, DER_MINT_VALUE, DER_TAG_INTEGER, &slot);
+  der_mint_raw(der, profile->signature_algorithm.data,
+               profile->signature_algorithm.len);
+  der_mint_raw(der, profile->issuer.data, profile->issuer.len);
+
+  der_mint_open(der, DER_TAG_SEQUENCE);
+  der_mint_slot(der, DER_MINT_TLV, 0, &slot);
+  der_mint_slot(der, DER_MINT_TLV, 0, &slot);
+  der_mint_close(der);
+
+  der_mint_open(der, DER_TAG_SEQUENCE);
+  der_mint_raw(der, profile->subject_prefix.data, profile->subject_prefix.len);
+  der_mint_open(der, DER_TAG_SET);
+  der_mint_open(der, DER_TAG_SEQUENCE);
+  der_mint_element(der, DER_TAG_OID, oid_common_name, sizeof(oid_common_name));
+  der_mint_slot(der, DER_MINT_VALUE, DER_TAG_UTF8_STRING, &slot);
+  der_mint_close(der);
+  der_mint_close(der);
+  der_mint_close(der);
+
+  der_mint_slot(der, DER_MINT_TLV, 0, &slot);
+
+  if (profile->extensions.len > 0 || profile->subject_alt_name) {
+    der_mint_open(der, TAG_EXPLICIT(3));
+    der_mint_open(der, DER_TAG_SEQUENCE);
+    der_mint_raw(der, profile->extensions.data, profile->extensions.len);
+    if (profile->subject_alt_name) {
+      der_mint_open(der, DER_TAG_SEQUENCE);
+      der_mint_element(der, DER_TAG_OID, oid_subject_alt_name,
+                       sizeof(oid_subject_alt_name));
+      der_mint_open(der, DER_TAG_OCTET_STRING);
+      der_mint_open(der, DER_TAG_SEQUENCE);
+      der_mint_slot(der, DER_MINT_ITEMS, TAG_DNS_NAME, &slot);
+      der_mint_close(der);
+      der_mint_close(der);
+      der_mint_close(der);
+    }
+    der_mint_close(der);
+    der_mint_close(der);
+  }
+
+  der_mint_close(der);
+  return der_mint_finish(der);
+}
+
+der_error_t x509_mint_tbs(const x509_mint_t *mint,
+                          const x509_mint_fields_t *fields, uint8_t *out,
+                          size_t size, size_t *len) {
+  if (!mint || !fields || !len) {
+    return DER_ERROR_NULL_POINTER;
+  }
+  if (fields->serial.len == 0 || !fields->public_key_info.data) {
+    return DER_ERROR_INVALID_DATA;
+  }
+  if ((fields->dns_name_count > 0) != mint->subject_alt_name) {
+    return DER_ERROR_INVALID_DATA;
+  }
+
+  uint8_t not_before[17];
+  uint8_t not_after[17];
+  size_t not_before_len;
+  size_t not_after_len;
+  der_error_t err = x509_encode_time(fields->not_before, not_before,
+                                     sizeof(not_before), &not_before_len);
+  if (err == DER_OK) {
+    err = x509_encode_time(fields->not_after, not_after, sizeof(not_after),
+                           &not_after_len);
+  }
+  if (err != DER_OK) {
+    return err;
+  }
+
+  der_mint_value_t values[SLOT_COUNT];
+  memset(values, 0, sizeof(values));
+  values[SLOT_SERIAL].data = fields->serial.data;
+  values[SLOT_SERIAL].len = fields->serial.len;
+  values[SLOT_NOT_BEFORE].data = not_before;
+  values[SLOT_NOT_BEFORE].len = not_before_len;
+  values[SLOT_NOT_AFTER].data = not_after;
+  values[SLOT_NOT_AFTER].len = not_after_len;
+  values[SLOT_COMMON_NAME].data = fields->common_name.data;
+  values[SLOT_COMMON_NAME].len = fields->common_name.len;
+  values[SLOT_PUBLIC_KEY].data = fields->public_key_info.data;
+  values[SLOT_PUBLIC_KEY].len = fields->public_key_info.len;
+  values[SLOT_DNS_NAMES].items = fields->dns_names;
+  values[SLOT_DNS_NAMES].count = fields->dns_name_count;
+
+  return der_mint_encode(&mint->der, values, out, size, len);
+}
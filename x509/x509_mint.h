@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../der/der_mint.h"
+#include "x509.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define X509_MINT_POOL_SIZE 4096
+
+/*
+ * TBSCertificate templates for issuing many certificates from one profile.
+ * Everything the profile fixes (version, signature algorithm, issuer, the
+ * subject's leading RDNs and the constant extensions) is encoded once by
+ * x509_mint_init; x509_mint_tbs then writes only the serial, validity,
+ * subject CN, SAN list and public key, and the lengths around them.
+ */
+typedef struct {
+  x509_span_t signature_algorithm; /* AlgorithmIdentifier, encoded */
+  x509_span_t issuer;              /* Name, encoded */
+  x509_span_t subject_prefix;      /* RDN SETs ahead of the CN, may be empty */
+  x509_span_t extensions;          /* Extension elements back to back */
+  bool subject_alt_name;           /* end with a SAN of DNS names */
+} x509_mint_profile_t;
+
+typedef struct {
+  x509_span_t serial;          /* INTEGER contents */
+  int64_t not_before;
+  int64_t not_after;
+  x509_span_t common_name;     /* UTF8String contents */
+  const x509_span_t *dns_names; /* SAN dNSName contents, profile permitting */
+  size_t dns_name_count;
+  x509_span_t public_key_info; /* SubjectPublicKeyInfo, encoded */
+} x509_mint_fields_t;
+
+typedef struct {
+  der_mint_t der;
+  bool subject_alt_name;
+  uint8_t pool[X509_MINT_POOL_SIZE];
+} x509_mint_t;
+
+der_error_t x509_mint_init(x509_mint_t *mint,
+                           const x509_mint_profile_t *profile);
+
+/*
+ * Writes the TBSCertificate, ready to be hashed and signed. Fails with
+ * DER_ERROR_INVALID_DATA when DNS names are given to a profile without a
+ * SAN or none are given to one with it. On DER_ERROR_BUFFER_TOO_SMALL,
+ * *len is the size needed.
+ */
+der_error_t x509_mint_tbs(const x509_mint_t *mint,
+                          const x509_mint_fields_t *fields, uint8_t *out,
+                          size_t size, size_t *len);